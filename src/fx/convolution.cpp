@@ -0,0 +1,650 @@
+/*
+ * Convolution Reverb sound effect
+ *
+ * Copyright (c) 2022-2025 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <cstddef>
+#include <cstring>
+#include <cstdio>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include "convolution.h"
+#include "fx_common.hpp"
+#include "fx_fft.hpp"
+#include "fx_resample.hpp"
+
+/*
+ * Uniformly partitioned overlap-save convolution.
+ *
+ * The impulse is cut into partitions of B frames, and the spectrum of every
+ * partition (zero-padded to 2B) is computed once at the load. Every B input
+ * frames of the channel get one forward FFT of the last 2B frames, which is
+ * kept at the frequency-domain delay line. The output block is the inverse
+ * FFT of the sum of delayed input spectra multiplied by the partition
+ * spectra, the cost per frame grows with the impulse length by a small
+ * complex multiply-add per bin only.
+ */
+
+//! Smallest partition, shorter ones don't pay for the FFT
+const int minpartition  = 16;
+//! Bins summed over all partitions at once, the sum stays in the cache while partitions are streamed
+const int binblock      = 256;
+
+
+typedef struct FxConvolution
+{
+    int         channels = 0;
+    int         sampleRate = 0;
+    uint16_t    format = AUDIO_F32LSB;
+    bool        isValid = false;
+    ConvolutionSetup m_setup;
+    ConvolutionConfig m_config;
+
+    FxCodec<float>  codec;
+    FxFft       fft;
+
+    //! Partition length in frames, B
+    int         partition = 0;
+    //! Spectrum bins of the 2B transform, B + 1
+    int         bins = 0;
+    //! Distance between spectra, the bins rounded up to the cache line
+    int         binStride = 0;
+
+    //! Number of impulse partitions, 0 while nothing is loaded
+    int         partitions = 0;
+    int         irChannels = 0;
+    //! Spectra of impulse partitions: irChannels x partitions x (re, im) x binStride
+    std::vector<float>  impulse;
+    //! Delay lines of input spectra: channels x partitions x (re, im) x binStride
+    std::vector<float>  spectra;
+    //! Slot of the newest input spectrum at every delay line
+    int         head = 0;
+
+    //! Previous input block, the input block being filled and the wet block being played, B each per channel
+    std::vector<float>  blocks;
+    float      *history[MAX_CHANNELS];
+    float      *blockIn[MAX_CHANNELS];
+    float      *blockOut[MAX_CHANNELS];
+    //! Frames filled at the current block
+    int         fill = 0;
+
+    //! Transform buffer of 2B and the spectrum sum
+    std::vector<float>  work;
+    std::vector<float>  sumRe;
+    std::vector<float>  sumIm;
+
+    //! Input and output planes of maxFrames each
+    std::vector<float>  buffers;
+    float              *inPlanes[MAX_CHANNELS];
+    float              *outPlanes[MAX_CHANNELS];
+
+    int init(int i_rate, uint16_t i_format, int i_channels, const ConvolutionConfig &config)
+    {
+        isValid = false;
+
+        if(i_channels <= 0 || i_channels > MAX_CHANNELS || i_rate <= 0)
+            return -1;
+
+        if(config.maxFrames <= 0 || config.partitionFrames <= 0)
+            return -1;
+
+        m_config = config;
+
+        format = i_format;
+        sampleRate = i_rate;
+        channels = i_channels;
+
+        if(!codec.init(format, channels))
+            return -1;
+
+        partition = minpartition;
+        while(partition < config.partitionFrames)
+            partition *= 2;
+
+        bins = partition + 1;
+        binStride = (bins + 15) & ~15;
+        fft.init(partition * 2);
+
+        work.assign((size_t)partition * 2, 0.0f);
+        sumRe.assign(binStride, 0.0f);
+        sumIm.assign(binStride, 0.0f);
+
+        blocks.assign((size_t)partition * 3 * channels, 0.0f);
+        for(int c = 0; c < channels; ++c)
+        {
+            history[c] = blocks.data() + (size_t)partition * (c * 3);
+            blockIn[c] = blocks.data() + (size_t)partition * (c * 3 + 1);
+            blockOut[c] = blocks.data() + (size_t)partition * (c * 3 + 2);
+        }
+
+        const size_t stride = (size_t)m_config.maxFrames;
+        buffers.assign(stride * channels * 2, 0.0f);
+        for(int c = 0; c < channels; ++c)
+        {
+            inPlanes[c] = buffers.data() + stride * c;
+            outPlanes[c] = buffers.data() + stride * (channels + c);
+        }
+
+        partitions = 0;
+        irChannels = 0;
+        impulse.clear();
+        spectra.clear();
+
+        isValid = true;
+        return 0;
+    }
+
+    /**
+     * @brief Replace the impulse response
+     * @param data Interleaved samples
+     * @param len Length of data in bytes
+     * @param i_format Format of samples, one of AUDIO_*
+     * @param i_channels Number of impulse channels
+     * @param i_rate Sample rate of the impulse
+     * @return 0 on success, -1 on error
+     */
+    int loadImpulse(const void *data, int len, uint16_t i_format, int i_channels, int i_rate)
+    {
+        FxCodec<float> irCodec;
+        std::vector<float> ir;
+        float *irPlanes[MAX_CHANNELS];
+        int frames;
+
+        if(!isValid || !data || len <= 0 || i_rate <= 0)
+            return -1;
+
+        if(i_channels <= 0 || i_channels > MAX_CHANNELS)
+            return -1;
+
+        if(!irCodec.init(i_format, i_channels))
+            return -1;
+
+        frames = len / (irCodec.sample_size * i_channels);
+        if(frames <= 0)
+            return -1;
+
+        ir.resize((size_t)frames * i_channels);
+        for(int c = 0; c < i_channels; ++c)
+            irPlanes[c] = ir.data() + (size_t)frames * c;
+        irCodec.decode(reinterpret_cast<const uint8_t*>(data), irPlanes, frames);
+
+        if(i_rate != sampleRate)
+            frames = resampleImpulse(ir, irPlanes, frames, i_channels, i_rate);
+
+        float scale = 1.0f / (partition * 2); // The inverse FFT gets scaled by its size
+
+        // Energy is taken from the resampled impulse, so it ends up at the unity at any rate
+        if(m_config.normalize)
+        {
+            double energy = 0.0;
+
+            for(int c = 0; c < i_channels; ++c)
+            {
+                double e = 0.0;
+                for(int i = 0; i < frames; ++i)
+                    e += (double)irPlanes[c][i] * irPlanes[c][i];
+                energy = e > energy ? e : energy;
+            }
+
+            if(energy > 0.0)
+                scale *= (float)(1.0 / std::sqrt(energy));
+        }
+        else if(i_rate != sampleRate)
+        {
+            // Resampled impulse has more or less samples of the same response
+            scale *= (float)i_rate / sampleRate;
+        }
+
+        partitions = (frames + partition - 1) / partition;
+        irChannels = i_channels;
+        impulse.assign((size_t)irChannels * partitions * 2 * binStride, 0.0f);
+
+        for(int c = 0; c < irChannels; ++c)
+        {
+            for(int p = 0; p < partitions; ++p)
+            {
+                const int at = p * partition;
+                const int todo = frames - at < partition ? frames - at : partition;
+                float *re = impulseAt(c, p);
+
+                std::fill(work.begin(), work.end(), 0.0f);
+                for(int i = 0; i < todo; ++i)
+                    work[i] = irPlanes[c][at + i] * scale;
+
+                fft.forward(work.data(), re, re + binStride);
+            }
+        }
+
+        // Whatever was played by the previous impulse is gone
+        spectra.resize((size_t)channels * partitions * 2 * binStride);
+        reset();
+
+        return 0;
+    }
+
+    //! Bring the decoded impulse to the output rate, returns the new length
+    int resampleImpulse(std::vector<float> &ir, float **irPlanes, int frames, int i_channels, int i_rate)
+    {
+        FxResampler<float> rs;
+        std::vector<float> out, zeros;
+        float *rsPlanes[MAX_CHANNELS] = {}, *zeroPlanes[MAX_CHANNELS] = {};
+        int done, capacity;
+
+        rs.init(i_rate, sampleRate, i_channels, frames);
+
+        // The filter tail gets flushed by zeros
+        zeros.assign((size_t)rs.taps * 2 * i_channels, 0.0f);
+        capacity = (int)((int64_t)(frames + rs.taps * 2) * sampleRate / i_rate) + 2;
+        out.resize((size_t)capacity * i_channels);
+
+        for(int c = 0; c < i_channels; ++c)
+        {
+            rsPlanes[c] = out.data() + (size_t)capacity * c;
+            zeroPlanes[c] = zeros.data() + (size_t)rs.taps * 2 * c;
+        }
+
+        done = rs.process(irPlanes, frames, rsPlanes, capacity);
+
+        for(int c = 0; c < i_channels; ++c)
+            rsPlanes[c] += done;
+        done += rs.process(zeroPlanes, rs.taps * 2, rsPlanes, capacity - done);
+
+        // Planes keep the capacity stride
+        ir.swap(out);
+        for(int c = 0; c < i_channels; ++c)
+            irPlanes[c] = ir.data() + (size_t)capacity * c;
+
+        return done;
+    }
+
+    //! Real parts of the impulse partition spectrum, imaginary ones follow after binStride
+    float *impulseAt(int c, int p)
+    {
+        return impulse.data() + ((size_t)c * partitions + p) * 2 * binStride;
+    }
+
+    //! Real parts of the delayed input spectrum of the channel, imaginary ones follow after binStride
+    float *spectrumAt(int c, int slot)
+    {
+        return spectra.data() + ((size_t)c * partitions + slot) * 2 * binStride;
+    }
+
+    void updateSetup(const ConvolutionSetup &setup)
+    {
+        m_setup = setup;
+    }
+
+    void getSetup(ConvolutionSetup &setup)
+    {
+        setup = m_setup;
+    }
+
+    void setWetLevel(float val)
+    {
+        m_setup.wetLevel = val;
+    }
+
+    void setDryLevel(float val)
+    {
+        m_setup.dryLevel = val;
+    }
+
+    void close()
+    {
+        isValid = false;
+    }
+
+    //! Silence the input history and the wet blocks, the impulse is kept
+    void reset()
+    {
+        std::fill(spectra.begin(), spectra.end(), 0.0f);
+        std::fill(blocks.begin(), blocks.end(), 0.0f);
+        head = 0;
+        fill = 0;
+    }
+
+    //! Frames the wet signal comes late by, one partition
+    int latency() const
+    {
+        return partitions > 0 ? partition : 0;
+    }
+
+    //! Frames the wet signal lasts after the latency, the impulse length rounded up to partitions
+    int tailLength() const
+    {
+        return partitions * partition;
+    }
+
+    //! Convolve the completed input block of the channel, the result goes into its wet block
+    void runPartition(int c)
+    {
+        const int irc = c % irChannels;
+        float *x = spectrumAt(c, head);
+        float *t = work.data();
+
+        memcpy(t, history[c], sizeof(float) * partition);
+        memcpy(t + partition, blockIn[c], sizeof(float) * partition);
+        memcpy(history[c], blockIn[c], sizeof(float) * partition);
+
+        fft.forward(t, x, x + binStride);
+
+        std::fill(sumRe.begin(), sumRe.end(), 0.0f);
+        std::fill(sumIm.begin(), sumIm.end(), 0.0f);
+
+        for(int b = 0; b < bins; b += binblock)
+        {
+            const int todo = bins - b < binblock ? bins - b : binblock;
+
+            for(int p = 0; p < partitions; ++p)
+            {
+                const int slot = head >= p ? head - p : head - p + partitions;
+                const float *xp = spectrumAt(c, slot) + b;
+                const float *hp = impulseAt(irc, p) + b;
+
+                fxComplexMacBlock(sumRe.data() + b, sumIm.data() + b,
+                                  xp, xp + binStride, hp, hp + binStride, todo);
+            }
+        }
+
+        fft.inverse(sumRe.data(), sumIm.data(), t);
+
+        // The first half is wrapped around, the second one is the linear convolution
+        memcpy(blockOut[c], t + partition, sizeof(float) * partition);
+    }
+
+    //! Process the planar block, the wet signal comes one partition late
+    void processFrames(float *const *in_planes, float *const *out_planes, int frames)
+    {
+        const float wet = m_setup.wetLevel;
+        const float dry = m_setup.dryLevel;
+
+        for(int f = 0; f < frames;)
+        {
+            const int todo = frames - f < partition - fill ? frames - f : partition - fill;
+
+            for(int c = 0; c < channels; ++c)
+            {
+                const float *x = in_planes[c] + f;
+                const float *w = blockOut[c] + fill;
+                float *y = out_planes[c] + f;
+
+                memcpy(blockIn[c] + fill, x, sizeof(float) * todo);
+
+                for(int p = 0; p < todo; ++p)
+                    y[p] = x[p] * dry + w[p] * wet;
+            }
+
+            fill += todo;
+            f += todo;
+
+            if(fill == partition)
+            {
+                for(int c = 0; c < channels; ++c)
+                    runPartition(c);
+
+                head = head + 1 < partitions ? head + 1 : 0;
+                fill = 0;
+            }
+        }
+    }
+
+    void process(uint8_t* stream, int len)
+    {
+        if(!isValid || partitions == 0)
+            return; // Do nothing
+
+        const int frame_size = codec.sample_size * channels;
+        int frames = len / frame_size;
+
+        // Never allocates here, chunks bigger than the config are processed by slices
+        while(frames > 0)
+        {
+            int todo = frames > m_config.maxFrames ? m_config.maxFrames : frames;
+
+            codec.decode(stream, inPlanes, todo);
+            processFrames(inPlanes, outPlanes, todo);
+            codec.encode(stream, outPlanes, todo);
+
+            stream += todo * frame_size;
+            frames -= todo;
+        }
+    }
+
+    //! Process float planes in place, any length is fine
+    void processPlanes(float *const *planes, int frames)
+    {
+        if(!isValid || partitions == 0)
+            return; // Do nothing
+
+        processFrames(planes, planes, frames);
+    }
+} FxConvolution;
+
+
+FxConvolution *convolutionEffectInit(int rate, uint16_t format, int channels)
+{
+    return convolutionEffectInitEx(rate, format, channels, nullptr);
+}
+
+FxConvolution *convolutionEffectInitEx(int rate, uint16_t format, int channels, const ConvolutionConfig *config)
+{
+    FxConvolution *out = new FxConvolution();
+    fxSimdInit();
+    if(out->init(rate, format, channels, config ? *config : ConvolutionConfig()) < 0)
+    {
+        convolutionEffectFree(out);
+        return nullptr;
+    }
+    return out;
+}
+
+void convolutionEffectFree(FxConvolution *context)
+{
+    if(context)
+    {
+        context->close();
+        delete context;
+    }
+}
+
+void convolutionEffect(int, void *stream, int len, void *context)
+{
+    FxConvolution *out = reinterpret_cast<FxConvolution*>(context);
+
+    if(!out)
+        return; // Effect doesn't working
+
+    out->process((uint8_t*)stream, len);
+}
+
+void convolutionEffectPlanar(void *context, float *const *planes, int frames)
+{
+    FxConvolution *out = reinterpret_cast<FxConvolution*>(context);
+
+    if(!out)
+        return; // Effect doesn't working
+
+    out->processPlanes(planes, frames);
+}
+
+int convolutionLoadImpulse(FxConvolution *context, const void *data, int len, uint16_t format, int channels, int rate)
+{
+    if(!context)
+        return -1;
+
+    return context->loadImpulse(data, len, format, channels, rate);
+}
+
+int convolutionLoadImpulseFile(FxConvolution *context, const char *path, uint16_t format, int channels, int rate)
+{
+    std::vector<uint8_t> data;
+    FILE *f;
+    long size;
+    int ret = -1;
+
+    if(!context || !path)
+        return -1;
+
+    f = fopen(path, "rb");
+    if(!f)
+        return -1;
+
+    if(fseek(f, 0, SEEK_END) == 0 && (size = ftell(f)) > 0 && size <= INT32_MAX && fseek(f, 0, SEEK_SET) == 0)
+    {
+        data.resize((size_t)size);
+        if(fread(data.data(), 1, data.size(), f) == data.size())
+            ret = context->loadImpulse(data.data(), (int)size, format, channels, rate);
+    }
+
+    fclose(f);
+
+    return ret;
+}
+
+void convolutionUpdateSetup(FxConvolution *context, const ConvolutionSetup &setup)
+{
+    if(context)
+        context->updateSetup(setup);
+}
+
+void convolutionGetSetup(FxConvolution *context, ConvolutionSetup &setup)
+{
+    if(context)
+        context->getSetup(setup);
+}
+
+void convolutionUpdateWetLevel(FxConvolution *context, float wet)
+{
+    if(context)
+        context->setWetLevel(wet);
+}
+
+void convolutionUpdateDryLevel(FxConvolution *context, float dry)
+{
+    if(context)
+        context->setDryLevel(dry);
+}
+
+void convolutionEffectSetDither(FxConvolution *context, int mode)
+{
+    if(context)
+        context->codec.setDither(mode);
+}
+
+
+//! Fields of the ConvolutionSetup by ConvolutionParam
+static const FxEffectParam convolution_params[] =
+{
+    {CONVOLUTION_PARAM_WET_LEVEL,   "wet-level",    0.0f,   1.0f,   0.3f},
+    {CONVOLUTION_PARAM_DRY_LEVEL,   "dry-level",    0.0f,   1.0f,   1.0f}
+};
+
+static void *convolutionClassCreate(int rate, int channels)
+{
+    return convolutionEffectInit(rate, FX_AUDIO_F32SYS, channels);
+}
+
+static void convolutionClassDestroy(void *effect)
+{
+    convolutionEffectFree(reinterpret_cast<FxConvolution*>(effect));
+}
+
+static void convolutionClassReset(void *effect)
+{
+    FxConvolution *out = reinterpret_cast<FxConvolution*>(effect);
+    if(out)
+        out->reset();
+}
+
+static int convolutionClassSetParam(void *effect, int id, float value)
+{
+    FxConvolution *out = reinterpret_cast<FxConvolution*>(effect);
+
+    if(!out)
+        return -1;
+
+    switch(id)
+    {
+    case CONVOLUTION_PARAM_WET_LEVEL:
+        out->setWetLevel(value);
+        break;
+    case CONVOLUTION_PARAM_DRY_LEVEL:
+        out->setDryLevel(value);
+        break;
+    default:
+        return -1;
+    }
+
+    return 0;
+}
+
+static float convolutionClassGetParam(void *effect, int id)
+{
+    FxConvolution *out = reinterpret_cast<FxConvolution*>(effect);
+
+    if(!out)
+        return 0.0f;
+
+    switch(id)
+    {
+    case CONVOLUTION_PARAM_WET_LEVEL:
+        return out->m_setup.wetLevel;
+    case CONVOLUTION_PARAM_DRY_LEVEL:
+        return out->m_setup.dryLevel;
+    }
+
+    return 0.0f;
+}
+
+static int convolutionClassLatency(void *effect)
+{
+    FxConvolution *out = reinterpret_cast<FxConvolution*>(effect);
+    if(!out || !out->isValid)
+        return 0;
+    return out->latency();
+}
+
+static int convolutionClassTailLength(void *effect)
+{
+    FxConvolution *out = reinterpret_cast<FxConvolution*>(effect);
+    if(!out || !out->isValid)
+        return 0;
+    return out->tailLength();
+}
+
+const FxEffectClass convolutionEffectClass =
+{
+    "convolution",
+    "Convolution reverb",
+    convolution_params,
+    (int)(sizeof(convolution_params) / sizeof(convolution_params[0])),
+    convolutionClassCreate,
+    convolutionClassDestroy,
+    convolutionEffectPlanar,
+    convolutionClassReset,
+    convolutionClassSetParam,
+    convolutionClassGetParam,
+    convolutionClassLatency,
+    convolutionClassTailLength,
+    1 // Passes the sound through till an impulse gets loaded
+};
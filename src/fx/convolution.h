@@ -0,0 +1,110 @@
+/*
+ * Convolution Reverb sound effect
+ *
+ * Copyright (c) 2022-2025 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef CONVOLUTION_H
+#define CONVOLUTION_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "fx_format.h"
+#include "fx_effect.h"
+
+typedef struct FxConvolution FxConvolution;
+
+typedef struct ConvolutionSetup
+{
+    float wetLevel     = 0.3f;
+    float dryLevel     = 1.0f;
+} ConvolutionSetup;
+
+// Options fixed for the lifetime of the effect
+typedef struct ConvolutionConfig
+{
+    // Biggest chunk processed at once, like the audio_buffers given to Mix_OpenAudio().
+    // Scratch buffers get allocated once by this size, bigger chunks are processed by slices
+    int maxFrames       = 4096;
+    // Length of the impulse partition, rounded up to the power of two. Keep it at the audio_buffers
+    // to run one pair of FFTs per chunk, the wet signal comes late by this many frames
+    int partitionFrames = 1024;
+    // Scale the loaded impulse to the unity energy of its loudest channel
+    int normalize       = 1;
+} ConvolutionConfig;
+
+/* Returns NULL if the format, the rate or the number of channels isn't supported */
+extern FxConvolution *convolutionEffectInit(int rate, uint16_t format, int channels);
+extern FxConvolution *convolutionEffectInitEx(int rate, uint16_t format, int channels, const ConvolutionConfig *config);
+extern void convolutionEffectFree(FxConvolution *context);
+
+/*
+ * Post-mix callback, passes the dry signal through until the impulse is loaded:
+ *   Mix_RegisterEffect(MIX_CHANNEL_POST, convolutionEffect, done, context);
+ */
+extern void convolutionEffect(int chan, void *stream, int len, void *context);
+/* Planes of float samples processed in place, the FxChainProcessCB of fx_chain.h.
+   Works with the effect of any format, the math is float anyway */
+extern void convolutionEffectPlanar(void *context, float *const *planes, int frames);
+
+// Parameters of the convolutionEffectClass, see fx_effect.h. Load the impulse into the created
+// effect by convolutionLoadImpulse(), the class has no parameter for it
+typedef enum ConvolutionParam
+{
+    CONVOLUTION_PARAM_WET_LEVEL = 0,
+    CONVOLUTION_PARAM_DRY_LEVEL
+} ConvolutionParam;
+
+extern const FxEffectClass convolutionEffectClass;
+
+/*
+ * Load the impulse response from interleaved samples of any AUDIO_* format.
+ * The chunk of Mix_LoadWAV() is already converted to the output spec:
+ *   convolutionLoadImpulse(context, chunk->abuf, chunk->alen, audio_format, audio_channels, audio_rate);
+ * Other rates get resampled. A mono impulse is applied to every channel, others
+ * are mapped channel to channel (wrapped if the impulse has less channels).
+ * Must not run together with the effect, load it before Mix_RegisterEffect() or
+ * with the audio locked. Returns 0 on success, -1 on error
+ */
+extern int convolutionLoadImpulse(FxConvolution *context, const void *data, int len, uint16_t format, int channels, int rate);
+/* The same as above from the raw file of headerless samples */
+extern int convolutionLoadImpulseFile(FxConvolution *context, const char *path, uint16_t format, int channels, int rate);
+
+// Update all setup at once
+extern void convolutionUpdateSetup(FxConvolution *context, const ConvolutionSetup &setup);
+extern void convolutionGetSetup(FxConvolution *context, ConvolutionSetup &setup);
+
+// Update every single setting
+extern void convolutionUpdateWetLevel(FxConvolution *context, float wet);
+extern void convolutionUpdateDryLevel(FxConvolution *context, float dry);
+
+// Requantization of 8 and 16-bit outputs, one of FxDitherMode
+extern void convolutionEffectSetDither(FxConvolution *context, int mode);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CONVOLUTION_H
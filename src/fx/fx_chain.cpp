@@ -0,0 +1,342 @@
+/*
+ * Host of post-mix effects sharing one stream conversion
+ *
+ * Copyright (c) 2022-2025 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <cstddef>
+#include <atomic>
+#include <algorithm>
+#include <vector>
+#include "fx_chain.h"
+#include "fx_common.hpp"
+#include "fx_workers.hpp"
+
+/*
+ * The audio thread reads the list of effects by one atomic pointer. Editors
+ * copy the current list into the spare one, change it and publish it, then
+ * wait until the callback which could take the old list is over: the run
+ * counter is odd while the callback runs, and any callback started after
+ * the publish takes the new list. The old list becomes the spare one then.
+ *
+ * Effects of known class are skipped while their input is silent for longer
+ * than their latency and tail: the output is silent as well, so the block
+ * is left as it is. Frames of the silent input are counted per slot by the
+ * audio thread and start over once the list gets changed.
+ */
+
+//! Frames decoded at once, bigger chunks are processed by slices
+const int chainframes = 1024;
+
+struct FxChainSlot
+{
+    FxChainProcessCB process;
+    //! Class of the effect, nullptr if it's unknown and never skipped
+    const FxEffectClass *effectClass;
+    void *effect;
+};
+
+struct FxChainList
+{
+    int count = 0;
+    //! Changed by every edit
+    unsigned serial = 0;
+    //! Some effect has the class, the input is checked for silence only then
+    bool skippable = false;
+    FxChainSlot slots[FX_CHAIN_MAX_EFFECTS];
+};
+
+static inline void fxChainWait()
+{
+#if !defined(FX_WORKERS_DISABLE)
+    fxCpuRelax();
+#endif
+}
+
+typedef struct FxChain
+{
+    int         channels = 0;
+    int         sampleRate = 0;
+    uint16_t    format = AUDIO_F32LSB;
+    bool        isValid = false;
+
+    FxCodec<float>  codec;
+
+    //! Lists of effects, one is current and another one is spare
+    FxChainList lists[2];
+    std::atomic<FxChainList*>   current;
+    //! Incremented at the start and at the end of every callback
+    std::atomic<unsigned>       runs;
+
+    //! Planes of chainframes each
+    std::vector<float>  buffers;
+    float              *planes[MAX_CHANNELS];
+
+    //! Audio thread: frames of the silent input every slot got, and the list they are counted for
+    int         idle[FX_CHAIN_MAX_EFFECTS];
+    unsigned    idleSerial = 0;
+
+    FxChain() :
+        current(&lists[0]), runs(0)
+    {
+        std::fill(idle, idle + FX_CHAIN_MAX_EFFECTS, 0);
+    }
+
+    int init(int i_rate, uint16_t i_format, int i_channels)
+    {
+        isValid = false;
+
+        if(i_channels <= 0 || i_channels > MAX_CHANNELS || i_rate <= 0)
+            return -1;
+
+        format = i_format;
+        sampleRate = i_rate;
+        channels = i_channels;
+
+        if(!codec.init(format, channels))
+            return -1;
+
+        buffers.assign((size_t)chainframes * channels, 0.0f);
+        for(int c = 0; c < channels; ++c)
+            planes[c] = buffers.data() + (size_t)chainframes * c;
+
+        isValid = true;
+
+        return 0;
+    }
+
+    void process(uint8_t* stream, int len)
+    {
+        runs.fetch_add(1, std::memory_order_seq_cst);
+
+        const FxChainList *list = current.load(std::memory_order_seq_cst);
+
+        if(isValid && list->count > 0)
+        {
+            const int frame_size = codec.sample_size * channels;
+            int frames = len / frame_size;
+
+            if(idleSerial != list->serial)
+            {
+                idleSerial = list->serial;
+                std::fill(idle, idle + FX_CHAIN_MAX_EFFECTS, 0);
+            }
+
+            while(frames > 0)
+            {
+                int todo = frames > chainframes ? chainframes : frames;
+
+                codec.decode(stream, planes, todo);
+                runEffects(list, todo);
+                codec.encode(stream, planes, todo);
+
+                stream += todo * frame_size;
+                frames -= todo;
+            }
+        }
+
+        runs.fetch_add(1, std::memory_order_release);
+    }
+
+    //! Run effects in order over the planes, the ones past their tail are skipped
+    void runEffects(const FxChainList *list, int frames)
+    {
+        bool silent = list->skippable && isSilent(frames);
+
+        for(int i = 0; i < list->count; ++i)
+        {
+            const FxChainSlot &slot = list->slots[i];
+
+            if(silent && slot.effectClass)
+            {
+                const int tail = slot.effectClass->tailLength(slot.effect);
+                const int latency = slot.effectClass->latency(slot.effect);
+
+                if(tail != FX_TAIL_INFINITE && idle[i] >= tail + latency)
+                    continue; // Nothing to hear, the output is the same silence
+
+                idle[i] += frames;
+            }
+            else
+                idle[i] = 0;
+
+            slot.process(slot.effect, planes, frames);
+            silent = false;
+        }
+    }
+
+    //! All samples of planes are zero
+    bool isSilent(int frames) const
+    {
+        for(int c = 0; c < channels; ++c)
+        {
+            const float *p = planes[c];
+            for(int i = 0; i < frames; ++i)
+            {
+                if(p[i] != 0.0f)
+                    return false;
+            }
+        }
+
+        return true;
+    }
+
+    //! The list to edit, a copy of the current one
+    FxChainList *edit()
+    {
+        FxChainList *cur = current.load(std::memory_order_relaxed);
+        FxChainList *spare = cur == &lists[0] ? &lists[1] : &lists[0];
+        *spare = *cur;
+        spare->serial++;
+        return spare;
+    }
+
+    //! Make the edited list current, returns once the old one is not used anymore
+    void publish(FxChainList *list)
+    {
+        list->skippable = false;
+        for(int i = 0; i < list->count; ++i)
+            list->skippable |= list->slots[i].effectClass != nullptr;
+
+        current.store(list, std::memory_order_seq_cst);
+
+        const unsigned seen = runs.load(std::memory_order_seq_cst);
+        if(seen & 1)
+        {
+            while(runs.load(std::memory_order_acquire) == seen)
+                fxChainWait();
+        }
+    }
+
+    int insert(int position, FxChainProcessCB process, const FxEffectClass *effectClass, void *effect)
+    {
+        FxChainList *list = edit();
+
+        if(!process || list->count >= FX_CHAIN_MAX_EFFECTS)
+            return -1;
+
+        if(position < 0 || position > list->count)
+            position = list->count;
+
+        for(int i = list->count; i > position; --i)
+            list->slots[i] = list->slots[i - 1];
+
+        list->slots[position].process = process;
+        list->slots[position].effectClass = effectClass;
+        list->slots[position].effect = effect;
+        list->count++;
+
+        publish(list);
+
+        return 0;
+    }
+
+    int remove(void *effect)
+    {
+        FxChainList *list = edit();
+        int i = 0;
+
+        while(i < list->count && list->slots[i].effect != effect)
+            ++i;
+
+        if(i == list->count)
+            return -1;
+
+        for(--list->count; i < list->count; ++i)
+            list->slots[i] = list->slots[i + 1];
+
+        publish(list);
+
+        return 0;
+    }
+
+    int count() const
+    {
+        return current.load(std::memory_order_relaxed)->count;
+    }
+} FxChain;
+
+
+FxChain *fxChainInit(int rate, uint16_t format, int channels)
+{
+    FxChain *out = new FxChain();
+    fxSimdInit();
+    if(out->init(rate, format, channels) < 0)
+    {
+        fxChainFree(out);
+        return nullptr;
+    }
+    return out;
+}
+
+void fxChainFree(FxChain *chain)
+{
+    if(chain)
+        delete chain;
+}
+
+void fxChainEffect(int, void *stream, int len, void *chain)
+{
+    FxChain *out = reinterpret_cast<FxChain*>(chain);
+
+    if(!out)
+        return; // Effect doesn't working
+
+    out->process((uint8_t*)stream, len);
+}
+
+int fxChainInsert(FxChain *chain, int position, FxChainProcessCB process, void *effect)
+{
+    if(!chain)
+        return -1;
+
+    return chain->insert(position, process, nullptr, effect);
+}
+
+int fxChainInsertEffect(FxChain *chain, int position, const FxEffectClass *effectClass, void *effect)
+{
+    if(!chain || !effectClass)
+        return -1;
+
+    return chain->insert(position, effectClass->processBlock, effectClass, effect);
+}
+
+int fxChainRemove(FxChain *chain, void *effect)
+{
+    if(!chain)
+        return -1;
+
+    return chain->remove(effect);
+}
+
+int fxChainCount(FxChain *chain)
+{
+    if(!chain)
+        return 0;
+
+    return chain->count();
+}
+
+void fxChainSetDither(FxChain *chain, int mode)
+{
+    if(chain)
+        chain->codec.setDither(mode);
+}
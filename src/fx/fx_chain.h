@@ -0,0 +1,91 @@
+/*
+ * Host of post-mix effects sharing one stream conversion
+ *
+ * Copyright (c) 2022-2025 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef FX_CHAIN_H
+#define FX_CHAIN_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "fx_format.h"
+#include "fx_effect.h"
+
+/*
+ * The chain decodes the stream into planar floats once, runs its effects in
+ * order and encodes the result once, so stacked effects pay for their DSP
+ * only. Register it once, on MIX_CHANNEL_POST or on a single channel:
+ *   Mix_RegisterEffect(MIX_CHANNEL_POST, fxChainEffect, done, chain);
+ *
+ * Effects get inserted and removed while the callback is registered. The
+ * audio thread never waits: edits publish a new list of effects, and the
+ * edit returns once the callback doesn't run the old list anymore, so the
+ * removed effect may be freed right after. Edit the chain from one thread.
+ *
+ * Effects of the chain must be created at the same rate and channels, and
+ * with AUDIO_F32SYS, the format the chain runs them in.
+ */
+typedef struct FxChain FxChain;
+
+/* Process planes of float samples in place, frames samples per every channel */
+typedef void (*FxChainProcessCB)(void *effect, float *const *planes, int frames);
+
+/* Most effects the chain may hold at once */
+#define FX_CHAIN_MAX_EFFECTS    16
+
+/* Returns NULL if the format, the rate or the number of channels isn't supported */
+extern FxChain *fxChainInit(int rate, uint16_t format, int channels);
+extern void fxChainFree(FxChain *chain);
+
+/* Effect callback, passes the stream through untouched while the chain is empty */
+extern void fxChainEffect(int chan, void *stream, int len, void *chain);
+
+/*
+ * Insert the effect before the given position, or at the end if the position
+ * is negative or past the end:
+ *   fxChainInsert(chain, -1, reverbEffectPlanar, reverb);
+ * Returns 0 on success, -1 if the chain is full
+ */
+extern int fxChainInsert(FxChain *chain, int position, FxChainProcessCB process, void *effect);
+/*
+ * The same for the effect created by the class, see fx_effect.h. The chain
+ * skips the effect once its input is silent for longer than its latency and
+ * tail, so the effect costs nothing while there is nothing to hear
+ */
+extern int fxChainInsertEffect(FxChain *chain, int position, const FxEffectClass *effectClass, void *effect);
+/* Remove the effect, it's not used by the chain anymore once this returns. Returns 0 on success, -1 if not found */
+extern int fxChainRemove(FxChain *chain, void *effect);
+/* Number of effects in the chain */
+extern int fxChainCount(FxChain *chain);
+
+// Requantization of 8 and 16-bit outputs, one of FxDitherMode
+extern void fxChainSetDither(FxChain *chain, int mode);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FX_CHAIN_H
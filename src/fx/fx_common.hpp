@@ -2,7 +2,9 @@
 #define FX_COMMON_HPP
 
 #include <stdint.h>
+#include <string.h>
 #include "fx_format.h"
+#include "fx_simd.hpp"
 
 #ifndef INT8_MIN
 #define INT8_MIN    (-0x7f - 1)
@@ -36,482 +38,689 @@
 
 #define MAX_CHANNELS    10
 
-#ifdef EFFECT_FX_COMMON_INT16DST // int16 output
-// Float32-LE
-static int16_t getFloatLSBSample(uint8_t *raw, int c)
-{
-    union
-    {
-        float f;
-        uint32_t r;
-    } o;
-    raw += (c * sizeof(float));
-    o.r = (((uint32_t)raw[0] <<  0) & 0x000000FF) |
-          (((uint32_t)raw[1] <<  8) & 0x0000FF00) |
-          (((uint32_t)raw[2] << 16) & 0x00FF0000) |
-          (((uint32_t)raw[3] << 24) & 0xFF000000);
-    return o.f * INT16_MAX;
-}
-static void setFloatLSBSample(uint8_t **raw, int16_t ov)
-{
-    float f = (float)ov / INT16_MAX;
-    void *t = &f;
-    uint32_t r = *(uint32_t*)t;
-    *(*raw)++ = (uint8_t)((r >> 0) & 0xFF);
-    *(*raw)++ = (uint8_t)((r >> 8) & 0xFF);
-    *(*raw)++ = (uint8_t)((r >> 16) & 0xFF);
-    *(*raw)++ = (uint8_t)((r >> 24) & 0xFF);
-}
+#if defined(SOUND_FX_BIG_ENDIAN) || \
+    (defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#   define FX_SWAP_LSB true
+#   define FX_SWAP_MSB false
+#else
+#   define FX_SWAP_LSB false
+#   define FX_SWAP_MSB true
+#endif
 
-// Float32-BE
-static int16_t getFloatMSBSample(uint8_t *raw, int c)
-{
-    union
-    {
-        float f;
-        uint32_t r;
-    } o;
-    raw += (c * sizeof(float));
-    o.r = (((uint32_t)raw[3] <<  0) & 0x000000FF) |
-          (((uint32_t)raw[2] <<  8) & 0x0000FF00) |
-          (((uint32_t)raw[1] << 16) & 0x00FF0000) |
-          (((uint32_t)raw[0] << 24) & 0xFF000000);
-    return o.f * INT16_MAX;
-}
-static void setFloatMSBSample(uint8_t **raw, int16_t ov)
-{
-    float f = (float)ov / INT16_MAX;
-    void *t = &f;
-    uint32_t r = *(uint32_t*)t;
-    *(*raw)++ = (uint8_t)((r >> 24) & 0xFF);
-    *(*raw)++ = (uint8_t)((r >> 16) & 0xFF);
-    *(*raw)++ = (uint8_t)((r >> 8) & 0xFF);
-    *(*raw)++ = (uint8_t)((r >> 0) & 0xFF);
-}
+//! Float samples of the native byte order, the format of planes taken by FxEffectClass
+#define FX_AUDIO_F32SYS (FX_SWAP_LSB ? AUDIO_F32MSB : AUDIO_F32LSB)
 
-// int32_t-LE
-static int16_t getInt32LSB(uint8_t *raw, int c)
+static inline uint8_t fxSwap(uint8_t r)
 {
-    uint32_t r;
-    int32_t f;
-    raw += (c * sizeof(int32_t));
-    r = (((uint32_t)raw[0] <<  0) & 0x000000FF) |
-        (((uint32_t)raw[1] <<  8) & 0x0000FF00) |
-        (((uint32_t)raw[2] << 16) & 0x00FF0000) |
-        (((uint32_t)raw[3] << 24) & 0xFF000000);
-    f = *(int32_t*)(&r);
-    return f >> 16;
-}
-static void setInt32LSB(uint8_t **raw, int16_t ov)
-{
-    int32_t f = ((int32_t)ov << 16);
-    uint32_t r = *(uint32_t*)(&f);
-    *(*raw)++ = (uint8_t)((r >> 0) & 0xFF);
-    *(*raw)++ = (uint8_t)((r >> 8) & 0xFF);
-    *(*raw)++ = (uint8_t)((r >> 16) & 0xFF);
-    *(*raw)++ = (uint8_t)((r >> 24) & 0xFF);
+    return r;
 }
 
-// int32_t-BE
-static int16_t getInt32MSB(uint8_t *raw, int c)
+static inline uint16_t fxSwap(uint16_t r)
 {
-    uint32_t r;
-    int32_t f;
-    raw += (c * sizeof(int32_t));
-    r = (((uint32_t)raw[3] <<  0) & 0x000000FF) |
-        (((uint32_t)raw[2] <<  8) & 0x0000FF00) |
-        (((uint32_t)raw[1] << 16) & 0x00FF0000) |
-        (((uint32_t)raw[0] << 24) & 0xFF000000);
-    f = *(int32_t*)(&r);
-    return f >> 16;
-}
-static void setInt32MSB(uint8_t **raw, int16_t ov)
-{
-    int32_t f = ((int32_t)ov << 16);
-    uint32_t r = *(uint32_t*)(&f);
-    *(*raw)++ = (uint8_t)((r >> 24) & 0xFF);
-    *(*raw)++ = (uint8_t)((r >> 16) & 0xFF);
-    *(*raw)++ = (uint8_t)((r >> 8) & 0xFF);
-    *(*raw)++ = (uint8_t)((r >> 0) & 0xFF);
+    return (uint16_t)((r >> 8) | (r << 8));
 }
 
-// int16_t-LE
-static int16_t getInt16LSB(uint8_t *raw, int c)
-{
-    uint16_t r;
-    int16_t f;
-    raw += (c * sizeof(int16_t));
-    r = (((uint16_t)raw[0] <<  0) & 0x00FF) |
-        (((uint16_t)raw[1] <<  8) & 0xFF00);
-    f = *(int16_t*)(&r);
-    return f;
-}
-static void setInt16LSB(uint8_t **raw, int16_t f)
+static inline uint32_t fxSwap(uint32_t r)
 {
-    uint16_t r = *(uint16_t*)(&f);
-    *(*raw)++ = (uint8_t)((r >> 0) & 0xFF);
-    *(*raw)++ = (uint8_t)((r >> 8) & 0xFF);
+    return ((r >> 24) & 0x000000FF) |
+           ((r >>  8) & 0x0000FF00) |
+           ((r <<  8) & 0x00FF0000) |
+           ((r << 24) & 0xFF000000);
 }
 
-// int16_t-BE
-static int16_t getInt16MSB(uint8_t *raw, int c)
-{
-    uint16_t r;
-    int16_t f;
-    raw += (c * sizeof(int16_t));
-    r = (((uint16_t)raw[1] <<  0) & 0x00FF) |
-        (((uint16_t)raw[0] <<  8) & 0xFF00);
-    f = *(int16_t*)(&r);
-    return f;
-}
-static void setInt16MSB(uint8_t **raw, int16_t f)
+// Native-endian formats are a plain load/store, the rest are swapped in the register
+template<typename Bits, bool Swap>
+static inline Bits fxLoadBits(const uint8_t *raw)
 {
-    uint16_t r = *(uint16_t*)(&f);
-    *(*raw)++ = (uint8_t)((r >> 8) & 0xFF);
-    *(*raw)++ = (uint8_t)((r >> 0) & 0xFF);
+    Bits r;
+    memcpy(&r, raw, sizeof(Bits));
+    return Swap ? fxSwap(r) : r;
 }
 
-// uint16_t-LE
-static int16_t getuint16_tLSB(uint8_t *raw, int c)
+template<typename Bits, bool Swap>
+static inline void fxStoreBits(uint8_t *raw, Bits r)
 {
-    uint16_t r;
-    raw += (c * sizeof(uint16_t));
-    r = (((uint16_t)raw[0] <<  0) & 0x00FF) |
-        (((uint16_t)raw[1] <<  8) & 0xFF00);
-    return (int16_t)r + INT16_MIN;
-}
-static void setuint16_tLSB(uint8_t **raw, int16_t ov)
-{
-    int16_t f = ov - INT16_MIN;
-    uint16_t r = *(uint16_t*)(&f);
-    *(*raw)++ = (uint8_t)((r >> 0) & 0xFF);
-    *(*raw)++ = (uint8_t)((r >> 8) & 0xFF);
+    if(Swap)
+        r = fxSwap(r);
+    memcpy(raw, &r, sizeof(Bits));
 }
 
-// uint16_t-BE
-static int16_t getuint16_tMSB(uint8_t *raw, int c)
-{
-    uint16_t r;
-    raw += (c * sizeof(uint16_t));
-    r = (((uint16_t)raw[1] <<  0) & 0x00FF) |
-        (((uint16_t)raw[0] <<  8) & 0xFF00);
-    return (int16_t)r + INT16_MIN;
-}
-static void setuint16_tMSB(uint8_t **raw, int16_t ov)
+static inline float fxClampF(float v, float lo, float hi)
 {
-    int16_t f = ov - INT16_MIN;
-    uint16_t r = *(uint16_t*)(&f);
-    *(*raw)++ = (uint8_t)((r >> 8) & 0xFF);
-    *(*raw)++ = (uint8_t)((r >> 0) & 0xFF);
+    return v < lo ? lo : (v > hi ? hi : v);
 }
 
+
+/*
+ * Sample formats: every format converts its raw bits into either
+ * the float domain (-1.0...+1.0) or into the int16 domain (kept in int32)
+ */
+
 // int8_t
-static int16_t getInt8(uint8_t *raw, int c)
+struct FxFmtS8
 {
-    int16_t f;
-    raw += (c * sizeof(int8_t));
-    f = ((int16_t)(int8_t)(*raw)) << 8;
-    return f;
-}
-static void setInt8(uint8_t **raw, int16_t ov)
-{
-    *(*raw)++ = (uint8_t)(ov >> 8);
-}
+    typedef uint8_t bits_t;
+
+    static inline float toFloat(bits_t r)
+    {
+        return (float)(int8_t)r * fx_simd_s8_in;
+    }
+    static inline bits_t fromFloat(float v)
+    {
+        return (bits_t)(int8_t)fxClampF(v * fx_simd_s8_out, INT8_MIN, INT8_MAX);
+    }
+    static inline int32_t toInt(bits_t r)
+    {
+        return (int32_t)(int8_t)r * 256;
+    }
+    static inline bits_t fromInt(int32_t v)
+    {
+        return (bits_t)(int8_t)(v >> 8);
+    }
+};
 
 // uint8_t
-static int16_t getuint8_t(uint8_t *raw, int c)
+struct FxFmtU8
 {
-    raw += (c * sizeof(int8_t));
-    return (int16_t)((int)*raw + INT8_MIN) << 8;
-}
-static void setuint8_t(uint8_t **raw, int16_t ov)
+    typedef uint8_t bits_t;
+
+    static inline float toFloat(bits_t r)
+    {
+        return (float)((int)r + INT8_MIN) * fx_simd_s8_in;
+    }
+    static inline bits_t fromFloat(float v)
+    {
+        return (bits_t)(int)(fxClampF(v * fx_simd_s8_out, INT8_MIN, INT8_MAX) - INT8_MIN);
+    }
+    static inline int32_t toInt(bits_t r)
+    {
+        return ((int32_t)r + INT8_MIN) * 256;
+    }
+    static inline bits_t fromInt(int32_t v)
+    {
+        return (bits_t)((v >> 8) - INT8_MIN);
+    }
+};
+
+// int16_t
+struct FxFmtS16
 {
-    *(*raw)++ = (uint8_t)((ov >> 8) - INT8_MAX);
-}
+    typedef uint16_t bits_t;
 
-#else // int16 output end, Float32 output begin
+    static inline float toFloat(bits_t r)
+    {
+        return (float)(int16_t)r * fx_simd_s16_in;
+    }
+    static inline bits_t fromFloat(float v)
+    {
+        return (bits_t)(int16_t)fxClampF(v * fx_simd_s16_out, INT16_MIN, INT16_MAX);
+    }
+    static inline int32_t toInt(bits_t r)
+    {
+        return (int16_t)r;
+    }
+    static inline bits_t fromInt(int32_t v)
+    {
+        return (bits_t)(int16_t)v;
+    }
+};
 
-// Float32-LE
-static float getFloatLSBSample(uint8_t *raw, int c)
+// uint16_t
+struct FxFmtU16
 {
-    union
+    typedef uint16_t bits_t;
+
+    static inline float toFloat(bits_t r)
     {
-        float f;
-        uint32_t r;
-    } o;
-    raw += (c * sizeof(float));
-    o.r = (((uint32_t)raw[0] <<  0) & 0x000000FF) |
-          (((uint32_t)raw[1] <<  8) & 0x0000FF00) |
-          (((uint32_t)raw[2] << 16) & 0x00FF0000) |
-          (((uint32_t)raw[3] << 24) & 0xFF000000);
-    return o.f;
-}
-static void setFloatLSBSample(uint8_t **raw, float ov)
+        return ((float)r + INT16_MIN) * fx_simd_s16_in;
+    }
+    static inline bits_t fromFloat(float v)
+    {
+        return (bits_t)(int)(fxClampF(v * fx_simd_s16_out, INT16_MIN, INT16_MAX) - INT16_MIN);
+    }
+    static inline int32_t toInt(bits_t r)
+    {
+        return (int32_t)r + INT16_MIN;
+    }
+    static inline bits_t fromInt(int32_t v)
+    {
+        return (bits_t)(v - INT16_MIN);
+    }
+};
+
+// int32_t
+struct FxFmtS32
 {
-    void *t = &ov;
-    uint32_t r = *(uint32_t*)t;
-    *(*raw)++ = (uint8_t)((r >> 0) & 0xFF);
-    *(*raw)++ = (uint8_t)((r >> 8) & 0xFF);
-    *(*raw)++ = (uint8_t)((r >> 16) & 0xFF);
-    *(*raw)++ = (uint8_t)((r >> 24) & 0xFF);
-}
+    typedef uint32_t bits_t;
 
-// Float32-BE
-static float getFloatMSBSample(uint8_t *raw, int c)
+    static inline float toFloat(bits_t r)
+    {
+        return (float)(int32_t)r * fx_simd_s32_in;
+    }
+    static inline bits_t fromFloat(float v)
+    {
+        float f = fxClampF(v, -1.f, 1.f) * fx_simd_s32_out;
+        return (bits_t)(int32_t)(f > fx_simd_s32_max ? fx_simd_s32_max : f);
+    }
+    static inline int32_t toInt(bits_t r)
+    {
+        return (int32_t)r >> 16;
+    }
+    static inline bits_t fromInt(int32_t v)
+    {
+        return (bits_t)(v * 65536);
+    }
+};
+
+// Float32
+struct FxFmtF32
 {
-    union
+    typedef uint32_t bits_t;
+
+    static inline float toFloat(bits_t r)
     {
         float f;
-        uint32_t r;
-    } o;
-    raw += (c * sizeof(float));
-    o.r = (((uint32_t)raw[3] <<  0) & 0x000000FF) |
-          (((uint32_t)raw[2] <<  8) & 0x0000FF00) |
-          (((uint32_t)raw[1] << 16) & 0x00FF0000) |
-          (((uint32_t)raw[0] << 24) & 0xFF000000);
-    return o.f;
-}
-static void setFloatMSBSample(uint8_t **raw, float ov)
-{
-    void *t = &ov;
-    uint32_t r = *(uint32_t*)t;
-    *(*raw)++ = (uint8_t)((r >> 24) & 0xFF);
-    *(*raw)++ = (uint8_t)((r >> 16) & 0xFF);
-    *(*raw)++ = (uint8_t)((r >> 8) & 0xFF);
-    *(*raw)++ = (uint8_t)((r >> 0) & 0xFF);
-}
+        memcpy(&f, &r, sizeof(float));
+        return f;
+    }
+    static inline bits_t fromFloat(float v)
+    {
+        bits_t r;
+        memcpy(&r, &v, sizeof(float));
+        return r;
+    }
+    static inline int32_t toInt(bits_t r)
+    {
+        return (int32_t)fxClampF(toFloat(r) * INT16_MAX, INT16_MIN, INT16_MAX);
+    }
+    static inline bits_t fromInt(int32_t v)
+    {
+        return fromFloat((float)v / INT16_MAX);
+    }
+};
 
-// int32_t-LE
-static float getInt32LSB(uint8_t *raw, int c)
-{
-    uint32_t r;
-    int32_t f;
-    raw += (c * sizeof(int32_t));
-    r = (((uint32_t)raw[0] <<  0) & 0x000000FF) |
-        (((uint32_t)raw[1] <<  8) & 0x0000FF00) |
-        (((uint32_t)raw[2] << 16) & 0x00FF0000) |
-        (((uint32_t)raw[3] << 24) & 0xFF000000);
-    f = *(int32_t*)(&r);
-    return (float)((double)f / INT32_MAX);
-}
-static void setInt32LSB(uint8_t **raw, float ov)
-{
-    int32_t f = ((int32_t)(double(ov) * INT32_MAX));
-    uint32_t r = *(uint32_t*)(&f);
-    *(*raw)++ = (uint8_t)((r >> 0) & 0xFF);
-    *(*raw)++ = (uint8_t)((r >> 8) & 0xFF);
-    *(*raw)++ = (uint8_t)((r >> 16) & 0xFF);
-    *(*raw)++ = (uint8_t)((r >> 24) & 0xFF);
-}
 
-// int32_t-BE
-static float getInt32MSB(uint8_t *raw, int c)
-{
-    uint32_t r;
-    int32_t f;
-    raw += (c * sizeof(int32_t));
-    r = (((uint32_t)raw[3] <<  0) & 0x000000FF) |
-        (((uint32_t)raw[2] <<  8) & 0x0000FF00) |
-        (((uint32_t)raw[1] << 16) & 0x00FF0000) |
-        (((uint32_t)raw[0] << 24) & 0xFF000000);
-    f = *(int32_t*)(&r);
-    return (float)((double)f / INT32_MAX);
-}
-static void setInt32MSB(uint8_t **raw, float ov)
+template<class Fmt>
+static inline void fxFromBits(typename Fmt::bits_t r, float &out)
 {
-    int32_t f = (int32_t(double(ov) * INT32_MAX));
-    uint32_t r = *(uint32_t*)(&f);
-    *(*raw)++ = (uint8_t)((r >> 24) & 0xFF);
-    *(*raw)++ = (uint8_t)((r >> 16) & 0xFF);
-    *(*raw)++ = (uint8_t)((r >> 8) & 0xFF);
-    *(*raw)++ = (uint8_t)((r >> 0) & 0xFF);
+    out = Fmt::toFloat(r);
 }
 
-// int16_t-LE
-static float getInt16LSB(uint8_t *raw, int c)
+template<class Fmt>
+static inline void fxFromBits(typename Fmt::bits_t r, int32_t &out)
 {
-    uint16_t r;
-    int16_t f;
-    raw += (c * sizeof(int16_t));
-    r = (((uint16_t)raw[0] <<  0) & 0x00FF) |
-        (((uint16_t)raw[1] <<  8) & 0xFF00);
-    f = *(int16_t*)(&r);
-    return (float)f / INT16_MAX;
+    out = Fmt::toInt(r);
 }
-static void setInt16LSB(uint8_t **raw, float ov)
+
+template<class Fmt>
+static inline typename Fmt::bits_t fxToBits(float v)
 {
-    int16_t f = int16_t(ov * INT16_MAX);
-    uint16_t r = *(uint16_t*)(&f);
-    *(*raw)++ = (uint8_t)((r >> 0) & 0xFF);
-    *(*raw)++ = (uint8_t)((r >> 8) & 0xFF);
+    return Fmt::fromFloat(v);
 }
 
-// int16_t-BE
-static float getInt16MSB(uint8_t *raw, int c)
+template<class Fmt>
+static inline typename Fmt::bits_t fxToBits(int32_t v)
 {
-    uint16_t r;
-    int16_t f;
-    raw += (c * sizeof(int16_t));
-    r = (((uint16_t)raw[1] <<  0) & 0x00FF) |
-        (((uint16_t)raw[0] <<  8) & 0xFF00);
-    f = *(int16_t*)(&r);
-    return (float)f / INT16_MIN;
+    return Fmt::fromInt(v);
 }
-static void setInt16MSB(uint8_t **raw, float ov)
+
+
+/*
+ * Block codecs: interleaved stream <-> planar channel arrays
+ * (CH is the compile-time number of channels, or 0 to take it at runtime)
+ */
+
+template<class Fmt, bool Swap, typename Sample, int CH = 0>
+static void fxDecodeBlock(const uint8_t *raw, Sample *const *planes, int channels, int frames)
 {
-    int16_t f = int16_t(ov * INT16_MAX);
-    uint16_t r = *(uint16_t*)(&f);
-    *(*raw)++ = (uint8_t)((r >> 8) & 0xFF);
-    *(*raw)++ = (uint8_t)((r >> 0) & 0xFF);
+    typedef typename Fmt::bits_t bits_t;
+    const int chans = CH ? CH : channels;
+
+    for(int f = 0; f < frames; ++f)
+    {
+        for(int c = 0; c < chans; ++c)
+        {
+            fxFromBits<Fmt>(fxLoadBits<bits_t, Swap>(raw), planes[c][f]);
+            raw += sizeof(bits_t);
+        }
+    }
 }
 
-// uint16_t-LE
-static float getuint16_tLSB(uint8_t *raw, int c)
+template<class Fmt, bool Swap, typename Sample, int CH = 0>
+static void fxEncodeBlock(uint8_t *raw, const Sample *const *planes, int channels, int frames)
 {
-    uint16_t r;
-    float f;
-    raw += (c * sizeof(uint16_t));
-    r = (((uint16_t)raw[0] <<  0) & 0x00FF) |
-        (((uint16_t)raw[1] <<  8) & 0xFF00);
-    f = ((float)r + INT16_MIN) / INT16_MAX;
-    return f;
+    typedef typename Fmt::bits_t bits_t;
+    const int chans = CH ? CH : channels;
+
+    for(int f = 0; f < frames; ++f)
+    {
+        for(int c = 0; c < chans; ++c)
+        {
+            fxStoreBits<bits_t, Swap>(raw, fxToBits<Fmt>(planes[c][f]));
+            raw += sizeof(bits_t);
+        }
+    }
 }
-static void setuint16_tLSB(uint8_t **raw, float ov)
+
+template<typename Sample, int CH = 0>
+static void fxDeinterleave(const Sample *src, Sample *const *planes, int offset, int channels, int frames)
 {
-    int16_t f = int16_t((ov * INT16_MAX) - INT16_MIN);
-    uint16_t r = *(uint16_t*)(&f);
-    *(*raw)++ = (uint8_t)((r >> 0) & 0xFF);
-    *(*raw)++ = (uint8_t)((r >> 8) & 0xFF);
+    const int chans = CH ? CH : channels;
+
+    for(int f = 0; f < frames; ++f)
+    {
+        for(int c = 0; c < chans; ++c)
+            planes[c][offset + f] = *src++;
+    }
 }
 
-// uint16_t-BE
-static float getuint16_tMSB(uint8_t *raw, int c)
+template<typename Sample, int CH = 0>
+static void fxInterleave(Sample *dst, const Sample *const *planes, int offset, int channels, int frames)
 {
-    uint16_t r;
-    float f;
-    raw += (c * sizeof(uint16_t));
-    r = (((uint16_t)raw[1] <<  0) & 0x00FF) |
-        (((uint16_t)raw[0] <<  8) & 0xFF00);
-    f = ((float)r + INT16_MIN) / INT16_MAX;
-    return f;
+    const int chans = CH ? CH : channels;
+
+    for(int f = 0; f < frames; ++f)
+    {
+        for(int c = 0; c < chans; ++c)
+            *dst++ = planes[c][offset + f];
+    }
 }
-static void setuint16_tMSB(uint8_t **raw, float ov)
+
+
+// Scalar conversion of contiguous samples, used for tails of the vector kernels
+template<class Fmt, bool Swap, typename Sample>
+static void fxDecodeSamples(const uint8_t *raw, Sample *dst, int count)
 {
-    int16_t f = int16_t((ov * INT16_MAX) - INT16_MIN);
-    uint16_t r = *(uint16_t*)(&f);
-    *(*raw)++ = (uint8_t)((r >> 8) & 0xFF);
-    *(*raw)++ = (uint8_t)((r >> 0) & 0xFF);
+    typedef typename Fmt::bits_t bits_t;
+
+    for(int i = 0; i < count; ++i, raw += sizeof(bits_t))
+        fxFromBits<Fmt>(fxLoadBits<bits_t, Swap>(raw), dst[i]);
 }
 
-// int8_t
-static float getInt8(uint8_t *raw, int c)
+template<class Fmt, bool Swap, typename Sample>
+static void fxEncodeSamples(uint8_t *raw, const Sample *src, int count)
 {
-    float f;
-    raw += (c * sizeof(int8_t));
-    f = (float)(int8_t)(*raw) / INT8_MAX;
-    return f;
+    typedef typename Fmt::bits_t bits_t;
+
+    for(int i = 0; i < count; ++i, raw += sizeof(bits_t))
+        fxStoreBits<bits_t, Swap>(raw, fxToBits<Fmt>(src[i]));
 }
-static void setInt8(uint8_t **raw, float ov)
+
+// Vector kernels do exist for the float domain only
+template<typename Sample>
+static inline bool fxCodecSimdSelect(uint16_t, int (*&decode)(const uint8_t *, Sample *, int),
+                                     int (*&encode)(uint8_t *, const Sample *, int))
 {
-    *(*raw)++ = (uint8_t)(ov * INT8_MAX);
+    decode = nullptr;
+    encode = nullptr;
+    return false;
 }
 
-// uint8_t
-static float getuint8_t(uint8_t *raw, int c)
+static inline bool fxCodecSimdSelect(uint16_t format, FxSimdDecodeCB &decode, FxSimdEncodeCB &encode)
 {
-    float f;
-    raw += (c * sizeof(int8_t));
-    f = (float)((int)*raw + INT8_MIN) / INT8_MAX;
-    return f;
+    return fxSimdSelect<FX_SWAP_LSB, FX_SWAP_MSB>(format, decode, encode);
 }
-static void setuint8_t(uint8_t **raw, float ov)
+
+//! Samples converted at once by the vector kernels before they get (de)interleaved
+#define FX_CODEC_CHUNK  512
+
+/**
+ * @brief Requantizer of float samples into the 8 or 16-bit output
+ *
+ * Samples are moved onto the exact output step, and offset by a half of step so
+ * the truncating converters land onto it. Dither is made by four xorshift32 generators,
+ * sample N uses the generator N % 4, so the scalar code gives the same result as vector one.
+ */
+struct FxDither
 {
-    *(*raw)++ = (uint8_t)((ov * INT8_MAX) - INT8_MIN);
-}
-#endif // Float32 output end
+    int         mode = FX_DITHER_NONE;
+    //! Output steps per 1.0 of the float sample, 0 if output format doesn't need dither
+    float       scale = 0.f;
+    float       inv_scale = 0.f;
+    bool        is_unsigned = false;
+    uint32_t    lanes[4] = {0x9E3779B9, 0x7F4A7C15, 0x85EBCA6B, 0xC2B2AE35};
+    //! Last quantization error per channel for the noise shaping
+    float       error[MAX_CHANNELS];
 
+    void setFormat(uint16_t format)
+    {
+        switch(format)
+        {
+        case AUDIO_U8:
+        case AUDIO_S8:
+            scale = fx_simd_s8_out;
+            break;
+
+        case AUDIO_S16LSB:
+        case AUDIO_S16MSB:
+        case AUDIO_U16LSB:
+        case AUDIO_U16MSB:
+            scale = fx_simd_s16_out;
+            break;
+
+        default:
+            scale = 0.f; // 32-bit outputs have enough of resolution
+            break;
+        }
+
+        inv_scale = scale != 0.f ? 1.f / scale : 0.f;
+        is_unsigned = (format & 0x8000) == 0;
+        reset();
+    }
 
-#ifdef EFFECT_FX_COMMON_INT16DST
-typedef int16_t (*ReadSampleCB)(uint8_t* raw, int channel);
-typedef  void (*WriteSampleCB)(uint8_t** raw, int16_t sample);
-#else
-typedef float (*ReadSampleCB)(uint8_t* raw, int channel);
-typedef  void (*WriteSampleCB)(uint8_t** raw, float sample);
-#endif
+    void setMode(int i_mode)
+    {
+        mode = i_mode;
+        reset();
+    }
 
+    void reset()
+    {
+        memset(error, 0, sizeof(error));
+    }
 
-static bool initFormat(ReadSampleCB &readSample,
-                       WriteSampleCB &writeSample,
-                       int &sample_size, uint16_t format)
-{
-    switch(format)
-    {
-    case AUDIO_U8:
-        readSample = getuint8_t;
-        writeSample = setuint8_t;
-        sample_size = sizeof(uint8_t);
-        break;
-
-    case AUDIO_S8:
-        readSample = getInt8;
-        writeSample = setInt8;
-        sample_size = sizeof(int8_t);
-        break;
-
-    case AUDIO_S16LSB:
-        readSample = getInt16LSB;
-        writeSample = setInt16LSB;
-        sample_size = sizeof(int16_t);
-        break;
-
-    case AUDIO_S16MSB:
-        readSample = getInt16MSB;
-        writeSample = setInt16MSB;
-        sample_size = sizeof(int16_t);
-        break;
-
-    case AUDIO_U16LSB:
-        readSample = getuint16_tLSB;
-        writeSample = setuint16_tLSB;
-        sample_size = sizeof(uint16_t);
-        break;
-
-    case AUDIO_U16MSB:
-        readSample = getuint16_tMSB;
-        writeSample = setuint16_tMSB;
-        sample_size = sizeof(uint16_t);
-        break;
-
-    case AUDIO_S32LSB:
-        readSample = getInt32LSB;
-        writeSample = setInt32LSB;
-        sample_size = sizeof(int32_t);
-        break;
-
-    case AUDIO_S32MSB:
-        readSample = getInt32MSB;
-        writeSample = setInt32MSB;
-        sample_size = sizeof(int32_t);
-        break;
-
-    case AUDIO_F32LSB:
-        readSample = getFloatLSBSample;
-        writeSample = setFloatLSBSample;
-        sample_size = sizeof(float);
-        break;
-
-    case AUDIO_F32MSB:
-        readSample = getFloatMSBSample;
-        writeSample = setFloatMSBSample;
-        sample_size = sizeof(float);
-        break;
-
-    default:
-        return false; /* Unsupported format */
-    }
-
-    return true;
-}
+    bool isActive() const
+    {
+        return mode != FX_DITHER_NONE && scale != 0.f;
+    }
+
+    inline float quantize(float v, uint32_t &r) const
+    {
+        float d, y, t, q;
+
+        r ^= r << 13;
+        r ^= r >> 17;
+        r ^= r << 5;
+
+        d = (float)((int32_t)(r & 0xFFFF) - (int32_t)(r >> 16)) * fx_simd_tpdf_unit;
+        y = v + d + 0.5f;
+        t = (float)(int32_t)y;
+        q = t > y ? t - 1.f : t;
+
+        return q;
+    }
+
+    inline float output(float q) const
+    {
+        return (q + (is_unsigned || q >= 0.f ? 0.5f : -0.5f)) * inv_scale;
+    }
+
+    /**
+     * @brief Requantize the interleaved samples in place
+     * @param buf Samples to process, must begin at the frame boundary
+     * @param count Number of samples
+     * @param channels Number of interleaved channels
+     */
+    void process(float *buf, int count, int channels)
+    {
+        int i = 0;
+
+        if(mode == FX_DITHER_TPDF_SHAPED)
+        {
+            for(int c = 0; i < count; ++i)
+            {
+                float v = buf[i] * scale - error[c];
+                float q = quantize(v, lanes[i & 3]);
+
+                error[c] = q - v;
+                buf[i] = output(q);
+
+                if(++c == channels)
+                    c = 0;
+            }
+            return;
+        }
+
+        i = fxTpdfBlock(buf, count, lanes, scale, is_unsigned);
+
+        for(; i < count; ++i)
+            buf[i] = output(quantize(buf[i] * scale, lanes[i & 3]));
+    }
+};
+
+// Integer samples are produced by the fixed-point math at the output precision already
+static inline void fxDitherChunk(FxDither &, int32_t *, int, int)
+{}
+
+static inline void fxDitherChunk(FxDither &dither, float *chunk, int count, int channels)
+{
+    dither.process(chunk, count, channels);
+}
+
+template<typename Sample>
+struct FxCodec
+{
+    typedef void (*DecodeBlockCB)(const uint8_t *raw, Sample *const *planes, int channels, int frames);
+    typedef void (*EncodeBlockCB)(uint8_t *raw, const Sample *const *planes, int channels, int frames);
+    typedef void (*DecodeSamplesCB)(const uint8_t *raw, Sample *dst, int count);
+    typedef void (*EncodeSamplesCB)(uint8_t *raw, const Sample *src, int count);
+    typedef int (*SimdDecodeCB)(const uint8_t *raw, Sample *dst, int count);
+    typedef int (*SimdEncodeCB)(uint8_t *raw, const Sample *src, int count);
+    typedef void (*DeinterleaveCB)(const Sample *src, Sample *const *planes, int offset, int channels, int frames);
+    typedef void (*InterleaveCB)(Sample *dst, const Sample *const *planes, int offset, int channels, int frames);
+
+    DecodeBlockCB   decodeBlock = nullptr;
+    EncodeBlockCB   encodeBlock = nullptr;
+    DecodeSamplesCB decodeSamples = nullptr;
+    EncodeSamplesCB encodeSamples = nullptr;
+    SimdDecodeCB    simdDecode = nullptr;
+    SimdEncodeCB    simdEncode = nullptr;
+    DeinterleaveCB  deinterleave = nullptr;
+    InterleaveCB    interleave = nullptr;
+    int             sample_size = 0;
+    int             channels = 0;
+    FxDither        dither;
+
+    template<class Fmt, bool Swap, int CH>
+    void setBlockCodec()
+    {
+        decodeBlock = fxDecodeBlock<Fmt, Swap, Sample, CH>;
+        encodeBlock = fxEncodeBlock<Fmt, Swap, Sample, CH>;
+    }
+
+    /**
+     * @brief Set up the format, S16 and F32 streams get the block codec unrolled for common channel counts
+     */
+    template<class Fmt, bool Swap, bool Unroll>
+    void setFormat()
+    {
+        switch(Unroll ? channels : 0)
+        {
+        case 1:
+            setBlockCodec<Fmt, Swap, 1>();
+            break;
+        case 2:
+            setBlockCodec<Fmt, Swap, 2>();
+            break;
+        case 6:
+            setBlockCodec<Fmt, Swap, 6>();
+            break;
+        case 8:
+            setBlockCodec<Fmt, Swap, 8>();
+            break;
+        default:
+            setBlockCodec<Fmt, Swap, 0>();
+            break;
+        }
+
+        decodeSamples = fxDecodeSamples<Fmt, Swap, Sample>;
+        encodeSamples = fxEncodeSamples<Fmt, Swap, Sample>;
+        sample_size = sizeof(typename Fmt::bits_t);
+    }
+
+    template<int CH>
+    void setInterleave()
+    {
+        deinterleave = fxDeinterleave<Sample, CH>;
+        interleave = fxInterleave<Sample, CH>;
+    }
+
+    /**
+     * @brief Set up the codec for the format, the fxSimdInit() should be called before
+     * @param format Audio format (one of AUDIO_*)
+     * @param i_channels Number of interleaved channels
+     * @return true on success, false if format is not supported
+     */
+    bool init(uint16_t format, int i_channels)
+    {
+        channels = i_channels;
+
+        switch(format)
+        {
+        case AUDIO_U8:
+            setFormat<FxFmtU8, false, false>();
+            break;
+
+        case AUDIO_S8:
+            setFormat<FxFmtS8, false, false>();
+            break;
+
+        case AUDIO_S16LSB:
+            setFormat<FxFmtS16, FX_SWAP_LSB, true>();
+            break;
+
+        case AUDIO_S16MSB:
+            setFormat<FxFmtS16, FX_SWAP_MSB, true>();
+            break;
+
+        case AUDIO_U16LSB:
+            setFormat<FxFmtU16, FX_SWAP_LSB, false>();
+            break;
+
+        case AUDIO_U16MSB:
+            setFormat<FxFmtU16, FX_SWAP_MSB, false>();
+            break;
+
+        case AUDIO_S32LSB:
+            setFormat<FxFmtS32, FX_SWAP_LSB, false>();
+            break;
+
+        case AUDIO_S32MSB:
+            setFormat<FxFmtS32, FX_SWAP_MSB, false>();
+            break;
+
+        case AUDIO_F32LSB:
+            setFormat<FxFmtF32, FX_SWAP_LSB, true>();
+            break;
+
+        case AUDIO_F32MSB:
+            setFormat<FxFmtF32, FX_SWAP_MSB, true>();
+            break;
+
+        default:
+            return false; /* Unsupported format */
+        }
+
+        switch(channels)
+        {
+        case 2:
+            setInterleave<2>();
+            break;
+        case 6:
+            setInterleave<6>();
+            break;
+        case 8:
+            setInterleave<8>();
+            break;
+        default:
+            setInterleave<0>();
+            break;
+        }
+
+        fxCodecSimdSelect(format, simdDecode, simdEncode);
+        dither.setFormat(format);
+
+        return true;
+    }
+
+    /**
+     * @brief Set the requantization of the output, see FxDitherMode
+     */
+    void setDither(int mode)
+    {
+        dither.setMode(mode);
+    }
+
+    /**
+     * @brief Decode interleaved stream into planar channel arrays
+     * @param raw Input stream
+     * @param planes Output array per every channel, each must fit the frames count
+     * @param frames Number of frames to decode
+     */
+    void decode(const uint8_t *raw, Sample *const *planes, int frames)
+    {
+        if(!simdDecode)
+        {
+            decodeBlock(raw, planes, channels, frames);
+            return;
+        }
+
+        if(channels == 1)
+        {
+            int done = simdDecode(raw, planes[0], frames);
+            decodeSamples(raw + done * sample_size, planes[0] + done, frames - done);
+            return;
+        }
+
+        Sample chunk[FX_CODEC_CHUNK];
+        const int step = FX_CODEC_CHUNK / channels;
+
+        for(int f = 0; f < frames; f += step)
+        {
+            int todo = frames - f < step ? frames - f : step;
+            int count = todo * channels;
+            int done = simdDecode(raw, chunk, count);
+
+            decodeSamples(raw + done * sample_size, chunk + done, count - done);
+            deinterleave(chunk, planes, f, channels, todo);
+
+            raw += count * sample_size;
+        }
+    }
+
+    /**
+     * @brief Encode planar channel arrays into interleaved stream
+     * @param raw Output stream
+     * @param planes Input array per every channel
+     * @param frames Number of frames to encode
+     */
+    void encode(uint8_t *raw, const Sample *const *planes, int frames)
+    {
+        const bool dithered = dither.isActive();
+
+        if(!simdEncode && !dithered)
+        {
+            encodeBlock(raw, planes, channels, frames);
+            return;
+        }
+
+        if(channels == 1 && !dithered)
+        {
+            int done = simdEncode(raw, planes[0], frames);
+            encodeSamples(raw + done * sample_size, planes[0] + done, frames - done);
+            return;
+        }
+
+        Sample chunk[FX_CODEC_CHUNK];
+        const int step = FX_CODEC_CHUNK / channels;
+
+        for(int f = 0; f < frames; f += step)
+        {
+            int todo = frames - f < step ? frames - f : step;
+            int count = todo * channels;
+            int done;
+
+            // Dither gets applied while the chunk is hot in the cache
+            interleave(chunk, planes, f, channels, todo);
+            if(dithered)
+                fxDitherChunk(dither, chunk, count, channels);
+            done = simdEncode ? simdEncode(raw, chunk, count) : 0;
+            encodeSamples(raw + done * sample_size, chunk + done, count - done);
+
+            raw += count * sample_size;
+        }
+    }
+};
 
 
 #endif // FX_COMMON_HPP
@@ -0,0 +1,66 @@
+/*
+ * Common interface of sound effects
+ *
+ * Copyright (c) 2022-2025 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <cstring>
+#include "fx_effect.h"
+#include "spc_echo.h"
+#include "reverb.h"
+#include "convolution.h"
+
+//! Built-in effects, in the order the player lists them
+static const FxEffectClass *const fx_effects[] =
+{
+    &echoEffectClass,
+    &reverbEffectClass,
+    &convolutionEffectClass
+};
+
+static const int fx_effects_count = (int)(sizeof(fx_effects) / sizeof(fx_effects[0]));
+
+int fxEffectsCount(void)
+{
+    return fx_effects_count;
+}
+
+const FxEffectClass *fxEffectAt(int index)
+{
+    if(index < 0 || index >= fx_effects_count)
+        return nullptr;
+
+    return fx_effects[index];
+}
+
+const FxEffectClass *fxEffectFind(const char *name)
+{
+    if(!name)
+        return nullptr;
+
+    for(int i = 0; i < fx_effects_count; ++i)
+    {
+        if(strcmp(fx_effects[i]->name, name) == 0)
+            return fx_effects[i];
+    }
+
+    return nullptr;
+}
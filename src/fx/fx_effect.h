@@ -0,0 +1,105 @@
+/*
+ * Common interface of sound effects
+ *
+ * Copyright (c) 2022-2025 Vitaly Novichkov <admin@wohlnet.ru>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef FX_EFFECT_H
+#define FX_EFFECT_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Every effect fills the FxEffectClass with its functions, so the player
+ * and the FxChain run any of them the same way. Effects created by the
+ * class take planes of native float samples at the given rate and channels:
+ *   const FxEffectClass *fx = fxEffectFind("reverb");
+ *   void *reverb = fx->create(audio_rate, audio_channels);
+ *   fxChainInsertEffect(chain, -1, fx, reverb);
+ *
+ * Effect-specific functions (presets, impulse loading and so on) take the
+ * same pointer the create() returned.
+ */
+
+/* Tail that never ends, or is too long to count, like the frozen reverb */
+#define FX_TAIL_INFINITE    (-1)
+
+/* Parameter of the effect, as set by setParam() */
+typedef struct FxEffectParam
+{
+    int id;
+    /* Short name, the same as the preset key where the effect has presets */
+    const char *name;
+    float minValue;
+    float maxValue;
+    float defaultValue;
+} FxEffectParam;
+
+typedef struct FxEffectClass
+{
+    /* Short name to find the effect by */
+    const char *name;
+    /* Human-readable name */
+    const char *title;
+
+    const FxEffectParam *params;
+    int paramsCount;
+
+    /* New effect of the default setup, or NULL on failure */
+    void *(*create)(int rate, int channels);
+    void (*destroy)(void *effect);
+
+    /* Process planes of float samples in place, frames of any length */
+    void (*processBlock)(void *effect, float *const *planes, int frames);
+    /* Silence delay lines and filters, the setup is kept. Must not run together with processBlock() */
+    void (*reset)(void *effect);
+
+    /* Returns 0 on success, -1 if the id is unknown */
+    int (*setParam)(void *effect, int id, float value);
+    float (*getParam)(void *effect, int id);
+
+    /* Frames the wet signal comes late by, the dry signal is never delayed */
+    int (*latency)(void *effect);
+    /* Frames the output stays audible after the input got silent, not counting the latency,
+       or FX_TAIL_INFINITE. Follows the setup as the control thread made it, safe to call from any thread */
+    int (*tailLength)(void *effect);
+
+    /* Non-zero if the created effect passes the sound through till the effect-specific setup,
+       like the impulse loading of the convolution */
+    int needsSetup;
+} FxEffectClass;
+
+/* Registry of built-in effects */
+extern int fxEffectsCount(void);
+/* Effect by index, 0 to fxEffectsCount() - 1, NULL if out of range */
+extern const FxEffectClass *fxEffectAt(int index);
+/* Effect by the short name, NULL if not found */
+extern const FxEffectClass *fxEffectFind(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FX_EFFECT_H
@@ -0,0 +1,194 @@
+#ifndef FX_FFT_HPP
+#define FX_FFT_HPP
+
+#include <string.h>
+#include <math.h>
+#include <vector>
+
+/*
+ * Real FFT of the power of two size, spectra are kept split into the real
+ * and imaginary arrays of size/2+1 bins.
+ *
+ * The real signal is packed into the complex one of the half size, which
+ * runs through the iterative radix-2 transform, and the bins get untangled
+ * afterwards. Twiddles of every stage are stored contiguously, so inner
+ * loops of butterflies go over plain arrays.
+ */
+
+struct FxFft
+{
+    //! Real size of the transform
+    int size = 0;
+    //! Size of the complex transform, size / 2
+    int half = 0;
+
+    //! Bit-reversed order of the complex transform
+    std::vector<int> order;
+    //! Twiddles of all stages one after another, half - 1 in total
+    std::vector<float> stageRe;
+    std::vector<float> stageIm;
+    //! exp(-2*pi*i*k/size) of the untangle step, half / 2 + 1 of them
+    std::vector<float> unRe;
+    std::vector<float> unIm;
+    //! Complex work buffer
+    std::vector<float> workRe;
+    std::vector<float> workIm;
+
+    /**
+     * @brief Set up the transform
+     * @param i_size Real size, power of two, 4 or more
+     */
+    void init(int i_size)
+    {
+        const double pi = 3.14159265358979323846;
+        int bits = 0;
+
+        size = i_size;
+        half = size / 2;
+
+        while((1 << bits) < half)
+            ++bits;
+
+        order.resize(half);
+        for(int i = 0; i < half; ++i)
+        {
+            int r = 0;
+            for(int b = 0; b < bits; ++b)
+                r |= ((i >> b) & 1) << (bits - 1 - b);
+            order[i] = r;
+        }
+
+        stageRe.resize(half);
+        stageIm.resize(half);
+        for(int len = 2, at = 0; len <= half; len *= 2)
+        {
+            for(int j = 0; j < len / 2; ++j, ++at)
+            {
+                stageRe[at] = (float)cos(-2.0 * pi * j / len);
+                stageIm[at] = (float)sin(-2.0 * pi * j / len);
+            }
+        }
+
+        unRe.resize(half / 2 + 1);
+        unIm.resize(half / 2 + 1);
+        for(int k = 0; k <= half / 2; ++k)
+        {
+            unRe[k] = (float)cos(-2.0 * pi * k / size);
+            unIm[k] = (float)sin(-2.0 * pi * k / size);
+        }
+
+        workRe.resize(half);
+        workIm.resize(half);
+    }
+
+    //! In-place complex transform of the work buffer, the input is in the bit-reversed order
+    void complexRun(float *re, float *im)
+    {
+        const float *twRe = stageRe.data();
+        const float *twIm = stageIm.data();
+
+        for(int len = 2; len <= half; len *= 2)
+        {
+            const int h = len / 2;
+
+            for(int i = 0; i < half; i += len)
+            {
+                float *ar = re + i, *ai = im + i;
+                float *br = re + i + h, *bi = im + i + h;
+
+                for(int j = 0; j < h; ++j)
+                {
+                    const float tr = br[j] * twRe[j] - bi[j] * twIm[j];
+                    const float ti = br[j] * twIm[j] + bi[j] * twRe[j];
+
+                    br[j] = ar[j] - tr;
+                    bi[j] = ai[j] - ti;
+                    ar[j] += tr;
+                    ai[j] += ti;
+                }
+            }
+
+            twRe += h;
+            twIm += h;
+        }
+    }
+
+    /**
+     * @brief Spectrum of the real signal
+     * @param in Signal of size samples
+     * @param re Real parts of half + 1 bins
+     * @param im Imaginary parts of half + 1 bins
+     */
+    void forward(const float *in, float *re, float *im)
+    {
+        float *zr = workRe.data(), *zi = workIm.data();
+
+        for(int i = 0; i < half; ++i)
+        {
+            zr[order[i]] = in[i * 2];
+            zi[order[i]] = in[i * 2 + 1];
+        }
+
+        complexRun(zr, zi);
+
+        re[0] = zr[0] + zi[0];
+        im[0] = 0.0f;
+        re[half] = zr[0] - zi[0];
+        im[half] = 0.0f;
+
+        // Bins k and half - k come from the same pair of the complex bins
+        for(int k = 1; k <= half / 2; ++k)
+        {
+            const int c = half - k;
+            const float er = (zr[k] + zr[c]) * 0.5f, ei = (zi[k] - zi[c]) * 0.5f;
+            const float or_ = (zi[k] + zi[c]) * 0.5f, oi = (zr[c] - zr[k]) * 0.5f;
+            const float tr = or_ * unRe[k] - oi * unIm[k];
+            const float ti = or_ * unIm[k] + oi * unRe[k];
+
+            re[k] = er + tr;
+            im[k] = ei + ti;
+            re[c] = er - tr;
+            im[c] = ti - ei;
+        }
+    }
+
+    /**
+     * @brief Real signal of the spectrum, scaled by size like the unnormalized transforms are
+     * @param re Real parts of half + 1 bins
+     * @param im Imaginary parts of half + 1 bins
+     * @param out Signal of size samples
+     */
+    void inverse(const float *re, const float *im, float *out)
+    {
+        float *zr = workRe.data(), *zi = workIm.data();
+
+        // Conjugated input of the forward transform gives the conjugated inverse one
+        zr[order[0]] = re[0] + re[half];
+        zi[order[0]] = -(re[0] - re[half]);
+
+        for(int k = 1; k <= half / 2; ++k)
+        {
+            const int c = half - k;
+            const float er = re[k] + re[c], ei = im[k] - im[c];
+            const float dr = re[k] - re[c], di = im[k] + im[c];
+            // Odd part is turned back by the conjugated twiddle
+            const float or_ = dr * unRe[k] + di * unIm[k];
+            const float oi = di * unRe[k] - dr * unIm[k];
+
+            zr[order[k]] = er - oi;
+            zi[order[k]] = -(ei + or_);
+            zr[order[c]] = er + oi;
+            zi[order[c]] = -(or_ - ei);
+        }
+
+        complexRun(zr, zi);
+
+        for(int i = 0; i < half; ++i)
+        {
+            out[i * 2] = zr[i];
+            out[i * 2 + 1] = -zi[i];
+        }
+    }
+};
+
+#endif // FX_FFT_HPP
@@ -19,4 +19,12 @@
 #define AUDIO_F32       AUDIO_F32LSB
 #endif
 
+/* Requantization of the float samples into 8 and 16-bit outputs */
+typedef enum FxDitherMode
+{
+    FX_DITHER_NONE = 0,     /**< Plain conversion, the truncation error stays correlated with the signal */
+    FX_DITHER_TPDF,         /**< Triangular dither of 2 LSB peak-to-peak */
+    FX_DITHER_TPDF_SHAPED   /**< Triangular dither with the first-order error feedback */
+} FxDitherMode;
+
 #endif // FX_FORMAT_H
@@ -0,0 +1,270 @@
+#ifndef FX_RESAMPLE_HPP
+#define FX_RESAMPLE_HPP
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+/*
+ * Polyphase windowed-sinc resampler of planar streams.
+ *
+ * The step between output samples is kept as an exact rational number, so
+ * two resamplers working in the opposite directions stay locked together
+ * forever. The filter is FX_RESAMPLE_TAPS samples long at the lower of two
+ * rates, every phase is normalized to the unity gain at DC.
+ */
+
+//! Length of the filter in samples of the lower rate
+#define FX_RESAMPLE_TAPS        8
+//! Exact phase table is used while the step denominator fits, otherwise phases get rounded
+#define FX_RESAMPLE_MAX_PHASES  512
+
+template<typename Sample>
+struct FxResampleMath;
+
+template<>
+struct FxResampleMath<float>
+{
+    typedef float coef_t;
+    typedef float acc_t;
+
+    static inline coef_t coef(double v)
+    {
+        return (coef_t)v;
+    }
+    static inline float result(acc_t acc)
+    {
+        return acc;
+    }
+};
+
+// Q14 taps, same scale as the S-DSP volumes
+template<>
+struct FxResampleMath<int32_t>
+{
+    typedef int32_t coef_t;
+    typedef int64_t acc_t;
+
+    static inline coef_t coef(double v)
+    {
+        return (coef_t)floor(v * 16384.0 + 0.5);
+    }
+    static inline int32_t result(acc_t acc)
+    {
+        return (int32_t)((acc + 8192) >> 14);
+    }
+};
+
+template<typename Sample>
+struct FxResampler
+{
+    typedef FxResampleMath<Sample> Math;
+    typedef typename Math::coef_t coef_t;
+    typedef typename Math::acc_t acc_t;
+
+    int channels = 0;
+    int taps = 0;
+    int phases = 0;
+
+    //! Input samples per output sample: step_int + step_num / step_den
+    int step_int = 0;
+    int step_num = 0;
+    int step_den = 1;
+
+    //! Start of the next output window at the buffer
+    int pos = 0;
+    //! Fractional part of the next output position, 0...step_den-1
+    int frac = 0;
+    //! Number of samples per channel at the buffer
+    int fill = 0;
+    int capacity = 0;
+
+    //! phases x taps
+    std::vector<coef_t> table;
+    //! Planar input history, capacity samples per channel
+    std::vector<Sample> buffer;
+
+    static int gcd(int a, int b)
+    {
+        while(b)
+        {
+            int t = a % b;
+            a = b;
+            b = t;
+        }
+        return a;
+    }
+
+    static double besselI0(double x)
+    {
+        double sum = 1.0, term = 1.0;
+
+        for(int k = 1; k < 32; ++k)
+        {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+        }
+
+        return sum;
+    }
+
+    /**
+     * @brief Set up the resampler
+     * @param rate_in Input sample rate
+     * @param rate_out Output sample rate
+     * @param i_channels Number of planar channels
+     * @param max_in Biggest number of input frames passed into process() at once
+     */
+    void init(int rate_in, int rate_out, int i_channels, int max_in)
+    {
+        const double pi = 3.14159265358979323846;
+        const double beta = 5.0;
+        const int g = gcd(rate_in, rate_out);
+        // Cut-off at 0.4 of the lower rate, scaled into input samples
+        const double scale = rate_out < rate_in ? (double)rate_out / rate_in : 1.0;
+        const double cutoff = 0.8 * scale;
+
+        channels = i_channels;
+        step_den = rate_out / g;
+        step_int = (rate_in / g) / step_den;
+        step_num = (rate_in / g) % step_den;
+
+        // Multiple of 4 lets the dot product run in four independent sums
+        taps = ((int)ceil(FX_RESAMPLE_TAPS / scale) + 3) & ~3;
+        phases = step_den < FX_RESAMPLE_MAX_PHASES ? step_den : FX_RESAMPLE_MAX_PHASES;
+
+        std::vector<double> tmp(taps);
+        table.resize((size_t)phases * taps);
+
+        for(int p = 0; p < phases; ++p)
+        {
+            coef_t *h = table.data() + (size_t)p * taps;
+            double sum = 0.0;
+
+            for(int j = 0; j < taps; ++j)
+            {
+                double d = (j - taps / 2 + 1) - (double)p / phases;
+                double x = pi * cutoff * d;
+                double w = d / (taps / 2.0);
+                double s = d == 0.0 ? 1.0 : sin(x) / x;
+
+                w = w * w < 1.0 ? besselI0(beta * sqrt(1.0 - w * w)) / besselI0(beta) : 0.0;
+                tmp[j] = s * w;
+                sum += tmp[j];
+            }
+
+            for(int j = 0; j < taps; ++j)
+                h[j] = Math::coef(tmp[j] / sum);
+        }
+
+        capacity = taps * 2 + step_int + 2 + max_in;
+        buffer.resize((size_t)capacity * channels);
+        reset();
+    }
+
+    //! Clear the history, the output is delayed by a half of the filter
+    void reset()
+    {
+        std::fill(buffer.begin(), buffer.end(), Sample());
+        pos = 0;
+        frac = 0;
+        fill = taps;
+    }
+
+    /**
+     * @brief Append the input and produce as many outputs as it does allow
+     * @param in Input planes
+     * @param in_frames Number of input frames, not bigger than max_in given to init()
+     * @param out Output planes
+     * @param out_max Biggest number of frames to produce, the rest stays for the next call
+     * @return Number of produced frames
+     */
+    int process(const Sample *const *in, int in_frames, Sample *const *out, int out_max)
+    {
+        int count = 0, p = pos, f = frac, drop;
+
+        if(fill + in_frames > capacity)
+        {
+            // Consumer asks for less than produced, should never happen at the steady state
+            std::vector<Sample> grown((size_t)(fill + in_frames) * channels);
+            for(int c = 0; c < channels; ++c)
+                memcpy(grown.data() + (size_t)c * (fill + in_frames),
+                       buffer.data() + (size_t)c * capacity, fill * sizeof(Sample));
+            capacity = fill + in_frames;
+            buffer.swap(grown);
+        }
+
+        for(int c = 0; c < channels; ++c)
+            memcpy(buffer.data() + (size_t)c * capacity + fill, in[c], in_frames * sizeof(Sample));
+        fill += in_frames;
+
+        while(count < out_max && p + taps <= fill)
+        {
+            ++count;
+            p += step_int;
+            f += step_num;
+            if(f >= step_den)
+            {
+                f -= step_den;
+                ++p;
+            }
+        }
+
+        for(int c = 0; c < channels; ++c)
+        {
+            const Sample *x = buffer.data() + (size_t)c * capacity;
+            Sample *y = out[c];
+
+            p = pos;
+            f = frac;
+
+            for(int i = 0; i < count; ++i)
+            {
+                int phase = phases == step_den ? f : (int)((int64_t)f * phases / step_den);
+                const coef_t *h = table.data() + (size_t)phase * taps;
+                const Sample *xp = x + p;
+                acc_t acc[4] = {0, 0, 0, 0};
+
+                for(int j = 0; j < taps; j += 4)
+                {
+                    acc[0] += (acc_t)xp[j + 0] * h[j + 0];
+                    acc[1] += (acc_t)xp[j + 1] * h[j + 1];
+                    acc[2] += (acc_t)xp[j + 2] * h[j + 2];
+                    acc[3] += (acc_t)xp[j + 3] * h[j + 3];
+                }
+
+                y[i] = Math::result((acc[0] + acc[1]) + (acc[2] + acc[3]));
+
+                p += step_int;
+                f += step_num;
+                if(f >= step_den)
+                {
+                    f -= step_den;
+                    ++p;
+                }
+            }
+        }
+
+        pos = p;
+        frac = f;
+
+        // Keep only the samples the next windows are going to need
+        drop = pos < fill ? pos : fill;
+        if(drop > 0)
+        {
+            for(int c = 0; c < channels; ++c)
+            {
+                Sample *x = buffer.data() + (size_t)c * capacity;
+                memmove(x, x + drop, (fill - drop) * sizeof(Sample));
+            }
+            fill -= drop;
+            pos -= drop;
+        }
+
+        return count;
+    }
+};
+
+#endif // FX_RESAMPLE_HPP
@@ -0,0 +1,2769 @@
+#ifndef FX_SIMD_HPP
+#define FX_SIMD_HPP
+
+#include <stdint.h>
+#include <string.h>
+#include "fx_format.h"
+
+/*
+ * Vectorized sample format conversions with the runtime CPU dispatch.
+ *
+ * Every kernel converts a contiguous run of interleaved samples and returns
+ * the number of samples it has processed (always a multiple of the vector
+ * width), the caller finishes the remaining tail by the scalar code which
+ * is kept as the reference. Results are bit-identical to the scalar code.
+ *
+ * Define FX_SIMD_DISABLE to build the scalar code only.
+ */
+
+#if !defined(FX_SIMD_DISABLE)
+#   if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#       define FX_SIMD_SSE2
+#       include <emmintrin.h>
+#       if defined(__GNUC__) || defined(__clang__)
+#           define FX_SIMD_AVX2
+#           define FX_TARGET_AVX2 __attribute__((target("avx2")))
+            // Every AVX2 CPU has the F16C half float conversions
+#           define FX_TARGET_F16C __attribute__((target("avx2,f16c")))
+#           include <immintrin.h>
+#       elif defined(_MSC_VER)
+#           define FX_SIMD_AVX2
+#           define FX_TARGET_AVX2
+#           define FX_TARGET_F16C
+#           include <immintrin.h>
+#           include <intrin.h>
+#       endif
+#   elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#       define FX_SIMD_NEON
+#       include <arm_neon.h>
+#   endif
+#endif
+
+enum FxSimdLevel
+{
+    FX_SIMD_NONE = 0,
+    FX_SIMD_LEVEL_SSE2,
+    FX_SIMD_LEVEL_AVX2,
+    FX_SIMD_LEVEL_NEON
+};
+
+static int fx_simd_level = -1;
+
+static inline int fxSimdDetect()
+{
+    int level = FX_SIMD_NONE;
+
+#if defined(FX_SIMD_SSE2)
+    level = FX_SIMD_LEVEL_SSE2;
+#   if defined(FX_SIMD_AVX2) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+        level = FX_SIMD_LEVEL_AVX2;
+#   elif defined(FX_SIMD_AVX2) && defined(_MSC_VER)
+    int regs[4];
+    __cpuid(regs, 0);
+    if(regs[0] >= 7)
+    {
+        __cpuid(regs, 1);
+        // OSXSAVE and AVX, then the OS must preserve the YMM state
+        if((regs[2] & (1 << 27)) && (regs[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6)
+        {
+            __cpuidex(regs, 7, 0);
+            if(regs[1] & (1 << 5))
+                level = FX_SIMD_LEVEL_AVX2;
+        }
+    }
+#   endif
+#elif defined(FX_SIMD_NEON)
+    level = FX_SIMD_LEVEL_NEON;
+#endif
+
+    return level;
+}
+
+/**
+ * @brief Detect the CPU features once, must be called at the effect initialization
+ */
+static inline void fxSimdInit()
+{
+    if(fx_simd_level < 0)
+        fx_simd_level = fxSimdDetect();
+}
+
+static inline int fxSimdLevel()
+{
+    return fx_simd_level < 0 ? FX_SIMD_NONE : fx_simd_level;
+}
+
+
+typedef int (*FxSimdDecodeCB)(const uint8_t *raw, float *dst, int count);
+typedef int (*FxSimdEncodeCB)(uint8_t *raw, const float *src, int count);
+
+static const float fx_simd_s8_in   = 1.f / 127;
+static const float fx_simd_s16_in  = 1.f / 32767;
+static const float fx_simd_s32_in  = 1.f / 2147483647;
+static const float fx_simd_s8_out  = 127.f;
+static const float fx_simd_s16_out = 32767.f;
+static const float fx_simd_s32_out = 2147483647.f;
+//! Biggest float that still fits into int32_t
+static const float fx_simd_s32_max = 2147483520.f;
+//! Scale of 16-bit random values into the dither amplitude
+static const float fx_simd_tpdf_unit = 1.f / 65536;
+
+/*
+ * Storage of delay lines. Lines of the compact formats are 16-bit, filters
+ * still run on floats: every run of the line gets converted into the float
+ * scratch, processed there and converted back.
+ */
+enum FxLineFormat
+{
+    FX_LINE_F32 = 0,
+    //! Signed 16-bit of the given full scale, saturated
+    FX_LINE_S16,
+    //! IEEE half floats, the same relative precision at every level
+    FX_LINE_F16
+};
+
+//! Samples of the compact line converted into the float scratch at once
+#define FX_LINE_RUN     256
+
+//! Nearest int16 of v * scale, halves go away from zero, out of range values get saturated
+static inline int16_t fxLineToS16(float v, float scale)
+{
+    float s = v * scale;
+    s += s < 0.f ? -0.5f : 0.5f;
+    s = s > -32768.f ? s : -32768.f;
+    s = s < 32767.f ? s : 32767.f;
+    return static_cast<int16_t>(static_cast<int32_t>(s));
+}
+
+//! Nearest half float, ties to even, overflows give the infinity like the F16C does
+static inline uint16_t fxFloatToHalf(float v)
+{
+    uint32_t x, sign;
+    uint16_t h;
+
+    memcpy(&x, &v, sizeof(x));
+    sign = (x >> 16) & 0x8000;
+    x &= 0x7FFFFFFF;
+
+    if(x >= 0x47800000) // 65536 and more, Inf and NaN
+        h = x > 0x7F800000 ? 0x7E00 : 0x7C00;
+    else if(x < 0x38800000) // Below the smallest normal half, the float add rounds it into the subnormal
+    {
+        float f;
+        memcpy(&f, &x, sizeof(f));
+        f += 0.5f;
+        memcpy(&x, &f, sizeof(x));
+        h = static_cast<uint16_t>(x - 0x3F000000);
+    }
+    else
+    {
+        // Rebias the exponent, the carry out of the mantissa rounds up
+        x += 0xC8000FFF + ((x >> 13) & 1);
+        h = static_cast<uint16_t>(x >> 13);
+    }
+
+    return static_cast<uint16_t>(h | sign);
+}
+
+static inline float fxHalfToFloat(uint16_t h)
+{
+    uint32_t x = static_cast<uint32_t>(h & 0x7FFF) << 13;
+    const uint32_t exp = x & 0x0F800000;
+    float f;
+
+    x += (127 - 15) << 23;
+    if(exp == 0x0F800000) // Inf and NaN
+        x += (128 - 16) << 23;
+    else if(exp == 0) // Subnormal, normalized by the float math
+    {
+        x += 1 << 23;
+        memcpy(&f, &x, sizeof(f));
+        f -= 6.103515625e-05f;
+        memcpy(&x, &f, sizeof(x));
+    }
+
+    x |= static_cast<uint32_t>(h & 0x8000) << 16;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+//! Number of comb filters advanced together, the first half feeds the left output
+#define FX_COMB_LANES   16
+//! Number of comb lines which advance together over the block
+#define FX_COMB_GROUP   4
+
+/*
+ * Lowpass-feedback comb filters stored as the structure of arrays, every lane
+ * does: out = line[idx]; store = out * damp2 + store * damp1;
+ * line[idx] = in + store * feedback; idx = (idx + 1) % size
+ */
+struct FxCombLanes
+{
+    //! Memory all delay lines are placed at
+    float   *arena = nullptr;
+    //! Lines of the FX_LINE_S16 and FX_LINE_F16 formats are placed here instead of the arena
+    uint16_t *compact = nullptr;
+    int     format = FX_LINE_F32;
+    //! Full scale of FX_LINE_S16 lines
+    float   scale = 1.f;
+    //! Start of the delay line at the arena
+    int32_t base[FX_COMB_LANES] = {};
+    int32_t size[FX_COMB_LANES] = {};
+    int32_t idx[FX_COMB_LANES] = {};
+    float   store[FX_COMB_LANES] = {};
+    float   damp1[FX_COMB_LANES] = {};
+    float   damp2[FX_COMB_LANES] = {};
+    float   feedback[FX_COMB_LANES] = {};
+};
+
+//! Number of models of the same tuning run side by side by FxCombModels
+#define FX_COMB_MODELS  4
+
+/*
+ * Comb filters of FX_COMB_MODELS models of the same tuning. Lines of all
+ * models share the length and the index, so they are interleaved by models:
+ * sample i of the model m is at line[i * FX_COMB_MODELS + m], and one vector
+ * advances every model at once. Lines go the same order as FxCombLanes.
+ */
+struct FxCombModels
+{
+    //! Memory all delay lines are placed at
+    float   *arena = nullptr;
+    //! Start of the interleaved delay line at the arena
+    int32_t base[FX_COMB_LANES] = {};
+    //! Length of the line in samples of one model
+    int32_t size[FX_COMB_LANES] = {};
+    int32_t idx[FX_COMB_LANES] = {};
+    //! Filter state of every line and model, by lines
+    float   store[FX_COMB_LANES * FX_COMB_MODELS] = {};
+    //! Parameters per model, all lines of the model share them
+    float   damp1[FX_COMB_MODELS] = {};
+    float   damp2[FX_COMB_MODELS] = {};
+    float   feedback[FX_COMB_MODELS] = {};
+};
+
+//! Number of delay lines of the feedback delay network
+#define FX_FDN_LINES    8
+//! Householder matrix I - 2/N * ones, written as s[k] - sum(s) * fx_fdn_householder
+static const float fx_fdn_householder = 2.f / FX_FDN_LINES;
+
+//! Flush denormals and zeros to +0, the same as the FreeVerb does
+static inline float fxUndenormal(float v)
+{
+    uint32_t i;
+    memcpy(&i, &v, sizeof(i));
+    return (i & 0x7f800000) == 0 ? 0.0f : v;
+}
+
+
+/* ============================== SSE2 ============================== */
+
+#if defined(FX_SIMD_SSE2)
+static inline __m128i fxSse2Swap16(__m128i v)
+{
+    return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+static inline __m128i fxSse2Swap32(__m128i v)
+{
+    v = fxSse2Swap16(v);
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xB1), 0xB1);
+}
+
+template<bool Unsigned>
+static int fxSse2Decode8(const uint8_t *raw, float *dst, int count)
+{
+    const __m128 scale = _mm_set1_ps(fx_simd_s8_in);
+    const __m128i bias = _mm_set1_epi8((char)0x80);
+    int i = 0;
+
+    for(; i + 16 <= count; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(raw + i));
+        if(Unsigned)
+            v = _mm_xor_si128(v, bias);
+
+        __m128i lo = _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8);
+        __m128i hi = _mm_srai_epi16(_mm_unpackhi_epi8(v, v), 8);
+
+        _mm_storeu_ps(dst + i + 0,  _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(lo, lo), 16)), scale));
+        _mm_storeu_ps(dst + i + 4,  _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(lo, lo), 16)), scale));
+        _mm_storeu_ps(dst + i + 8,  _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(hi, hi), 16)), scale));
+        _mm_storeu_ps(dst + i + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(hi, hi), 16)), scale));
+    }
+
+    return i;
+}
+
+template<bool Unsigned>
+static int fxSse2Encode8(uint8_t *raw, const float *src, int count)
+{
+    const __m128 scale = _mm_set1_ps(fx_simd_s8_out);
+    const __m128 lo = _mm_set1_ps(-128.f);
+    const __m128 hi = _mm_set1_ps(127.f);
+    const __m128 bias = _mm_set1_ps(128.f);
+    __m128i v[4];
+    int i = 0;
+
+    for(; i + 16 <= count; i += 16)
+    {
+        for(int j = 0; j < 4; ++j)
+        {
+            __m128 f = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i + j * 4), scale), lo), hi);
+            if(Unsigned)
+                f = _mm_add_ps(f, bias);
+            v[j] = _mm_cvttps_epi32(f);
+        }
+
+        __m128i w0 = _mm_packs_epi32(v[0], v[1]);
+        __m128i w1 = _mm_packs_epi32(v[2], v[3]);
+        if(Unsigned)
+            _mm_storeu_si128((__m128i*)(raw + i), _mm_packus_epi16(w0, w1));
+        else
+            _mm_storeu_si128((__m128i*)(raw + i), _mm_packs_epi16(w0, w1));
+    }
+
+    return i;
+}
+
+template<bool Swap, bool Unsigned>
+static int fxSse2Decode16(const uint8_t *raw, float *dst, int count)
+{
+    const __m128 scale = _mm_set1_ps(fx_simd_s16_in);
+    const __m128i bias = _mm_set1_epi16((short)0x8000);
+    int i = 0;
+
+    for(; i + 8 <= count; i += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(raw + i * 2));
+        if(Swap)
+            v = fxSse2Swap16(v);
+        if(Unsigned)
+            v = _mm_xor_si128(v, bias);
+
+        _mm_storeu_ps(dst + i + 0, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16)), scale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16)), scale));
+    }
+
+    return i;
+}
+
+template<bool Swap, bool Unsigned>
+static int fxSse2Encode16(uint8_t *raw, const float *src, int count)
+{
+    const __m128 scale = _mm_set1_ps(fx_simd_s16_out);
+    const __m128 lo = _mm_set1_ps(-32768.f);
+    const __m128 hi = _mm_set1_ps(32767.f);
+    const __m128 biasf = _mm_set1_ps(32768.f);
+    const __m128i biasi = _mm_set1_epi32(32768);
+    const __m128i bias16 = _mm_set1_epi16((short)0x8000);
+    int i = 0;
+
+    for(; i + 8 <= count; i += 8)
+    {
+        __m128 f0 = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 0), scale), lo), hi);
+        __m128 f1 = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale), lo), hi);
+        __m128i v0, v1, v;
+
+        if(Unsigned)
+        {
+            // Truncate the biased value like the scalar code does
+            v0 = _mm_sub_epi32(_mm_cvttps_epi32(_mm_add_ps(f0, biasf)), biasi);
+            v1 = _mm_sub_epi32(_mm_cvttps_epi32(_mm_add_ps(f1, biasf)), biasi);
+            v = _mm_xor_si128(_mm_packs_epi32(v0, v1), bias16);
+        }
+        else
+        {
+            v0 = _mm_cvttps_epi32(f0);
+            v1 = _mm_cvttps_epi32(f1);
+            v = _mm_packs_epi32(v0, v1);
+        }
+
+        if(Swap)
+            v = fxSse2Swap16(v);
+
+        _mm_storeu_si128((__m128i*)(raw + i * 2), v);
+    }
+
+    return i;
+}
+
+template<bool Swap>
+static int fxSse2Decode32(const uint8_t *raw, float *dst, int count)
+{
+    const __m128 scale = _mm_set1_ps(fx_simd_s32_in);
+    int i = 0;
+
+    for(; i + 4 <= count; i += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(raw + i * 4));
+        if(Swap)
+            v = fxSse2Swap32(v);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+    }
+
+    return i;
+}
+
+template<bool Swap>
+static int fxSse2Encode32(uint8_t *raw, const float *src, int count)
+{
+    const __m128 scale = _mm_set1_ps(fx_simd_s32_out);
+    const __m128 lo = _mm_set1_ps(-1.f);
+    const __m128 hi = _mm_set1_ps(1.f);
+    const __m128 top = _mm_set1_ps(fx_simd_s32_max);
+    int i = 0;
+
+    for(; i + 4 <= count; i += 4)
+    {
+        __m128 f = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i), lo), hi);
+        __m128i v = _mm_cvttps_epi32(_mm_min_ps(_mm_mul_ps(f, scale), top));
+        if(Swap)
+            v = fxSse2Swap32(v);
+        _mm_storeu_si128((__m128i*)(raw + i * 4), v);
+    }
+
+    return i;
+}
+
+template<bool Swap>
+static int fxSse2DecodeF32(const uint8_t *raw, float *dst, int count)
+{
+    int i = 0;
+
+    for(; i + 4 <= count; i += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(raw + i * 4));
+        if(Swap)
+            v = fxSse2Swap32(v);
+        _mm_storeu_si128((__m128i*)(dst + i), v);
+    }
+
+    return i;
+}
+
+template<bool Swap>
+static int fxSse2EncodeF32(uint8_t *raw, const float *src, int count)
+{
+    int i = 0;
+
+    for(; i + 4 <= count; i += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        if(Swap)
+            v = fxSse2Swap32(v);
+        _mm_storeu_si128((__m128i*)(raw + i * 4), v);
+    }
+
+    return i;
+}
+
+static inline void fxSse2Clamp(float *buf, int count, float lo, float hi)
+{
+    const __m128 vlo = _mm_set1_ps(lo);
+    const __m128 vhi = _mm_set1_ps(hi);
+    int i = 0;
+
+    for(; i + 4 <= count; i += 4)
+        _mm_storeu_ps(buf + i, _mm_min_ps(_mm_max_ps(_mm_loadu_ps(buf + i), vlo), vhi));
+
+    for(; i < count; ++i)
+        buf[i] = buf[i] < lo ? lo : (buf[i] > hi ? hi : buf[i]);
+}
+
+template<bool Unsigned>
+static int fxSse2Tpdf(float *buf, int count, uint32_t *lanes, float scale)
+{
+    const __m128 vscale = _mm_set1_ps(scale);
+    const __m128 vinv = _mm_set1_ps(1.f / scale);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 one = _mm_set1_ps(1.f);
+    const __m128 unit = _mm_set1_ps(fx_simd_tpdf_unit);
+    const __m128 sign = _mm_castsi128_ps(_mm_set1_epi32((int)0x80000000));
+    const __m128i low = _mm_set1_epi32(0xFFFF);
+    __m128i s = _mm_loadu_si128((const __m128i*)lanes);
+    int i = 0;
+
+    for(; i + 4 <= count; i += 4)
+    {
+        // xorshift32 per lane
+        s = _mm_xor_si128(s, _mm_slli_epi32(s, 13));
+        s = _mm_xor_si128(s, _mm_srli_epi32(s, 17));
+        s = _mm_xor_si128(s, _mm_slli_epi32(s, 5));
+
+        // Difference of two uniform values is triangular in -1...+1 LSB
+        __m128 d = _mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(_mm_and_si128(s, low), _mm_srli_epi32(s, 16))), unit);
+        __m128 y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(buf + i), vscale), d), half);
+        __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(y));
+        __m128 q = _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, y), one));
+        __m128 o = Unsigned ? half : _mm_or_ps(_mm_and_ps(q, sign), half);
+
+        _mm_storeu_ps(buf + i, _mm_mul_ps(_mm_add_ps(q, o), vinv));
+    }
+
+    _mm_storeu_si128((__m128i*)lanes, s);
+
+    return i;
+}
+
+static inline int fxSse2Fir8(const float *x, float *y, int count, const float *coef)
+{
+    __m128 c[8];
+    int i = 0;
+
+    for(int k = 0; k < 8; ++k)
+        c[k] = _mm_set1_ps(coef[k]);
+
+    for(; i + 4 <= count; i += 4)
+    {
+        __m128 acc = _mm_mul_ps(_mm_loadu_ps(x + i + 7), c[7]);
+        for(int k = 0; k < 7; ++k)
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(x + i + k), c[k]));
+        _mm_storeu_ps(y + i, acc);
+    }
+
+    return i;
+}
+
+static inline int fxSse2Mix(float *dst, const float *a, const float *b, int count,
+                            float ga, float gb, float k, float lo, float hi)
+{
+    const __m128 vga = _mm_set1_ps(ga);
+    const __m128 vgb = _mm_set1_ps(gb);
+    const __m128 vk = _mm_set1_ps(k);
+    const __m128 vlo = _mm_set1_ps(lo);
+    const __m128 vhi = _mm_set1_ps(hi);
+    int i = 0;
+
+    for(; i + 4 <= count; i += 4)
+    {
+        __m128 v = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a + i), vga), _mm_mul_ps(_mm_loadu_ps(b + i), vgb));
+        _mm_storeu_ps(dst + i, _mm_min_ps(_mm_max_ps(_mm_mul_ps(v, vk), vlo), vhi));
+    }
+
+    return i;
+}
+
+static inline __m128 fxSse2Undenormal(__m128 v)
+{
+    const __m128i exp = _mm_and_si128(_mm_castps_si128(v), _mm_set1_epi32(0x7f800000));
+    return _mm_andnot_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(exp, _mm_setzero_si128())), v);
+}
+
+/**
+ * Four lines advance together over a contiguous run. Four samples of every
+ * line are loaded at once and transposed, so the filter math goes by lanes
+ * while the line memory is read and written by plain vectors.
+ */
+static inline int fxSse2CombRun4(float *const *d, float *store, const float *damp1, const float *damp2,
+                                 const float *feedback, const float *in, float *out, bool first, int run)
+{
+    const __m128 d1 = _mm_loadu_ps(damp1);
+    const __m128 d2 = _mm_loadu_ps(damp2);
+    const __m128 fb = _mm_loadu_ps(feedback);
+    __m128 st = _mm_loadu_ps(store);
+    int j = 0;
+
+    for(; j + 4 <= run; j += 4)
+    {
+        __m128 v[4], w[4];
+
+        for(int k = 0; k < 4; ++k)
+            v[k] = _mm_loadu_ps(d[k] + j);
+        _MM_TRANSPOSE4_PS(v[0], v[1], v[2], v[3]);
+
+        for(int s = 0; s < 4; ++s)
+        {
+            v[s] = fxSse2Undenormal(v[s]);
+            st = fxSse2Undenormal(_mm_add_ps(_mm_mul_ps(v[s], d2), _mm_mul_ps(st, d1)));
+            w[s] = _mm_add_ps(_mm_set1_ps(in[j + s]), _mm_mul_ps(st, fb));
+        }
+
+        _MM_TRANSPOSE4_PS(w[0], w[1], w[2], w[3]);
+        _MM_TRANSPOSE4_PS(v[0], v[1], v[2], v[3]);
+
+        // Lines are added one by one, the same order as the scalar code
+        __m128 acc = first ? v[0] : _mm_add_ps(_mm_loadu_ps(out + j), v[0]);
+        for(int k = 0; k < 4; ++k)
+        {
+            _mm_storeu_ps(d[k] + j, w[k]);
+            if(k > 0)
+                acc = _mm_add_ps(acc, v[k]);
+        }
+        _mm_storeu_ps(out + j, acc);
+    }
+
+    _mm_storeu_ps(store, st);
+
+    return j;
+}
+//! Comb lines of the group, every vector is one sample of all models
+static inline void fxSse2CombModels(float *const *d, float *store, const float *damp1, const float *damp2,
+                                    const float *feedback, const float *in, float *out, bool first, int run)
+{
+    const __m128 d1 = _mm_loadu_ps(damp1);
+    const __m128 d2 = _mm_loadu_ps(damp2);
+    const __m128 fb = _mm_loadu_ps(feedback);
+    __m128 st[FX_COMB_GROUP];
+
+    for(int k = 0; k < FX_COMB_GROUP; ++k)
+        st[k] = _mm_loadu_ps(store + k * FX_COMB_MODELS);
+
+    for(int j = 0; j < run * FX_COMB_MODELS; j += FX_COMB_MODELS)
+    {
+        const __m128 x = _mm_loadu_ps(in + j);
+        __m128 acc = first ? _mm_setzero_ps() : _mm_loadu_ps(out + j);
+
+        for(int k = 0; k < FX_COMB_GROUP; ++k)
+        {
+            __m128 v = fxSse2Undenormal(_mm_loadu_ps(d[k] + j));
+            st[k] = fxSse2Undenormal(_mm_add_ps(_mm_mul_ps(v, d2), _mm_mul_ps(st[k], d1)));
+            _mm_storeu_ps(d[k] + j, _mm_add_ps(x, _mm_mul_ps(st[k], fb)));
+            // Zeros are flushed to +0, so the first line is the same as 0 + v
+            acc = first && k == 0 ? v : _mm_add_ps(acc, v);
+        }
+
+        _mm_storeu_ps(out + j, acc);
+    }
+
+    for(int k = 0; k < FX_COMB_GROUP; ++k)
+        _mm_storeu_ps(store + k * FX_COMB_MODELS, st[k]);
+}
+
+static inline void fxSse2AllpassModels(float *d, float feedback, float *io, int run)
+{
+    const __m128 fb = _mm_set1_ps(feedback);
+
+    for(int j = 0; j < run * FX_COMB_MODELS; j += FX_COMB_MODELS)
+    {
+        const __m128 x = _mm_loadu_ps(io + j);
+        const __m128 b = fxSse2Undenormal(_mm_loadu_ps(d + j));
+        _mm_storeu_ps(io + j, _mm_sub_ps(b, x));
+        _mm_storeu_ps(d + j, _mm_add_ps(x, _mm_mul_ps(b, fb)));
+    }
+}
+//! Loop filters of all FDN lines, both halves of lines go through the same loop to overlap their latencies
+static inline int fxSse2FdnDamp(const float *const *o, float *const *s, float *store,
+                                const float *gain, float damp, int count)
+{
+    const __m128 d = _mm_set1_ps(damp);
+    __m128 g[2], st[2];
+    int i = 0;
+
+    for(int h = 0; h < 2; ++h)
+    {
+        g[h] = _mm_loadu_ps(gain + h * 4);
+        st[h] = _mm_loadu_ps(store + h * 4);
+    }
+
+    for(; i + 4 <= count; i += 4)
+    {
+        __m128 v[2][4];
+
+        for(int h = 0; h < 2; ++h)
+        {
+            for(int k = 0; k < 4; ++k)
+                v[h][k] = _mm_loadu_ps(o[h * 4 + k] + i);
+            _MM_TRANSPOSE4_PS(v[h][0], v[h][1], v[h][2], v[h][3]);
+        }
+
+        for(int j = 0; j < 4; ++j)
+        {
+            for(int h = 0; h < 2; ++h)
+            {
+                st[h] = fxSse2Undenormal(_mm_add_ps(_mm_mul_ps(v[h][j], g[h]), _mm_mul_ps(st[h], d)));
+                v[h][j] = st[h];
+            }
+        }
+
+        for(int h = 0; h < 2; ++h)
+        {
+            _MM_TRANSPOSE4_PS(v[h][0], v[h][1], v[h][2], v[h][3]);
+            for(int k = 0; k < 4; ++k)
+                _mm_storeu_ps(s[h * 4 + k] + i, v[h][k]);
+        }
+    }
+
+    for(int h = 0; h < 2; ++h)
+        _mm_storeu_ps(store + h * 4, st[h]);
+
+    return i;
+}
+
+static inline int fxSse2FdnMatrix(const float *const *s, float *const *w, const float *in,
+                                  const float *in_gain, int count)
+{
+    const __m128 h = _mm_set1_ps(fx_fdn_householder);
+    int i = 0;
+
+    for(; i + 4 <= count; i += 4)
+    {
+        const __m128 x = _mm_loadu_ps(in + i);
+        __m128 sum = _mm_loadu_ps(s[0] + i);
+
+        for(int k = 1; k < FX_FDN_LINES; ++k)
+            sum = _mm_add_ps(sum, _mm_loadu_ps(s[k] + i));
+        sum = _mm_mul_ps(sum, h);
+
+        for(int k = 0; k < FX_FDN_LINES; ++k)
+        {
+            const __m128 m = _mm_sub_ps(_mm_loadu_ps(s[k] + i), sum);
+            _mm_storeu_ps(w[k] + i, _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(in_gain[k])), m));
+        }
+    }
+
+    return i;
+}
+
+static inline int fxSse2FdnTaps(const float *const *o, const float *tap_l, const float *tap_r,
+                                float *out_l, float *out_r, int count)
+{
+    int i = 0;
+
+    for(; i + 4 <= count; i += 4)
+    {
+        __m128 v = _mm_loadu_ps(o[0] + i);
+        __m128 l = _mm_mul_ps(v, _mm_set1_ps(tap_l[0]));
+        __m128 r = _mm_mul_ps(v, _mm_set1_ps(tap_r[0]));
+
+        for(int k = 1; k < FX_FDN_LINES; ++k)
+        {
+            v = _mm_loadu_ps(o[k] + i);
+            l = _mm_add_ps(l, _mm_mul_ps(v, _mm_set1_ps(tap_l[k])));
+            r = _mm_add_ps(r, _mm_mul_ps(v, _mm_set1_ps(tap_r[k])));
+        }
+
+        _mm_storeu_ps(out_l + i, l);
+        _mm_storeu_ps(out_r + i, r);
+    }
+
+    return i;
+}
+
+static inline int fxSse2ComplexMac(float *y_re, float *y_im, const float *x_re, const float *x_im,
+                                   const float *h_re, const float *h_im, int count)
+{
+    int i = 0;
+
+    for(; i + 4 <= count; i += 4)
+    {
+        const __m128 xr = _mm_loadu_ps(x_re + i), xi = _mm_loadu_ps(x_im + i);
+        const __m128 hr = _mm_loadu_ps(h_re + i), hi = _mm_loadu_ps(h_im + i);
+        const __m128 pr = _mm_sub_ps(_mm_mul_ps(xr, hr), _mm_mul_ps(xi, hi));
+        const __m128 pi = _mm_add_ps(_mm_mul_ps(xr, hi), _mm_mul_ps(xi, hr));
+
+        _mm_storeu_ps(y_re + i, _mm_add_ps(_mm_loadu_ps(y_re + i), pr));
+        _mm_storeu_ps(y_im + i, _mm_add_ps(_mm_loadu_ps(y_im + i), pi));
+    }
+
+    return i;
+}
+static inline int fxSse2LineLoadS16(const int16_t *src, float *dst, int count, float inv)
+{
+    const __m128 k = _mm_set1_ps(inv);
+    int i = 0;
+
+    for(; i + 8 <= count; i += 8)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), k));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), k));
+    }
+
+    return i;
+}
+
+//! The same rounding as fxLineToS16(), max and min give the low bound to NaN in the same way
+static inline __m128i fxSse2LineRound(__m128 v, __m128 k)
+{
+    const __m128 sign = _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(0x80000000u)));
+    const __m128 half = _mm_set1_ps(0.5f);
+    __m128 s = _mm_mul_ps(v, k);
+
+    s = _mm_add_ps(s, _mm_or_ps(_mm_and_ps(s, sign), half));
+    s = _mm_min_ps(_mm_max_ps(s, _mm_set1_ps(-32768.f)), _mm_set1_ps(32767.f));
+    return _mm_cvttps_epi32(s);
+}
+
+static inline int fxSse2LineStoreS16(int16_t *dst, const float *src, int count, float scale)
+{
+    const __m128 k = _mm_set1_ps(scale);
+    int i = 0;
+
+    for(; i + 8 <= count; i += 8)
+    {
+        __m128i lo = fxSse2LineRound(_mm_loadu_ps(src + i), k);
+        __m128i hi = fxSse2LineRound(_mm_loadu_ps(src + i + 4), k);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(lo, hi));
+    }
+
+    return i;
+}
+
+#endif // FX_SIMD_SSE2
+
+
+/* ============================== AVX2 ============================== */
+
+#if defined(FX_SIMD_AVX2)
+static const char fx_simd_avx2_swap16[32] =
+{
+    1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+    1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14
+};
+
+static const char fx_simd_avx2_swap32[32] =
+{
+    3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+    3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12
+};
+
+template<bool Unsigned>
+FX_TARGET_AVX2
+static int fxAvx2Decode8(const uint8_t *raw, float *dst, int count)
+{
+    const __m256 scale = _mm256_set1_ps(fx_simd_s8_in);
+    const __m128i bias = _mm_set1_epi8((char)0x80);
+    int i = 0;
+
+    for(; i + 16 <= count; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(raw + i));
+        if(Unsigned)
+            v = _mm_xor_si128(v, bias);
+
+        __m256i lo = _mm256_cvtepi8_epi32(v);
+        __m256i hi = _mm256_cvtepi8_epi32(_mm_srli_si128(v, 8));
+        _mm256_storeu_ps(dst + i + 0, _mm256_mul_ps(_mm256_cvtepi32_ps(lo), scale));
+        _mm256_storeu_ps(dst + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(hi), scale));
+    }
+
+    return i;
+}
+
+template<bool Unsigned>
+FX_TARGET_AVX2
+static int fxAvx2Encode8(uint8_t *raw, const float *src, int count)
+{
+    const __m256 scale = _mm256_set1_ps(fx_simd_s8_out);
+    const __m256 lo = _mm256_set1_ps(-128.f);
+    const __m256 hi = _mm256_set1_ps(127.f);
+    const __m256 bias = _mm256_set1_ps(128.f);
+    int i = 0;
+
+    for(; i + 16 <= count; i += 16)
+    {
+        __m256 f0 = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i + 0), scale), lo), hi);
+        __m256 f1 = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i + 8), scale), lo), hi);
+        if(Unsigned)
+        {
+            f0 = _mm256_add_ps(f0, bias);
+            f1 = _mm256_add_ps(f1, bias);
+        }
+
+        __m256i v0 = _mm256_cvttps_epi32(f0);
+        __m256i v1 = _mm256_cvttps_epi32(f1);
+        __m128i w0 = _mm_packs_epi32(_mm256_castsi256_si128(v0), _mm256_extracti128_si256(v0, 1));
+        __m128i w1 = _mm_packs_epi32(_mm256_castsi256_si128(v1), _mm256_extracti128_si256(v1, 1));
+
+        if(Unsigned)
+            _mm_storeu_si128((__m128i*)(raw + i), _mm_packus_epi16(w0, w1));
+        else
+            _mm_storeu_si128((__m128i*)(raw + i), _mm_packs_epi16(w0, w1));
+    }
+
+    return i;
+}
+
+template<bool Swap, bool Unsigned>
+FX_TARGET_AVX2
+static int fxAvx2Decode16(const uint8_t *raw, float *dst, int count)
+{
+    const __m256 scale = _mm256_set1_ps(fx_simd_s16_in);
+    const __m128i shuf = _mm_loadu_si128((const __m128i*)fx_simd_avx2_swap16);
+    const __m128i bias = _mm_set1_epi16((short)0x8000);
+    int i = 0;
+
+    for(; i + 8 <= count; i += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(raw + i * 2));
+        if(Swap)
+            v = _mm_shuffle_epi8(v, shuf);
+        if(Unsigned)
+            v = _mm_xor_si128(v, bias);
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(v)), scale));
+    }
+
+    return i;
+}
+
+template<bool Swap, bool Unsigned>
+FX_TARGET_AVX2
+static int fxAvx2Encode16(uint8_t *raw, const float *src, int count)
+{
+    const __m256 scale = _mm256_set1_ps(fx_simd_s16_out);
+    const __m256 lo = _mm256_set1_ps(-32768.f);
+    const __m256 hi = _mm256_set1_ps(32767.f);
+    const __m256 biasf = _mm256_set1_ps(32768.f);
+    const __m256i biasi = _mm256_set1_epi32(32768);
+    const __m128i bias16 = _mm_set1_epi16((short)0x8000);
+    const __m128i shuf = _mm_loadu_si128((const __m128i*)fx_simd_avx2_swap16);
+    int i = 0;
+
+    for(; i + 8 <= count; i += 8)
+    {
+        __m256 f = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i), scale), lo), hi);
+        __m256i v;
+        __m128i w;
+
+        if(Unsigned)
+            v = _mm256_sub_epi32(_mm256_cvttps_epi32(_mm256_add_ps(f, biasf)), biasi);
+        else
+            v = _mm256_cvttps_epi32(f);
+
+        w = _mm_packs_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+        if(Unsigned)
+            w = _mm_xor_si128(w, bias16);
+        if(Swap)
+            w = _mm_shuffle_epi8(w, shuf);
+
+        _mm_storeu_si128((__m128i*)(raw + i * 2), w);
+    }
+
+    return i;
+}
+
+template<bool Swap>
+FX_TARGET_AVX2
+static int fxAvx2Decode32(const uint8_t *raw, float *dst, int count)
+{
+    const __m256 scale = _mm256_set1_ps(fx_simd_s32_in);
+    const __m256i shuf = _mm256_loadu_si256((const __m256i*)fx_simd_avx2_swap32);
+    int i = 0;
+
+    for(; i + 8 <= count; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(raw + i * 4));
+        if(Swap)
+            v = _mm256_shuffle_epi8(v, shuf);
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+
+    return i;
+}
+
+template<bool Swap>
+FX_TARGET_AVX2
+static int fxAvx2Encode32(uint8_t *raw, const float *src, int count)
+{
+    const __m256 scale = _mm256_set1_ps(fx_simd_s32_out);
+    const __m256 lo = _mm256_set1_ps(-1.f);
+    const __m256 hi = _mm256_set1_ps(1.f);
+    const __m256 top = _mm256_set1_ps(fx_simd_s32_max);
+    const __m256i shuf = _mm256_loadu_si256((const __m256i*)fx_simd_avx2_swap32);
+    int i = 0;
+
+    for(; i + 8 <= count; i += 8)
+    {
+        __m256 f = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i), lo), hi);
+        __m256i v = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_mul_ps(f, scale), top));
+        if(Swap)
+            v = _mm256_shuffle_epi8(v, shuf);
+        _mm256_storeu_si256((__m256i*)(raw + i * 4), v);
+    }
+
+    return i;
+}
+
+template<bool Swap>
+FX_TARGET_AVX2
+static int fxAvx2DecodeF32(const uint8_t *raw, float *dst, int count)
+{
+    const __m256i shuf = _mm256_loadu_si256((const __m256i*)fx_simd_avx2_swap32);
+    int i = 0;
+
+    for(; i + 8 <= count; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(raw + i * 4));
+        if(Swap)
+            v = _mm256_shuffle_epi8(v, shuf);
+        _mm256_storeu_si256((__m256i*)(dst + i), v);
+    }
+
+    return i;
+}
+
+template<bool Swap>
+FX_TARGET_AVX2
+static int fxAvx2EncodeF32(uint8_t *raw, const float *src, int count)
+{
+    const __m256i shuf = _mm256_loadu_si256((const __m256i*)fx_simd_avx2_swap32);
+    int i = 0;
+
+    for(; i + 8 <= count; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+        if(Swap)
+            v = _mm256_shuffle_epi8(v, shuf);
+        _mm256_storeu_si256((__m256i*)(raw + i * 4), v);
+    }
+
+    return i;
+}
+
+FX_TARGET_AVX2
+static inline void fxAvx2Clamp(float *buf, int count, float lo, float hi)
+{
+    const __m256 vlo = _mm256_set1_ps(lo);
+    const __m256 vhi = _mm256_set1_ps(hi);
+    int i = 0;
+
+    for(; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(buf + i, _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(buf + i), vlo), vhi));
+
+    for(; i < count; ++i)
+        buf[i] = buf[i] < lo ? lo : (buf[i] > hi ? hi : buf[i]);
+}
+
+FX_TARGET_AVX2
+static inline int fxAvx2Fir8(const float *x, float *y, int count, const float *coef)
+{
+    __m256 c[8];
+    int i = 0;
+
+    for(int k = 0; k < 8; ++k)
+        c[k] = _mm256_set1_ps(coef[k]);
+
+    for(; i + 8 <= count; i += 8)
+    {
+        __m256 acc = _mm256_mul_ps(_mm256_loadu_ps(x + i + 7), c[7]);
+        for(int k = 0; k < 7; ++k)
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(x + i + k), c[k]));
+        _mm256_storeu_ps(y + i, acc);
+    }
+
+    return i;
+}
+
+FX_TARGET_AVX2
+static inline int fxAvx2Mix(float *dst, const float *a, const float *b, int count,
+                            float ga, float gb, float k, float lo, float hi)
+{
+    const __m256 vga = _mm256_set1_ps(ga);
+    const __m256 vgb = _mm256_set1_ps(gb);
+    const __m256 vk = _mm256_set1_ps(k);
+    const __m256 vlo = _mm256_set1_ps(lo);
+    const __m256 vhi = _mm256_set1_ps(hi);
+    int i = 0;
+
+    for(; i + 8 <= count; i += 8)
+    {
+        __m256 v = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(a + i), vga), _mm256_mul_ps(_mm256_loadu_ps(b + i), vgb));
+        _mm256_storeu_ps(dst + i, _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(v, vk), vlo), vhi));
+    }
+
+    return i;
+}
+
+FX_TARGET_AVX2
+static inline __m256 fxAvx2Undenormal(__m256 v)
+{
+    const __m256i exp = _mm256_and_si256(_mm256_castps_si256(v), _mm256_set1_epi32(0x7f800000));
+    return _mm256_andnot_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(exp, _mm256_setzero_si256())), v);
+}
+
+FX_TARGET_AVX2
+static inline float fxAvx2Sum8(__m256 v)
+{
+    __m128 h = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    h = _mm_add_ps(h, _mm_movehl_ps(h, h));
+    h = _mm_add_ss(h, _mm_shuffle_ps(h, h, 1));
+    return _mm_cvtss_f32(h);
+}
+
+//! Left and right combs are two vectors, lines are read by the gather and written by lanes
+FX_TARGET_AVX2
+static inline int fxAvx2Comb(FxCombLanes &cb, const float *in, float *out_l, float *out_r, int count)
+{
+    const __m256i one = _mm256_set1_epi32(1);
+    __m256 d1[2], d2[2], fb[2], st[2];
+    __m256i base[2], size[2], idx[2];
+    int32_t pos[FX_COMB_LANES];
+    float w[FX_COMB_LANES];
+
+    for(int h = 0; h < 2; ++h)
+    {
+        d1[h] = _mm256_loadu_ps(cb.damp1 + h * 8);
+        d2[h] = _mm256_loadu_ps(cb.damp2 + h * 8);
+        fb[h] = _mm256_loadu_ps(cb.feedback + h * 8);
+        st[h] = _mm256_loadu_ps(cb.store + h * 8);
+        base[h] = _mm256_loadu_si256((const __m256i*)(cb.base + h * 8));
+        size[h] = _mm256_loadu_si256((const __m256i*)(cb.size + h * 8));
+        idx[h] = _mm256_loadu_si256((const __m256i*)(cb.idx + h * 8));
+    }
+
+    for(int i = 0; i < count; ++i)
+    {
+        const __m256 x = _mm256_set1_ps(in[i]);
+        __m256 sum[2];
+
+        for(int h = 0; h < 2; ++h)
+        {
+            const __m256i p = _mm256_add_epi32(base[h], idx[h]);
+            __m256 v = fxAvx2Undenormal(_mm256_i32gather_ps(cb.arena, p, 4));
+
+            st[h] = fxAvx2Undenormal(_mm256_add_ps(_mm256_mul_ps(v, d2[h]), _mm256_mul_ps(st[h], d1[h])));
+            _mm256_storeu_ps(w + h * 8, _mm256_add_ps(x, _mm256_mul_ps(st[h], fb[h])));
+            _mm256_storeu_si256((__m256i*)(pos + h * 8), p);
+            sum[h] = v;
+
+            // Keep the index while it's below the size, wrap to zero otherwise
+            idx[h] = _mm256_add_epi32(idx[h], one);
+            idx[h] = _mm256_and_si256(idx[h], _mm256_cmpgt_epi32(size[h], idx[h]));
+        }
+
+        for(int k = 0; k < FX_COMB_LANES; ++k)
+            cb.arena[pos[k]] = w[k];
+
+        out_l[i] = fxAvx2Sum8(sum[0]);
+        out_r[i] = fxAvx2Sum8(sum[1]);
+    }
+
+    for(int h = 0; h < 2; ++h)
+    {
+        _mm256_storeu_ps(cb.store + h * 8, st[h]);
+        _mm256_storeu_si256((__m256i*)(cb.idx + h * 8), idx[h]);
+    }
+
+    return count;
+}
+FX_TARGET_AVX2
+static inline int fxAvx2FdnMatrix(const float *const *s, float *const *w, const float *in,
+                                  const float *in_gain, int count)
+{
+    const __m256 h = _mm256_set1_ps(fx_fdn_householder);
+    int i = 0;
+
+    for(; i + 8 <= count; i += 8)
+    {
+        const __m256 x = _mm256_loadu_ps(in + i);
+        __m256 sum = _mm256_loadu_ps(s[0] + i);
+
+        for(int k = 1; k < FX_FDN_LINES; ++k)
+            sum = _mm256_add_ps(sum, _mm256_loadu_ps(s[k] + i));
+        sum = _mm256_mul_ps(sum, h);
+
+        for(int k = 0; k < FX_FDN_LINES; ++k)
+        {
+            const __m256 m = _mm256_sub_ps(_mm256_loadu_ps(s[k] + i), sum);
+            _mm256_storeu_ps(w[k] + i, _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(in_gain[k])), m));
+        }
+    }
+
+    return i;
+}
+
+FX_TARGET_AVX2
+static inline int fxAvx2FdnTaps(const float *const *o, const float *tap_l, const float *tap_r,
+                                float *out_l, float *out_r, int count)
+{
+    int i = 0;
+
+    for(; i + 8 <= count; i += 8)
+    {
+        __m256 v = _mm256_loadu_ps(o[0] + i);
+        __m256 l = _mm256_mul_ps(v, _mm256_set1_ps(tap_l[0]));
+        __m256 r = _mm256_mul_ps(v, _mm256_set1_ps(tap_r[0]));
+
+        for(int k = 1; k < FX_FDN_LINES; ++k)
+        {
+            v = _mm256_loadu_ps(o[k] + i);
+            l = _mm256_add_ps(l, _mm256_mul_ps(v, _mm256_set1_ps(tap_l[k])));
+            r = _mm256_add_ps(r, _mm256_mul_ps(v, _mm256_set1_ps(tap_r[k])));
+        }
+
+        _mm256_storeu_ps(out_l + i, l);
+        _mm256_storeu_ps(out_r + i, r);
+    }
+
+    return i;
+}
+
+FX_TARGET_AVX2
+static inline int fxAvx2ComplexMac(float *y_re, float *y_im, const float *x_re, const float *x_im,
+                                   const float *h_re, const float *h_im, int count)
+{
+    int i = 0;
+
+    for(; i + 8 <= count; i += 8)
+    {
+        const __m256 xr = _mm256_loadu_ps(x_re + i), xi = _mm256_loadu_ps(x_im + i);
+        const __m256 hr = _mm256_loadu_ps(h_re + i), hi = _mm256_loadu_ps(h_im + i);
+        const __m256 pr = _mm256_sub_ps(_mm256_mul_ps(xr, hr), _mm256_mul_ps(xi, hi));
+        const __m256 pi = _mm256_add_ps(_mm256_mul_ps(xr, hi), _mm256_mul_ps(xi, hr));
+
+        _mm256_storeu_ps(y_re + i, _mm256_add_ps(_mm256_loadu_ps(y_re + i), pr));
+        _mm256_storeu_ps(y_im + i, _mm256_add_ps(_mm256_loadu_ps(y_im + i), pi));
+    }
+
+    return i;
+}
+FX_TARGET_AVX2
+static inline int fxAvx2LineLoadS16(const int16_t *src, float *dst, int count, float inv)
+{
+    const __m256 k = _mm256_set1_ps(inv);
+    int i = 0;
+
+    for(; i + 8 <= count; i += 8)
+    {
+        __m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), k));
+    }
+
+    return i;
+}
+
+FX_TARGET_AVX2
+static inline int fxAvx2LineStoreS16(int16_t *dst, const float *src, int count, float scale)
+{
+    const __m256 k = _mm256_set1_ps(scale);
+    const __m256 sign = _mm256_castsi256_ps(_mm256_set1_epi32(static_cast<int>(0x80000000u)));
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 lo = _mm256_set1_ps(-32768.f);
+    const __m256 hi = _mm256_set1_ps(32767.f);
+    int i = 0;
+
+    for(; i + 8 <= count; i += 8)
+    {
+        __m256 s = _mm256_mul_ps(_mm256_loadu_ps(src + i), k);
+        s = _mm256_add_ps(s, _mm256_or_ps(_mm256_and_ps(s, sign), half));
+        s = _mm256_min_ps(_mm256_max_ps(s, lo), hi);
+        __m256i v = _mm256_cvttps_epi32(s);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                         _mm_packs_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)));
+    }
+
+    return i;
+}
+
+FX_TARGET_F16C
+static inline int fxAvx2LineLoadF16(const uint16_t *src, float *dst, int count)
+{
+    int i = 0;
+
+    for(; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i))));
+
+    return i;
+}
+
+FX_TARGET_F16C
+static inline int fxAvx2LineStoreF16(uint16_t *dst, const float *src, int count)
+{
+    int i = 0;
+
+    for(; i + 8 <= count; i += 8)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                         _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+
+    return i;
+}
+
+#endif // FX_SIMD_AVX2
+
+
+/* ============================== NEON ============================== */
+
+#if defined(FX_SIMD_NEON)
+template<bool Unsigned>
+static int fxNeonDecode8(const uint8_t *raw, float *dst, int count)
+{
+    const float32x4_t scale = vdupq_n_f32(fx_simd_s8_in);
+    const uint8x16_t bias = vdupq_n_u8(0x80);
+    int i = 0;
+
+    for(; i + 16 <= count; i += 16)
+    {
+        uint8x16_t u = vld1q_u8(raw + i);
+        if(Unsigned)
+            u = veorq_u8(u, bias);
+
+        int8x16_t v = vreinterpretq_s8_u8(u);
+        int16x8_t lo = vmovl_s8(vget_low_s8(v));
+        int16x8_t hi = vmovl_s8(vget_high_s8(v));
+
+        vst1q_f32(dst + i + 0,  vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(lo))), scale));
+        vst1q_f32(dst + i + 4,  vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(lo))), scale));
+        vst1q_f32(dst + i + 8,  vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(hi))), scale));
+        vst1q_f32(dst + i + 12, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(hi))), scale));
+    }
+
+    return i;
+}
+
+template<bool Unsigned>
+static int fxNeonEncode8(uint8_t *raw, const float *src, int count)
+{
+    const float32x4_t scale = vdupq_n_f32(fx_simd_s8_out);
+    const float32x4_t lo = vdupq_n_f32(-128.f);
+    const float32x4_t hi = vdupq_n_f32(127.f);
+    const float32x4_t bias = vdupq_n_f32(128.f);
+    int32x4_t v[4];
+    int i = 0;
+
+    for(; i + 16 <= count; i += 16)
+    {
+        for(int j = 0; j < 4; ++j)
+        {
+            float32x4_t f = vminq_f32(vmaxq_f32(vmulq_f32(vld1q_f32(src + i + j * 4), scale), lo), hi);
+            if(Unsigned)
+                f = vaddq_f32(f, bias);
+            v[j] = vcvtq_s32_f32(f);
+        }
+
+        int16x8_t w0 = vcombine_s16(vqmovn_s32(v[0]), vqmovn_s32(v[1]));
+        int16x8_t w1 = vcombine_s16(vqmovn_s32(v[2]), vqmovn_s32(v[3]));
+        if(Unsigned)
+            vst1q_u8(raw + i, vcombine_u8(vqmovun_s16(w0), vqmovun_s16(w1)));
+        else
+            vst1q_u8(raw + i, vreinterpretq_u8_s8(vcombine_s8(vqmovn_s16(w0), vqmovn_s16(w1))));
+    }
+
+    return i;
+}
+
+template<bool Swap, bool Unsigned>
+static int fxNeonDecode16(const uint8_t *raw, float *dst, int count)
+{
+    const float32x4_t scale = vdupq_n_f32(fx_simd_s16_in);
+    const uint16x8_t bias = vdupq_n_u16(0x8000);
+    int i = 0;
+
+    for(; i + 8 <= count; i += 8)
+    {
+        uint8x16_t b = vld1q_u8(raw + i * 2);
+        if(Swap)
+            b = vrev16q_u8(b);
+
+        uint16x8_t u = vreinterpretq_u16_u8(b);
+        if(Unsigned)
+            u = veorq_u16(u, bias);
+
+        int16x8_t v = vreinterpretq_s16_u16(u);
+        vst1q_f32(dst + i + 0, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), scale));
+        vst1q_f32(dst + i + 4, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), scale));
+    }
+
+    return i;
+}
+
+template<bool Swap, bool Unsigned>
+static int fxNeonEncode16(uint8_t *raw, const float *src, int count)
+{
+    const float32x4_t scale = vdupq_n_f32(fx_simd_s16_out);
+    const float32x4_t lo = vdupq_n_f32(-32768.f);
+    const float32x4_t hi = vdupq_n_f32(32767.f);
+    const float32x4_t biasf = vdupq_n_f32(32768.f);
+    const int32x4_t biasi = vdupq_n_s32(32768);
+    const uint16x8_t bias16 = vdupq_n_u16(0x8000);
+    int i = 0;
+
+    for(; i + 8 <= count; i += 8)
+    {
+        float32x4_t f0 = vminq_f32(vmaxq_f32(vmulq_f32(vld1q_f32(src + i + 0), scale), lo), hi);
+        float32x4_t f1 = vminq_f32(vmaxq_f32(vmulq_f32(vld1q_f32(src + i + 4), scale), lo), hi);
+        int32x4_t v0, v1;
+        uint16x8_t u;
+
+        if(Unsigned)
+        {
+            v0 = vsubq_s32(vcvtq_s32_f32(vaddq_f32(f0, biasf)), biasi);
+            v1 = vsubq_s32(vcvtq_s32_f32(vaddq_f32(f1, biasf)), biasi);
+            u = veorq_u16(vreinterpretq_u16_s16(vcombine_s16(vqmovn_s32(v0), vqmovn_s32(v1))), bias16);
+        }
+        else
+        {
+            v0 = vcvtq_s32_f32(f0);
+            v1 = vcvtq_s32_f32(f1);
+            u = vreinterpretq_u16_s16(vcombine_s16(vqmovn_s32(v0), vqmovn_s32(v1)));
+        }
+
+        uint8x16_t b = vreinterpretq_u8_u16(u);
+        if(Swap)
+            b = vrev16q_u8(b);
+        vst1q_u8(raw + i * 2, b);
+    }
+
+    return i;
+}
+
+template<bool Swap>
+static int fxNeonDecode32(const uint8_t *raw, float *dst, int count)
+{
+    const float32x4_t scale = vdupq_n_f32(fx_simd_s32_in);
+    int i = 0;
+
+    for(; i + 4 <= count; i += 4)
+    {
+        uint8x16_t b = vld1q_u8(raw + i * 4);
+        if(Swap)
+            b = vrev32q_u8(b);
+        vst1q_f32(dst + i, vmulq_f32(vcvtq_f32_s32(vreinterpretq_s32_u8(b)), scale));
+    }
+
+    return i;
+}
+
+template<bool Swap>
+static int fxNeonEncode32(uint8_t *raw, const float *src, int count)
+{
+    const float32x4_t scale = vdupq_n_f32(fx_simd_s32_out);
+    const float32x4_t lo = vdupq_n_f32(-1.f);
+    const float32x4_t hi = vdupq_n_f32(1.f);
+    const float32x4_t top = vdupq_n_f32(fx_simd_s32_max);
+    int i = 0;
+
+    for(; i + 4 <= count; i += 4)
+    {
+        float32x4_t f = vminq_f32(vmaxq_f32(vld1q_f32(src + i), lo), hi);
+        uint8x16_t b = vreinterpretq_u8_s32(vcvtq_s32_f32(vminq_f32(vmulq_f32(f, scale), top)));
+        if(Swap)
+            b = vrev32q_u8(b);
+        vst1q_u8(raw + i * 4, b);
+    }
+
+    return i;
+}
+
+template<bool Swap>
+static int fxNeonDecodeF32(const uint8_t *raw, float *dst, int count)
+{
+    int i = 0;
+
+    for(; i + 4 <= count; i += 4)
+    {
+        uint8x16_t b = vld1q_u8(raw + i * 4);
+        if(Swap)
+            b = vrev32q_u8(b);
+        vst1q_f32(dst + i, vreinterpretq_f32_u8(b));
+    }
+
+    return i;
+}
+
+template<bool Swap>
+static int fxNeonEncodeF32(uint8_t *raw, const float *src, int count)
+{
+    int i = 0;
+
+    for(; i + 4 <= count; i += 4)
+    {
+        uint8x16_t b = vreinterpretq_u8_f32(vld1q_f32(src + i));
+        if(Swap)
+            b = vrev32q_u8(b);
+        vst1q_u8(raw + i * 4, b);
+    }
+
+    return i;
+}
+
+static inline void fxNeonClamp(float *buf, int count, float lo, float hi)
+{
+    const float32x4_t vlo = vdupq_n_f32(lo);
+    const float32x4_t vhi = vdupq_n_f32(hi);
+    int i = 0;
+
+    for(; i + 4 <= count; i += 4)
+        vst1q_f32(buf + i, vminq_f32(vmaxq_f32(vld1q_f32(buf + i), vlo), vhi));
+
+    for(; i < count; ++i)
+        buf[i] = buf[i] < lo ? lo : (buf[i] > hi ? hi : buf[i]);
+}
+
+template<bool Unsigned>
+static int fxNeonTpdf(float *buf, int count, uint32_t *lanes, float scale)
+{
+    const float32x4_t vscale = vdupq_n_f32(scale);
+    const float32x4_t vinv = vdupq_n_f32(1.f / scale);
+    const float32x4_t half = vdupq_n_f32(0.5f);
+    const float32x4_t one = vdupq_n_f32(1.f);
+    const float32x4_t unit = vdupq_n_f32(fx_simd_tpdf_unit);
+    const uint32x4_t sign = vdupq_n_u32(0x80000000);
+    const uint32x4_t low = vdupq_n_u32(0xFFFF);
+    uint32x4_t s = vld1q_u32(lanes);
+    int i = 0;
+
+    for(; i + 4 <= count; i += 4)
+    {
+        // xorshift32 per lane
+        s = veorq_u32(s, vshlq_n_u32(s, 13));
+        s = veorq_u32(s, vshrq_n_u32(s, 17));
+        s = veorq_u32(s, vshlq_n_u32(s, 5));
+
+        // Difference of two uniform values is triangular in -1...+1 LSB
+        int32x4_t r = vsubq_s32(vreinterpretq_s32_u32(vandq_u32(s, low)), vreinterpretq_s32_u32(vshrq_n_u32(s, 16)));
+        float32x4_t d = vmulq_f32(vcvtq_f32_s32(r), unit);
+        float32x4_t y = vaddq_f32(vaddq_f32(vmulq_f32(vld1q_f32(buf + i), vscale), d), half);
+        float32x4_t t = vcvtq_f32_s32(vcvtq_s32_f32(y));
+        float32x4_t q = vsubq_f32(t, vreinterpretq_f32_u32(vandq_u32(vcgtq_f32(t, y), vreinterpretq_u32_f32(one))));
+        float32x4_t o = Unsigned ? half : vreinterpretq_f32_u32(vorrq_u32(vandq_u32(vreinterpretq_u32_f32(q), sign),
+                                                                           vreinterpretq_u32_f32(half)));
+
+        vst1q_f32(buf + i, vmulq_f32(vaddq_f32(q, o), vinv));
+    }
+
+    vst1q_u32(lanes, s);
+
+    return i;
+}
+
+static inline int fxNeonFir8(const float *x, float *y, int count, const float *coef)
+{
+    float32x4_t c[8];
+    int i = 0;
+
+    for(int k = 0; k < 8; ++k)
+        c[k] = vdupq_n_f32(coef[k]);
+
+    // Separate multiply and add to round the same way as the scalar code
+    for(; i + 4 <= count; i += 4)
+    {
+        float32x4_t acc = vmulq_f32(vld1q_f32(x + i + 7), c[7]);
+        for(int k = 0; k < 7; ++k)
+            acc = vaddq_f32(acc, vmulq_f32(vld1q_f32(x + i + k), c[k]));
+        vst1q_f32(y + i, acc);
+    }
+
+    return i;
+}
+
+static inline int fxNeonMix(float *dst, const float *a, const float *b, int count,
+                            float ga, float gb, float k, float lo, float hi)
+{
+    const float32x4_t vga = vdupq_n_f32(ga);
+    const float32x4_t vgb = vdupq_n_f32(gb);
+    const float32x4_t vk = vdupq_n_f32(k);
+    const float32x4_t vlo = vdupq_n_f32(lo);
+    const float32x4_t vhi = vdupq_n_f32(hi);
+    int i = 0;
+
+    for(; i + 4 <= count; i += 4)
+    {
+        float32x4_t v = vaddq_f32(vmulq_f32(vld1q_f32(a + i), vga), vmulq_f32(vld1q_f32(b + i), vgb));
+        vst1q_f32(dst + i, vminq_f32(vmaxq_f32(vmulq_f32(v, vk), vlo), vhi));
+    }
+
+    return i;
+}
+
+static inline float32x4_t fxNeonUndenormal(float32x4_t v)
+{
+    const uint32x4_t exp = vandq_u32(vreinterpretq_u32_f32(v), vdupq_n_u32(0x7f800000));
+    return vreinterpretq_f32_u32(vbicq_u32(vreinterpretq_u32_f32(v), vceqq_u32(exp, vdupq_n_u32(0))));
+}
+
+static inline void fxNeonTranspose4(float32x4_t *r)
+{
+    float32x4x2_t a = vtrnq_f32(r[0], r[1]);
+    float32x4x2_t b = vtrnq_f32(r[2], r[3]);
+
+    r[0] = vcombine_f32(vget_low_f32(a.val[0]), vget_low_f32(b.val[0]));
+    r[1] = vcombine_f32(vget_low_f32(a.val[1]), vget_low_f32(b.val[1]));
+    r[2] = vcombine_f32(vget_high_f32(a.val[0]), vget_high_f32(b.val[0]));
+    r[3] = vcombine_f32(vget_high_f32(a.val[1]), vget_high_f32(b.val[1]));
+}
+
+//! Four lines advance together, the loaded samples get transposed into lanes and back
+static inline int fxNeonCombRun4(float *const *d, float *store, const float *damp1, const float *damp2,
+                                 const float *feedback, const float *in, float *out, bool first, int run)
+{
+    const float32x4_t d1 = vld1q_f32(damp1);
+    const float32x4_t d2 = vld1q_f32(damp2);
+    const float32x4_t fb = vld1q_f32(feedback);
+    float32x4_t st = vld1q_f32(store);
+    int j = 0;
+
+    for(; j + 4 <= run; j += 4)
+    {
+        float32x4_t v[4], w[4];
+
+        for(int k = 0; k < 4; ++k)
+            v[k] = vld1q_f32(d[k] + j);
+        fxNeonTranspose4(v);
+
+        // Separate multiply and add to round the same way as the scalar code
+        for(int s = 0; s < 4; ++s)
+        {
+            v[s] = fxNeonUndenormal(v[s]);
+            st = fxNeonUndenormal(vaddq_f32(vmulq_f32(v[s], d2), vmulq_f32(st, d1)));
+            w[s] = vaddq_f32(vdupq_n_f32(in[j + s]), vmulq_f32(st, fb));
+        }
+
+        fxNeonTranspose4(w);
+        fxNeonTranspose4(v);
+
+        float32x4_t acc = first ? v[0] : vaddq_f32(vld1q_f32(out + j), v[0]);
+        for(int k = 0; k < 4; ++k)
+        {
+            vst1q_f32(d[k] + j, w[k]);
+            if(k > 0)
+                acc = vaddq_f32(acc, v[k]);
+        }
+        vst1q_f32(out + j, acc);
+    }
+
+    vst1q_f32(store, st);
+
+    return j;
+}
+//! Comb lines of the group, every vector is one sample of all models
+static inline void fxNeonCombModels(float *const *d, float *store, const float *damp1, const float *damp2,
+                                    const float *feedback, const float *in, float *out, bool first, int run)
+{
+    const float32x4_t d1 = vld1q_f32(damp1);
+    const float32x4_t d2 = vld1q_f32(damp2);
+    const float32x4_t fb = vld1q_f32(feedback);
+    float32x4_t st[FX_COMB_GROUP];
+
+    for(int k = 0; k < FX_COMB_GROUP; ++k)
+        st[k] = vld1q_f32(store + k * FX_COMB_MODELS);
+
+    for(int j = 0; j < run * FX_COMB_MODELS; j += FX_COMB_MODELS)
+    {
+        const float32x4_t x = vld1q_f32(in + j);
+        float32x4_t acc = first ? vdupq_n_f32(0.0f) : vld1q_f32(out + j);
+
+        // Separate multiply and add to round the same way as the scalar code
+        for(int k = 0; k < FX_COMB_GROUP; ++k)
+        {
+            float32x4_t v = fxNeonUndenormal(vld1q_f32(d[k] + j));
+            st[k] = fxNeonUndenormal(vaddq_f32(vmulq_f32(v, d2), vmulq_f32(st[k], d1)));
+            vst1q_f32(d[k] + j, vaddq_f32(x, vmulq_f32(st[k], fb)));
+            acc = first && k == 0 ? v : vaddq_f32(acc, v);
+        }
+
+        vst1q_f32(out + j, acc);
+    }
+
+    for(int k = 0; k < FX_COMB_GROUP; ++k)
+        vst1q_f32(store + k * FX_COMB_MODELS, st[k]);
+}
+
+static inline void fxNeonAllpassModels(float *d, float feedback, float *io, int run)
+{
+    const float32x4_t fb = vdupq_n_f32(feedback);
+
+    for(int j = 0; j < run * FX_COMB_MODELS; j += FX_COMB_MODELS)
+    {
+        const float32x4_t x = vld1q_f32(io + j);
+        const float32x4_t b = fxNeonUndenormal(vld1q_f32(d + j));
+        vst1q_f32(io + j, vsubq_f32(b, x));
+        vst1q_f32(d + j, vaddq_f32(x, vmulq_f32(b, fb)));
+    }
+}
+//! Loop filters of all FDN lines, both halves of lines go through the same loop to overlap their latencies
+static inline int fxNeonFdnDamp(const float *const *o, float *const *s, float *store,
+                                const float *gain, float damp, int count)
+{
+    const float32x4_t d = vdupq_n_f32(damp);
+    float32x4_t g[2], st[2];
+    int i = 0;
+
+    for(int h = 0; h < 2; ++h)
+    {
+        g[h] = vld1q_f32(gain + h * 4);
+        st[h] = vld1q_f32(store + h * 4);
+    }
+
+    for(; i + 4 <= count; i += 4)
+    {
+        float32x4_t v[2][4];
+
+        for(int h = 0; h < 2; ++h)
+        {
+            for(int k = 0; k < 4; ++k)
+                v[h][k] = vld1q_f32(o[h * 4 + k] + i);
+            fxNeonTranspose4(v[h]);
+        }
+
+        for(int j = 0; j < 4; ++j)
+        {
+            for(int h = 0; h < 2; ++h)
+            {
+                st[h] = fxNeonUndenormal(vaddq_f32(vmulq_f32(v[h][j], g[h]), vmulq_f32(st[h], d)));
+                v[h][j] = st[h];
+            }
+        }
+
+        for(int h = 0; h < 2; ++h)
+        {
+            fxNeonTranspose4(v[h]);
+            for(int k = 0; k < 4; ++k)
+                vst1q_f32(s[h * 4 + k] + i, v[h][k]);
+        }
+    }
+
+    for(int h = 0; h < 2; ++h)
+        vst1q_f32(store + h * 4, st[h]);
+
+    return i;
+}
+
+static inline int fxNeonFdnMatrix(const float *const *s, float *const *w, const float *in,
+                                  const float *in_gain, int count)
+{
+    const float32x4_t h = vdupq_n_f32(fx_fdn_householder);
+    int i = 0;
+
+    for(; i + 4 <= count; i += 4)
+    {
+        const float32x4_t x = vld1q_f32(in + i);
+        float32x4_t sum = vld1q_f32(s[0] + i);
+
+        for(int k = 1; k < FX_FDN_LINES; ++k)
+            sum = vaddq_f32(sum, vld1q_f32(s[k] + i));
+        sum = vmulq_f32(sum, h);
+
+        // Separate multiply and add to round the same way as the scalar code
+        for(int k = 0; k < FX_FDN_LINES; ++k)
+        {
+            const float32x4_t m = vsubq_f32(vld1q_f32(s[k] + i), sum);
+            vst1q_f32(w[k] + i, vaddq_f32(vmulq_f32(x, vdupq_n_f32(in_gain[k])), m));
+        }
+    }
+
+    return i;
+}
+
+static inline int fxNeonFdnTaps(const float *const *o, const float *tap_l, const float *tap_r,
+                                float *out_l, float *out_r, int count)
+{
+    int i = 0;
+
+    for(; i + 4 <= count; i += 4)
+    {
+        float32x4_t v = vld1q_f32(o[0] + i);
+        float32x4_t l = vmulq_f32(v, vdupq_n_f32(tap_l[0]));
+        float32x4_t r = vmulq_f32(v, vdupq_n_f32(tap_r[0]));
+
+        for(int k = 1; k < FX_FDN_LINES; ++k)
+        {
+            v = vld1q_f32(o[k] + i);
+            l = vaddq_f32(l, vmulq_f32(v, vdupq_n_f32(tap_l[k])));
+            r = vaddq_f32(r, vmulq_f32(v, vdupq_n_f32(tap_r[k])));
+        }
+
+        vst1q_f32(out_l + i, l);
+        vst1q_f32(out_r + i, r);
+    }
+
+    return i;
+}
+
+static inline int fxNeonComplexMac(float *y_re, float *y_im, const float *x_re, const float *x_im,
+                                   const float *h_re, const float *h_im, int count)
+{
+    int i = 0;
+
+    for(; i + 4 <= count; i += 4)
+    {
+        const float32x4_t xr = vld1q_f32(x_re + i), xi = vld1q_f32(x_im + i);
+        const float32x4_t hr = vld1q_f32(h_re + i), hi = vld1q_f32(h_im + i);
+        const float32x4_t pr = vsubq_f32(vmulq_f32(xr, hr), vmulq_f32(xi, hi));
+        const float32x4_t pi = vaddq_f32(vmulq_f32(xr, hi), vmulq_f32(xi, hr));
+
+        vst1q_f32(y_re + i, vaddq_f32(vld1q_f32(y_re + i), pr));
+        vst1q_f32(y_im + i, vaddq_f32(vld1q_f32(y_im + i), pi));
+    }
+
+    return i;
+}
+static inline int fxNeonLineLoadS16(const int16_t *src, float *dst, int count, float inv)
+{
+    const float32x4_t k = vdupq_n_f32(inv);
+    int i = 0;
+
+    for(; i + 8 <= count; i += 8)
+    {
+        int16x8_t v = vld1q_s16(src + i);
+        vst1q_f32(dst + i, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), k));
+        vst1q_f32(dst + i + 4, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), k));
+    }
+
+    return i;
+}
+
+static inline int32x4_t fxNeonLineRound(float32x4_t v, float32x4_t k)
+{
+    const uint32x4_t sign = vdupq_n_u32(0x80000000u);
+    const uint32x4_t half = vreinterpretq_u32_f32(vdupq_n_f32(0.5f));
+    float32x4_t s = vmulq_f32(v, k);
+
+    s = vaddq_f32(s, vreinterpretq_f32_u32(vorrq_u32(vandq_u32(vreinterpretq_u32_f32(s), sign), half)));
+    s = vminq_f32(vmaxq_f32(s, vdupq_n_f32(-32768.f)), vdupq_n_f32(32767.f));
+    return vcvtq_s32_f32(s);
+}
+
+static inline int fxNeonLineStoreS16(int16_t *dst, const float *src, int count, float scale)
+{
+    const float32x4_t k = vdupq_n_f32(scale);
+    int i = 0;
+
+    for(; i + 8 <= count; i += 8)
+    {
+        int16x4_t lo = vmovn_s32(fxNeonLineRound(vld1q_f32(src + i), k));
+        int16x4_t hi = vmovn_s32(fxNeonLineRound(vld1q_f32(src + i + 4), k));
+        vst1q_s16(dst + i, vcombine_s16(lo, hi));
+    }
+
+    return i;
+}
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#   define FX_SIMD_NEON_F16
+static inline int fxNeonLineLoadF16(const uint16_t *src, float *dst, int count)
+{
+    int i = 0;
+
+    for(; i + 4 <= count; i += 4)
+        vst1q_f32(dst + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(src + i))));
+
+    return i;
+}
+
+static inline int fxNeonLineStoreF16(uint16_t *dst, const float *src, int count)
+{
+    int i = 0;
+
+    for(; i + 4 <= count; i += 4)
+        vst1_u16(dst + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(src + i))));
+
+    return i;
+}
+#endif
+
+#endif // FX_SIMD_NEON
+
+
+/* ============================ Dispatch ============================ */
+
+#if defined(FX_SIMD_SSE2)
+template<bool SwapLsb, bool SwapMsb>
+static bool fxSse2Select(uint16_t format, FxSimdDecodeCB &decode, FxSimdEncodeCB &encode)
+{
+    switch(format)
+    {
+    case AUDIO_U8:
+        decode = fxSse2Decode8<true>;
+        encode = fxSse2Encode8<true>;
+        return true;
+    case AUDIO_S8:
+        decode = fxSse2Decode8<false>;
+        encode = fxSse2Encode8<false>;
+        return true;
+    case AUDIO_S16LSB:
+        decode = fxSse2Decode16<SwapLsb, false>;
+        encode = fxSse2Encode16<SwapLsb, false>;
+        return true;
+    case AUDIO_S16MSB:
+        decode = fxSse2Decode16<SwapMsb, false>;
+        encode = fxSse2Encode16<SwapMsb, false>;
+        return true;
+    case AUDIO_U16LSB:
+        decode = fxSse2Decode16<SwapLsb, true>;
+        encode = fxSse2Encode16<SwapLsb, true>;
+        return true;
+    case AUDIO_U16MSB:
+        decode = fxSse2Decode16<SwapMsb, true>;
+        encode = fxSse2Encode16<SwapMsb, true>;
+        return true;
+    case AUDIO_S32LSB:
+        decode = fxSse2Decode32<SwapLsb>;
+        encode = fxSse2Encode32<SwapLsb>;
+        return true;
+    case AUDIO_S32MSB:
+        decode = fxSse2Decode32<SwapMsb>;
+        encode = fxSse2Encode32<SwapMsb>;
+        return true;
+    case AUDIO_F32LSB:
+        decode = fxSse2DecodeF32<SwapLsb>;
+        encode = fxSse2EncodeF32<SwapLsb>;
+        return true;
+    case AUDIO_F32MSB:
+        decode = fxSse2DecodeF32<SwapMsb>;
+        encode = fxSse2EncodeF32<SwapMsb>;
+        return true;
+    default:
+        return false;
+    }
+}
+#endif
+
+#if defined(FX_SIMD_AVX2)
+template<bool SwapLsb, bool SwapMsb>
+static bool fxAvx2Select(uint16_t format, FxSimdDecodeCB &decode, FxSimdEncodeCB &encode)
+{
+    switch(format)
+    {
+    case AUDIO_U8:
+        decode = fxAvx2Decode8<true>;
+        encode = fxAvx2Encode8<true>;
+        return true;
+    case AUDIO_S8:
+        decode = fxAvx2Decode8<false>;
+        encode = fxAvx2Encode8<false>;
+        return true;
+    case AUDIO_S16LSB:
+        decode = fxAvx2Decode16<SwapLsb, false>;
+        encode = fxAvx2Encode16<SwapLsb, false>;
+        return true;
+    case AUDIO_S16MSB:
+        decode = fxAvx2Decode16<SwapMsb, false>;
+        encode = fxAvx2Encode16<SwapMsb, false>;
+        return true;
+    case AUDIO_U16LSB:
+        decode = fxAvx2Decode16<SwapLsb, true>;
+        encode = fxAvx2Encode16<SwapLsb, true>;
+        return true;
+    case AUDIO_U16MSB:
+        decode = fxAvx2Decode16<SwapMsb, true>;
+        encode = fxAvx2Encode16<SwapMsb, true>;
+        return true;
+    case AUDIO_S32LSB:
+        decode = fxAvx2Decode32<SwapLsb>;
+        encode = fxAvx2Encode32<SwapLsb>;
+        return true;
+    case AUDIO_S32MSB:
+        decode = fxAvx2Decode32<SwapMsb>;
+        encode = fxAvx2Encode32<SwapMsb>;
+        return true;
+    case AUDIO_F32LSB:
+        decode = fxAvx2DecodeF32<SwapLsb>;
+        encode = fxAvx2EncodeF32<SwapLsb>;
+        return true;
+    case AUDIO_F32MSB:
+        decode = fxAvx2DecodeF32<SwapMsb>;
+        encode = fxAvx2EncodeF32<SwapMsb>;
+        return true;
+    default:
+        return false;
+    }
+}
+#endif
+
+#if defined(FX_SIMD_NEON)
+template<bool SwapLsb, bool SwapMsb>
+static bool fxNeonSelect(uint16_t format, FxSimdDecodeCB &decode, FxSimdEncodeCB &encode)
+{
+    switch(format)
+    {
+    case AUDIO_U8:
+        decode = fxNeonDecode8<true>;
+        encode = fxNeonEncode8<true>;
+        return true;
+    case AUDIO_S8:
+        decode = fxNeonDecode8<false>;
+        encode = fxNeonEncode8<false>;
+        return true;
+    case AUDIO_S16LSB:
+        decode = fxNeonDecode16<SwapLsb, false>;
+        encode = fxNeonEncode16<SwapLsb, false>;
+        return true;
+    case AUDIO_S16MSB:
+        decode = fxNeonDecode16<SwapMsb, false>;
+        encode = fxNeonEncode16<SwapMsb, false>;
+        return true;
+    case AUDIO_U16LSB:
+        decode = fxNeonDecode16<SwapLsb, true>;
+        encode = fxNeonEncode16<SwapLsb, true>;
+        return true;
+    case AUDIO_U16MSB:
+        decode = fxNeonDecode16<SwapMsb, true>;
+        encode = fxNeonEncode16<SwapMsb, true>;
+        return true;
+    case AUDIO_S32LSB:
+        decode = fxNeonDecode32<SwapLsb>;
+        encode = fxNeonEncode32<SwapLsb>;
+        return true;
+    case AUDIO_S32MSB:
+        decode = fxNeonDecode32<SwapMsb>;
+        encode = fxNeonEncode32<SwapMsb>;
+        return true;
+    case AUDIO_F32LSB:
+        decode = fxNeonDecodeF32<SwapLsb>;
+        encode = fxNeonEncodeF32<SwapLsb>;
+        return true;
+    case AUDIO_F32MSB:
+        decode = fxNeonDecodeF32<SwapMsb>;
+        encode = fxNeonEncodeF32<SwapMsb>;
+        return true;
+    default:
+        return false;
+    }
+}
+#endif
+
+/**
+ * @brief Choose the vector kernels of the detected CPU for the given format
+ * @param format Audio format (one of AUDIO_*)
+ * @param decode Output decode kernel
+ * @param encode Output encode kernel
+ * @return true if kernels are available, false to use the scalar code
+ */
+template<bool SwapLsb, bool SwapMsb>
+static bool fxSimdSelect(uint16_t format, FxSimdDecodeCB &decode, FxSimdEncodeCB &encode)
+{
+    decode = nullptr;
+    encode = nullptr;
+
+    switch(fxSimdLevel())
+    {
+#if defined(FX_SIMD_AVX2)
+    case FX_SIMD_LEVEL_AVX2:
+        return fxAvx2Select<SwapLsb, SwapMsb>(format, decode, encode);
+#endif
+#if defined(FX_SIMD_SSE2)
+    case FX_SIMD_LEVEL_SSE2:
+        return fxSse2Select<SwapLsb, SwapMsb>(format, decode, encode);
+#endif
+#if defined(FX_SIMD_NEON)
+    case FX_SIMD_LEVEL_NEON:
+        return fxNeonSelect<SwapLsb, SwapMsb>(format, decode, encode);
+#endif
+    default:
+        break;
+    }
+
+    (void)format;
+    return false;
+}
+
+/**
+ * @brief Saturate every sample of the buffer into the lo...hi range
+ */
+static inline void fxClampBlock(float *buf, int count, float lo, float hi)
+{
+    switch(fxSimdLevel())
+    {
+#if defined(FX_SIMD_AVX2)
+    case FX_SIMD_LEVEL_AVX2:
+        fxAvx2Clamp(buf, count, lo, hi);
+        return;
+#endif
+#if defined(FX_SIMD_SSE2)
+    case FX_SIMD_LEVEL_SSE2:
+        fxSse2Clamp(buf, count, lo, hi);
+        return;
+#endif
+#if defined(FX_SIMD_NEON)
+    case FX_SIMD_LEVEL_NEON:
+        fxNeonClamp(buf, count, lo, hi);
+        return;
+#endif
+    default:
+        break;
+    }
+
+    for(int i = 0; i < count; ++i)
+        buf[i] = buf[i] < lo ? lo : (buf[i] > hi ? hi : buf[i]);
+}
+
+/**
+ * @brief Requantize the samples with the triangular dither
+ * @param buf Samples to process in place
+ * @param count Number of samples
+ * @param lanes State of four xorshift32 generators
+ * @param scale Number of output steps per 1.0 of the float sample
+ * @param is_unsigned Is output format unsigned?
+ * @return number of processed samples, the rest must be processed by the scalar code
+ */
+static inline int fxTpdfBlock(float *buf, int count, uint32_t *lanes, float scale, bool is_unsigned)
+{
+    switch(fxSimdLevel())
+    {
+#if defined(FX_SIMD_SSE2)
+    case FX_SIMD_LEVEL_AVX2:
+    case FX_SIMD_LEVEL_SSE2:
+        return is_unsigned ?
+                    fxSse2Tpdf<true>(buf, count, lanes, scale) :
+                    fxSse2Tpdf<false>(buf, count, lanes, scale);
+#endif
+#if defined(FX_SIMD_NEON)
+    case FX_SIMD_LEVEL_NEON:
+        return is_unsigned ?
+                    fxNeonTpdf<true>(buf, count, lanes, scale) :
+                    fxNeonTpdf<false>(buf, count, lanes, scale);
+#endif
+    default:
+        break;
+    }
+
+    (void)buf;
+    (void)count;
+    (void)lanes;
+    (void)scale;
+    (void)is_unsigned;
+    return 0;
+}
+
+/**
+ * @brief 8-tap FIR filter: y[i] = x[i + 7] * coef[7] + x[i] * coef[0] + ... + x[i + 6] * coef[6]
+ * @param x Input, must contain count + 7 samples, the oldest first
+ * @param y Output of count samples
+ * @param count Number of output samples
+ * @param coef Coefficients, coef[7] is applied to the newest sample
+ */
+static inline void fxFir8Block(const float *x, float *y, int count, const float *coef)
+{
+    int i = 0;
+
+    switch(fxSimdLevel())
+    {
+#if defined(FX_SIMD_AVX2)
+    case FX_SIMD_LEVEL_AVX2:
+        i = fxAvx2Fir8(x, y, count, coef);
+        break;
+#endif
+#if defined(FX_SIMD_SSE2)
+    case FX_SIMD_LEVEL_SSE2:
+        i = fxSse2Fir8(x, y, count, coef);
+        break;
+#endif
+#if defined(FX_SIMD_NEON)
+    case FX_SIMD_LEVEL_NEON:
+        i = fxNeonFir8(x, y, count, coef);
+        break;
+#endif
+    default:
+        break;
+    }
+
+    for(; i < count; ++i)
+    {
+        float acc = x[i + 7] * coef[7];
+        for(int k = 0; k < 7; ++k)
+            acc += x[i + k] * coef[k];
+        y[i] = acc;
+    }
+}
+
+/**
+ * @brief Weighted sum of two signals with saturation: dst[i] = clamp((a[i] * ga + b[i] * gb) * k, lo, hi)
+ */
+static inline void fxMixBlock(float *dst, const float *a, const float *b, int count,
+                              float ga, float gb, float k, float lo, float hi)
+{
+    int i = 0;
+
+    switch(fxSimdLevel())
+    {
+#if defined(FX_SIMD_AVX2)
+    case FX_SIMD_LEVEL_AVX2:
+        i = fxAvx2Mix(dst, a, b, count, ga, gb, k, lo, hi);
+        break;
+#endif
+#if defined(FX_SIMD_SSE2)
+    case FX_SIMD_LEVEL_SSE2:
+        i = fxSse2Mix(dst, a, b, count, ga, gb, k, lo, hi);
+        break;
+#endif
+#if defined(FX_SIMD_NEON)
+    case FX_SIMD_LEVEL_NEON:
+        i = fxNeonMix(dst, a, b, count, ga, gb, k, lo, hi);
+        break;
+#endif
+    default:
+        break;
+    }
+
+    for(; i < count; ++i)
+    {
+        float v = (a[i] * ga + b[i] * gb) * k;
+        dst[i] = v < lo ? lo : (v > hi ? hi : v);
+    }
+}
+
+/**
+ * @brief Convert the run of the compact delay line into floats
+ * @param format FX_LINE_S16 or FX_LINE_F16
+ * @param src Line samples
+ * @param dst Float samples
+ * @param count Number of samples
+ * @param scale Full scale of FX_LINE_S16 values, unused by halves
+ *
+ * Halves get converted by the F16C at the AVX2 level and by the NEON of
+ * AArch64, other levels take the scalar code
+ */
+static inline void fxLineLoad(int format, const uint16_t *src, float *dst, int count, float scale)
+{
+    int i = 0;
+
+    if(format == FX_LINE_S16)
+    {
+        const int16_t *s16 = reinterpret_cast<const int16_t*>(src);
+        const float inv = 1.f / scale;
+
+        switch(fxSimdLevel())
+        {
+#if defined(FX_SIMD_AVX2)
+        case FX_SIMD_LEVEL_AVX2:
+            i = fxAvx2LineLoadS16(s16, dst, count, inv);
+            break;
+#endif
+#if defined(FX_SIMD_SSE2)
+        case FX_SIMD_LEVEL_SSE2:
+            i = fxSse2LineLoadS16(s16, dst, count, inv);
+            break;
+#endif
+#if defined(FX_SIMD_NEON)
+        case FX_SIMD_LEVEL_NEON:
+            i = fxNeonLineLoadS16(s16, dst, count, inv);
+            break;
+#endif
+        default:
+            break;
+        }
+
+        for(; i < count; ++i)
+            dst[i] = static_cast<float>(s16[i]) * inv;
+        return;
+    }
+
+    switch(fxSimdLevel())
+    {
+#if defined(FX_SIMD_AVX2)
+    case FX_SIMD_LEVEL_AVX2:
+        i = fxAvx2LineLoadF16(src, dst, count);
+        break;
+#endif
+#if defined(FX_SIMD_NEON_F16)
+    case FX_SIMD_LEVEL_NEON:
+        i = fxNeonLineLoadF16(src, dst, count);
+        break;
+#endif
+    default:
+        break;
+    }
+
+    for(; i < count; ++i)
+        dst[i] = fxHalfToFloat(src[i]);
+}
+
+/**
+ * @brief Convert floats into the run of the compact delay line, the opposite of fxLineLoad()
+ */
+static inline void fxLineStore(int format, uint16_t *dst, const float *src, int count, float scale)
+{
+    int i = 0;
+
+    if(format == FX_LINE_S16)
+    {
+        int16_t *s16 = reinterpret_cast<int16_t*>(dst);
+
+        switch(fxSimdLevel())
+        {
+#if defined(FX_SIMD_AVX2)
+        case FX_SIMD_LEVEL_AVX2:
+            i = fxAvx2LineStoreS16(s16, src, count, scale);
+            break;
+#endif
+#if defined(FX_SIMD_SSE2)
+        case FX_SIMD_LEVEL_SSE2:
+            i = fxSse2LineStoreS16(s16, src, count, scale);
+            break;
+#endif
+#if defined(FX_SIMD_NEON)
+        case FX_SIMD_LEVEL_NEON:
+            i = fxNeonLineStoreS16(s16, src, count, scale);
+            break;
+#endif
+        default:
+            break;
+        }
+
+        for(; i < count; ++i)
+            s16[i] = fxLineToS16(src[i], scale);
+        return;
+    }
+
+    switch(fxSimdLevel())
+    {
+#if defined(FX_SIMD_AVX2)
+    case FX_SIMD_LEVEL_AVX2:
+        i = fxAvx2LineStoreF16(dst, src, count);
+        break;
+#endif
+#if defined(FX_SIMD_NEON_F16)
+    case FX_SIMD_LEVEL_NEON:
+        i = fxNeonLineStoreF16(dst, src, count);
+        break;
+#endif
+    default:
+        break;
+    }
+
+    for(; i < count; ++i)
+        dst[i] = fxFloatToHalf(src[i]);
+}
+
+/**
+ * @brief Run comb filters over the whole block by groups of four lines
+ *
+ * Only four delay lines are touched at a time, and the rings get split at
+ * the nearest wrap so the inner loop is contiguous. Four independent lines
+ * keep the feedback latency hidden. Lanes are summed in order, the same way
+ * as the per-sample code does, so all kernels give the same result.
+ * Compact lines go through the float scratch by runs of FX_LINE_RUN.
+ */
+static inline void fxCombSerial(FxCombLanes &cb, const float *in, float *out_l, float *out_r, int count)
+{
+    const bool compact = cb.format != FX_LINE_F32;
+    float lines[FX_COMB_GROUP][FX_LINE_RUN];
+
+    for(int k0 = 0; k0 < FX_COMB_LANES; k0 += FX_COMB_GROUP)
+    {
+        float *out = k0 < FX_COMB_LANES / 2 ? out_l : out_r;
+        const bool first = k0 == 0 || k0 == FX_COMB_LANES / 2;
+        float *d[FX_COMB_GROUP];
+
+        for(int p = 0; p < count;)
+        {
+            int run = count - p, j = 0;
+
+            if(compact && run > FX_LINE_RUN)
+                run = FX_LINE_RUN;
+
+            for(int k = 0; k < FX_COMB_GROUP; ++k)
+            {
+                const int left = cb.size[k0 + k] - cb.idx[k0 + k];
+                run = left < run ? left : run;
+                d[k] = compact ? lines[k] : cb.arena + cb.base[k0 + k] + cb.idx[k0 + k];
+            }
+
+            for(int k = 0; k < FX_COMB_GROUP && compact; ++k)
+                fxLineLoad(cb.format, cb.compact + cb.base[k0 + k] + cb.idx[k0 + k], d[k], run, cb.scale);
+
+            switch(fxSimdLevel())
+            {
+#if defined(FX_SIMD_SSE2)
+            case FX_SIMD_LEVEL_AVX2:
+            case FX_SIMD_LEVEL_SSE2:
+                j = fxSse2CombRun4(d, cb.store + k0, cb.damp1 + k0, cb.damp2 + k0, cb.feedback + k0,
+                                   in + p, out + p, first, run);
+                break;
+#endif
+#if defined(FX_SIMD_NEON)
+            case FX_SIMD_LEVEL_NEON:
+                j = fxNeonCombRun4(d, cb.store + k0, cb.damp1 + k0, cb.damp2 + k0, cb.feedback + k0,
+                                   in + p, out + p, first, run);
+                break;
+#endif
+            default:
+                break;
+            }
+
+            if(j < run)
+            {
+                // Locals, the line stores could alias the state otherwise
+                float store[FX_COMB_GROUP], damp1[FX_COMB_GROUP], damp2[FX_COMB_GROUP], feedback[FX_COMB_GROUP];
+
+                for(int k = 0; k < FX_COMB_GROUP; ++k)
+                {
+                    store[k] = cb.store[k0 + k];
+                    damp1[k] = cb.damp1[k0 + k];
+                    damp2[k] = cb.damp2[k0 + k];
+                    feedback[k] = cb.feedback[k0 + k];
+                }
+
+                for(; j < run; ++j)
+                {
+                    float acc = out[p + j];
+
+                    for(int k = 0; k < FX_COMB_GROUP; ++k)
+                    {
+                        float v = fxUndenormal(d[k][j]);
+                        store[k] = fxUndenormal((v * damp2[k]) + (store[k] * damp1[k]));
+                        d[k][j] = in[p + j] + (store[k] * feedback[k]);
+                        // Zeros are flushed to +0, so the first lane is the same as 0 + v
+                        acc = first && k == 0 ? v : acc + v;
+                    }
+
+                    out[p + j] = acc;
+                }
+
+                for(int k = 0; k < FX_COMB_GROUP; ++k)
+                    cb.store[k0 + k] = store[k];
+            }
+
+            for(int k = 0; k < FX_COMB_GROUP && compact; ++k)
+                fxLineStore(cb.format, cb.compact + cb.base[k0 + k] + cb.idx[k0 + k], d[k], run, cb.scale);
+
+            p += run;
+            for(int k = 0; k < FX_COMB_GROUP; ++k)
+            {
+                cb.idx[k0 + k] += run;
+                if(cb.idx[k0 + k] >= cb.size[k0 + k])
+                    cb.idx[k0 + k] = 0;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Run the bank of comb filters
+ * @param cb Comb filters
+ * @param in Input, the same for all lanes
+ * @param out_l Sum of lanes 0...7 per sample
+ * @param out_r Sum of lanes 8...15 per sample
+ * @param count Number of samples
+ *
+ * The AVX2 kernel sums lanes by pairs, so its outputs may differ from the
+ * scalar code by the rounding of the sum. It gathers straight from the
+ * float lines, compact ones always go by the groups
+ */
+static inline void fxCombBlock(FxCombLanes &cb, const float *in, float *out_l, float *out_r, int count)
+{
+    switch(fxSimdLevel())
+    {
+#if defined(FX_SIMD_AVX2)
+    case FX_SIMD_LEVEL_AVX2:
+        if(cb.format != FX_LINE_F32)
+            break;
+        fxAvx2Comb(cb, in, out_l, out_r, count);
+        return;
+#endif
+    default:
+        break;
+    }
+
+    fxCombSerial(cb, in, out_l, out_r, count);
+}
+
+/**
+ * @brief Run the comb filters of all models over the whole block
+ * @param cb Comb filters
+ * @param in Input of every model, interleaved by models
+ * @param out_l Sum of lines 0...7 of every model, interleaved
+ * @param out_r Sum of lines 8...15 of every model, interleaved
+ * @param count Number of samples per model
+ *
+ * Every model gets the same result as fxCombSerial() does give to one model
+ */
+static inline void fxCombModelsBlock(FxCombModels &cb, const float *in, float *out_l, float *out_r, int count)
+{
+    const int M = FX_COMB_MODELS;
+
+    for(int k0 = 0; k0 < FX_COMB_LANES; k0 += FX_COMB_GROUP)
+    {
+        float *out = k0 < FX_COMB_LANES / 2 ? out_l : out_r;
+        const bool first = k0 == 0 || k0 == FX_COMB_LANES / 2;
+        float *store = cb.store + k0 * M;
+        float *d[FX_COMB_GROUP];
+
+        for(int p = 0; p < count;)
+        {
+            int run = count - p;
+
+            for(int k = 0; k < FX_COMB_GROUP; ++k)
+            {
+                const int left = cb.size[k0 + k] - cb.idx[k0 + k];
+                run = left < run ? left : run;
+                d[k] = cb.arena + cb.base[k0 + k] + (size_t)cb.idx[k0 + k] * M;
+            }
+
+            switch(fxSimdLevel())
+            {
+#if defined(FX_SIMD_SSE2)
+            case FX_SIMD_LEVEL_AVX2:
+            case FX_SIMD_LEVEL_SSE2:
+                fxSse2CombModels(d, store, cb.damp1, cb.damp2, cb.feedback, in + p * M, out + p * M, first, run);
+                break;
+#endif
+#if defined(FX_SIMD_NEON)
+            case FX_SIMD_LEVEL_NEON:
+                fxNeonCombModels(d, store, cb.damp1, cb.damp2, cb.feedback, in + p * M, out + p * M, first, run);
+                break;
+#endif
+            default:
+                for(int j = 0; j < run; ++j)
+                {
+                    for(int m = 0; m < M; ++m)
+                    {
+                        const int i = (p + j) * M + m;
+                        float acc = out[i];
+
+                        for(int k = 0; k < FX_COMB_GROUP; ++k)
+                        {
+                            float &st = store[k * M + m];
+                            float v = fxUndenormal(d[k][j * M + m]);
+                            st = fxUndenormal((v * cb.damp2[m]) + (st * cb.damp1[m]));
+                            d[k][j * M + m] = in[i] + (st * cb.feedback[m]);
+                            acc = first && k == 0 ? v : acc + v;
+                        }
+
+                        out[i] = acc;
+                    }
+                }
+                break;
+            }
+
+            p += run;
+            for(int k = 0; k < FX_COMB_GROUP; ++k)
+            {
+                cb.idx[k0 + k] += run;
+                if(cb.idx[k0 + k] >= cb.size[k0 + k])
+                    cb.idx[k0 + k] = 0;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Run the allpass filter of all models over the whole block in place
+ * @param line Delay line interleaved by models
+ * @param size Length of the line in samples of one model
+ * @param idx Position at the line, gets advanced
+ * @param feedback Feedback of the filter, the same for all models
+ * @param io Samples of every model, interleaved
+ * @param count Number of samples per model
+ */
+static inline void fxAllpassModelsBlock(float *line, int size, int &idx, float feedback, float *io, int count)
+{
+    const int M = FX_COMB_MODELS;
+
+    while(count > 0)
+    {
+        const int run = count < size - idx ? count : size - idx;
+        float *d = line + (size_t)idx * M;
+
+        switch(fxSimdLevel())
+        {
+#if defined(FX_SIMD_SSE2)
+        case FX_SIMD_LEVEL_AVX2:
+        case FX_SIMD_LEVEL_SSE2:
+            fxSse2AllpassModels(d, feedback, io, run);
+            break;
+#endif
+#if defined(FX_SIMD_NEON)
+        case FX_SIMD_LEVEL_NEON:
+            fxNeonAllpassModels(d, feedback, io, run);
+            break;
+#endif
+        default:
+            for(int j = 0; j < run * M; ++j)
+            {
+                float input = io[j];
+                float bufout = fxUndenormal(d[j]);
+                io[j] = -input + bufout;
+                d[j] = input + (bufout * feedback);
+            }
+            break;
+        }
+
+        io += run * M;
+        count -= run;
+        idx += run;
+        if(idx >= size)
+            idx = 0;
+    }
+}
+
+/**
+ * @brief One-pole loop filters of the FDN lines over the block
+ * @param o Outputs of lines, one plane per line
+ * @param s Filtered outputs, one plane per line
+ * @param store Filter states, one per line
+ * @param gain Feedback gain of every line, already scaled by (1 - damp)
+ * @param damp Filter pole
+ * @param count Number of samples
+ */
+static inline void fxFdnDampBlock(const float *const *o, float *const *s, float *store,
+                                  const float *gain, float damp, int count)
+{
+    float st[FX_FDN_LINES];
+    int i = 0;
+
+    switch(fxSimdLevel())
+    {
+#if defined(FX_SIMD_SSE2)
+    case FX_SIMD_LEVEL_AVX2:
+    case FX_SIMD_LEVEL_SSE2:
+        i = fxSse2FdnDamp(o, s, store, gain, damp, count);
+        break;
+#endif
+#if defined(FX_SIMD_NEON)
+    case FX_SIMD_LEVEL_NEON:
+        i = fxNeonFdnDamp(o, s, store, gain, damp, count);
+        break;
+#endif
+    default:
+        break;
+    }
+
+    // Local states keep the lines independent, the stores into planes can't alias them
+    for(int k = 0; k < FX_FDN_LINES; ++k)
+        st[k] = store[k];
+
+    for(; i < count; ++i)
+    {
+        for(int k = 0; k < FX_FDN_LINES; ++k)
+        {
+            st[k] = fxUndenormal((o[k][i] * gain[k]) + (st[k] * damp));
+            s[k][i] = st[k];
+        }
+    }
+
+    for(int k = 0; k < FX_FDN_LINES; ++k)
+        store[k] = st[k];
+}
+
+/**
+ * @brief Feedback matrix of the FDN over the block
+ * @param s Damped outputs of lines, one plane per line
+ * @param w Inputs of lines, one plane per line
+ * @param in Input of the network
+ * @param in_gain Input gain per line
+ * @param count Number of samples
+ *
+ * w[k] = in * in_gain[k] + s[k] - sum(s) * 2 / FX_FDN_LINES, the Householder
+ * matrix costs one sum per sample, and no shuffles across lines are needed
+ */
+static inline void fxFdnMatrixBlock(const float *const *s, float *const *w, const float *in,
+                                    const float *in_gain, int count)
+{
+    int i = 0;
+
+    switch(fxSimdLevel())
+    {
+#if defined(FX_SIMD_AVX2)
+    case FX_SIMD_LEVEL_AVX2:
+        i = fxAvx2FdnMatrix(s, w, in, in_gain, count);
+        break;
+#endif
+#if defined(FX_SIMD_SSE2)
+    case FX_SIMD_LEVEL_SSE2:
+        i = fxSse2FdnMatrix(s, w, in, in_gain, count);
+        break;
+#endif
+#if defined(FX_SIMD_NEON)
+    case FX_SIMD_LEVEL_NEON:
+        i = fxNeonFdnMatrix(s, w, in, in_gain, count);
+        break;
+#endif
+    default:
+        break;
+    }
+
+    for(; i < count; ++i)
+    {
+        float sum = s[0][i];
+
+        for(int k = 1; k < FX_FDN_LINES; ++k)
+            sum += s[k][i];
+        sum *= fx_fdn_householder;
+
+        for(int k = 0; k < FX_FDN_LINES; ++k)
+            w[k][i] = in[i] * in_gain[k] + (s[k][i] - sum);
+    }
+}
+
+/**
+ * @brief Output taps of the FDN over the block
+ * @param o Outputs of lines, one plane per line
+ * @param tap_l Gain of every line at the left output
+ * @param tap_r Gain of every line at the right output
+ * @param out_l Left output
+ * @param out_r Right output
+ * @param count Number of samples
+ */
+static inline void fxFdnTapsBlock(const float *const *o, const float *tap_l, const float *tap_r,
+                                  float *out_l, float *out_r, int count)
+{
+    int i = 0;
+
+    switch(fxSimdLevel())
+    {
+#if defined(FX_SIMD_AVX2)
+    case FX_SIMD_LEVEL_AVX2:
+        i = fxAvx2FdnTaps(o, tap_l, tap_r, out_l, out_r, count);
+        break;
+#endif
+#if defined(FX_SIMD_SSE2)
+    case FX_SIMD_LEVEL_SSE2:
+        i = fxSse2FdnTaps(o, tap_l, tap_r, out_l, out_r, count);
+        break;
+#endif
+#if defined(FX_SIMD_NEON)
+    case FX_SIMD_LEVEL_NEON:
+        i = fxNeonFdnTaps(o, tap_l, tap_r, out_l, out_r, count);
+        break;
+#endif
+    default:
+        break;
+    }
+
+    for(; i < count; ++i)
+    {
+        float l = o[0][i] * tap_l[0];
+        float r = o[0][i] * tap_r[0];
+
+        for(int k = 1; k < FX_FDN_LINES; ++k)
+        {
+            l += o[k][i] * tap_l[k];
+            r += o[k][i] * tap_r[k];
+        }
+
+        out_l[i] = l;
+        out_r[i] = r;
+    }
+}
+
+/**
+ * @brief Accumulate the product of two split complex spectra
+ * @param y_re Real parts of the sum
+ * @param y_im Imaginary parts of the sum
+ * @param x_re Real parts of the first spectrum
+ * @param x_im Imaginary parts of the first spectrum
+ * @param h_re Real parts of the second spectrum
+ * @param h_im Imaginary parts of the second spectrum
+ * @param count Number of bins
+ */
+static inline void fxComplexMacBlock(float *y_re, float *y_im, const float *x_re, const float *x_im,
+                                     const float *h_re, const float *h_im, int count)
+{
+    int i = 0;
+
+    switch(fxSimdLevel())
+    {
+#if defined(FX_SIMD_AVX2)
+    case FX_SIMD_LEVEL_AVX2:
+        i = fxAvx2ComplexMac(y_re, y_im, x_re, x_im, h_re, h_im, count);
+        break;
+#endif
+#if defined(FX_SIMD_SSE2)
+    case FX_SIMD_LEVEL_SSE2:
+        i = fxSse2ComplexMac(y_re, y_im, x_re, x_im, h_re, h_im, count);
+        break;
+#endif
+#if defined(FX_SIMD_NEON)
+    case FX_SIMD_LEVEL_NEON:
+        i = fxNeonComplexMac(y_re, y_im, x_re, x_im, h_re, h_im, count);
+        break;
+#endif
+    default:
+        break;
+    }
+
+    for(; i < count; ++i)
+    {
+        y_re[i] += x_re[i] * h_re[i] - x_im[i] * h_im[i];
+        y_im[i] += x_re[i] * h_im[i] + x_im[i] * h_re[i];
+    }
+}
+
+
+#endif // FX_SIMD_HPP
@@ -0,0 +1,69 @@
+#ifndef FX_SNAPSHOT_HPP
+#define FX_SNAPSHOT_HPP
+
+/*
+ * Settings passed from the control thread to the audio thread without locks.
+ *
+ * Three copies: the writer fills its own one and swaps it with the shared
+ * one, the reader swaps the shared one with its own at the start of the
+ * block once there is a newer one. Neither side ever waits or sees a half
+ * written copy, the reader gets the latest complete settings and skips the
+ * ones published in between. One writer thread and one reader thread.
+ */
+
+#include <atomic>
+
+template<typename T>
+struct FxSnapshot
+{
+    //! Set at the shared index while the reader didn't take it yet
+    static const unsigned fresh = 4;
+
+    T           slots[3];
+    //! Index of the shared copy, with the fresh flag
+    std::atomic<unsigned> shared;
+    //! Writer's copy
+    unsigned    back = 0;
+    //! Reader's copy
+    unsigned    front = 2;
+
+    FxSnapshot() :
+        shared(1)
+    {}
+
+    //! Put the value into every copy, neither side may run at the time
+    void reset(const T &value)
+    {
+        for(int i = 0; i < 3; ++i)
+            slots[i] = value;
+
+        back = 0;
+        front = 2;
+        shared.store(1, std::memory_order_release);
+    }
+
+    //! Writer: make the copy of the value the latest one
+    void publish(const T &value)
+    {
+        slots[back] = value;
+        back = shared.exchange(back | fresh, std::memory_order_acq_rel) & ~fresh;
+    }
+
+    //! Reader: take the latest value, returns true if it's new since the last call
+    bool acquire()
+    {
+        if(!(shared.load(std::memory_order_relaxed) & fresh))
+            return false;
+
+        front = shared.exchange(front, std::memory_order_acq_rel) & ~fresh;
+        return true;
+    }
+
+    //! Reader: the value taken by the last acquire()
+    const T &read() const
+    {
+        return slots[front];
+    }
+};
+
+#endif // FX_SNAPSHOT_HPP
@@ -0,0 +1,254 @@
+#ifndef FX_WORKERS_HPP
+#define FX_WORKERS_HPP
+
+/*
+ * Persistent pool of worker threads for the independent jobs of one callback.
+ *
+ * Threads get created once by start(). Every run() publishes the new
+ * generation, and the caller and the workers take jobs by the atomic counter
+ * until none is left, then the caller waits at the barrier till all taken
+ * jobs are finished. Nothing is locked or allocated while the workers are
+ * awake: every worker measures the time between runs and keeps spinning for
+ * one and a half of it after its last job, so while the callbacks come one
+ * after another the workers are awake at the next one, and the caller never
+ * makes a system call. Workers fall asleep on the condition variable only
+ * once the callbacks stop, the caller takes the mutex only to wake them.
+ *
+ * Define FX_WORKERS_DISABLE for targets without threads, start() does nothing
+ * then and the pool is never active.
+ */
+
+#if defined(__3DS__) || defined(__WII__) || defined(__WIIU__) || defined(__EMSCRIPTEN__)
+#   define FX_WORKERS_DISABLE
+#endif
+
+#if !defined(FX_WORKERS_DISABLE)
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include "fx_simd.hpp"
+
+//! Polls of the generation by pauses, the idle worker yields the core between polls after them
+#define FX_WORKERS_SPIN     4096
+//! Longest time the idle worker stays awake after its last run, microseconds
+#define FX_WORKERS_IDLE_MAX_US  200000
+
+static inline void fxCpuRelax()
+{
+#if defined(FX_SIMD_SSE2)
+    _mm_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+struct FxWorkers
+{
+    typedef void (*JobCB)(void *owner, int job);
+
+    JobCB       callback = nullptr;
+    void       *owner = nullptr;
+    //! Number of jobs of every run, fixed by start()
+    int         jobs = 0;
+
+    std::vector<std::thread> threads;
+
+    //! Incremented by every run(), workers wake up on the change
+    std::atomic<unsigned>   generation;
+    //! Next job to take, jobs and more mean nothing is left
+    std::atomic<int>        next;
+    //! Jobs finished by the current run
+    std::atomic<int>        finished;
+    //! Workers waiting at the condition variable
+    std::atomic<int>        sleepers;
+    std::atomic<bool>       quit;
+
+    std::mutex              mutex;
+    std::condition_variable wake;
+
+    FxWorkers() :
+        generation(0), next(0), finished(0), sleepers(0), quit(false)
+    {}
+
+    ~FxWorkers()
+    {
+        stop();
+    }
+
+    /**
+     * @brief Create the threads, must be called outside of the audio callback
+     * @param count Number of worker threads, the caller of run() is one more. Never more than the spare cores
+     * @param i_callback Job function, gets the owner and the job index
+     * @param i_owner Pointer passed to the job function
+     * @param i_jobs Number of jobs per run
+     * @return Number of running threads
+     */
+    int start(int count, JobCB i_callback, void *i_owner, int i_jobs)
+    {
+        stop();
+
+        callback = i_callback;
+        owner = i_owner;
+        jobs = i_jobs;
+        next.store(jobs);
+        finished.store(jobs);
+
+        // Spinning workers without the own core only take the time of the caller
+        const int cores = (int)std::thread::hardware_concurrency();
+        if(cores > 0 && count > cores - 1)
+            count = cores - 1;
+
+        for(int i = 0; i < count; ++i)
+            threads.push_back(std::thread(&FxWorkers::loop, this));
+
+        return (int)threads.size();
+    }
+
+    //! Join all threads
+    void stop()
+    {
+        if(threads.empty())
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit.store(true);
+        }
+        wake.notify_all();
+
+        for(size_t i = 0; i < threads.size(); ++i)
+            threads[i].join();
+
+        threads.clear();
+        quit.store(false);
+    }
+
+    bool active() const
+    {
+        return !threads.empty();
+    }
+
+    /**
+     * @brief Run all jobs and return once they are done, the job data must be set before
+     */
+    void run()
+    {
+        finished.store(0, std::memory_order_relaxed);
+        next.store(0, std::memory_order_release);
+        generation.fetch_add(1, std::memory_order_seq_cst);
+
+        // Sleeper is counted before it checks the generation, so it either sees the new one or gets woken
+        if(sleepers.load(std::memory_order_seq_cst) > 0)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            wake.notify_all();
+        }
+
+        take();
+
+        // The last jobs are running already, the worker may get preempted though
+        for(int spin = 0; finished.load(std::memory_order_acquire) < jobs; ++spin)
+        {
+            if(spin < FX_WORKERS_SPIN)
+                fxCpuRelax();
+            else
+                std::this_thread::yield();
+        }
+    }
+
+private:
+    //! Run jobs until none is left, late workers of the past run may join the current one, that's fine
+    void take()
+    {
+        int i;
+
+        while((i = next.fetch_add(1, std::memory_order_acq_rel)) < jobs)
+        {
+            callback(owner, i);
+            finished.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+    void loop()
+    {
+        typedef std::chrono::steady_clock Clock;
+        const Clock::duration idle_max = std::chrono::microseconds(FX_WORKERS_IDLE_MAX_US);
+        unsigned seen = generation.load(std::memory_order_acquire);
+        Clock::time_point last = Clock::now();
+        Clock::duration idle = idle_max;
+
+        for(;;)
+        {
+            const Clock::time_point until = last + idle;
+            unsigned now = seen;
+
+            // The clock is read once per 64 polls, it's cheap but not free
+            for(int spin = 0; now == seen && !quit.load(std::memory_order_relaxed); ++spin)
+            {
+                if(spin < FX_WORKERS_SPIN)
+                    fxCpuRelax();
+                else if((spin & 63) == 0 && Clock::now() >= until)
+                    break;
+                else
+                    std::this_thread::yield();
+
+                now = generation.load(std::memory_order_acquire);
+            }
+
+            if(now == seen)
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+
+                sleepers.fetch_add(1, std::memory_order_seq_cst);
+                while((now = generation.load(std::memory_order_seq_cst)) == seen && !quit.load())
+                    wake.wait(lock);
+                sleepers.fetch_sub(1, std::memory_order_relaxed);
+            }
+
+            if(quit.load())
+                return;
+
+            // Stay awake for one and a half of the callback period, the pause of the playback puts it to sleep
+            const Clock::time_point woke = Clock::now();
+            idle = woke - last;
+            idle += idle / 2;
+            if(idle > idle_max)
+                idle = idle_max;
+            last = woke;
+
+            seen = now;
+            take();
+        }
+    }
+};
+
+#else // FX_WORKERS_DISABLE
+
+struct FxWorkers
+{
+    typedef void (*JobCB)(void *owner, int job);
+
+    int start(int, JobCB, void *, int)
+    {
+        return 0;
+    }
+
+    void stop()
+    {}
+
+    bool active() const
+    {
+        return false;
+    }
+
+    void run()
+    {}
+};
+
+#endif // FX_WORKERS_DISABLE
+
+#endif // FX_WORKERS_HPP
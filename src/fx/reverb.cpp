@@ -22,13 +22,21 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
+#if defined(__3DS__) || defined(__SWITCH__) || defined(__WII__) || defined(__WIIU__)
+#define INTEGER_ONLY_REVERB
+#endif
+
 #include <cstddef>
+#include <cstring>
 #include <vector>
 #include <deque>
+#include <algorithm>
 #include <cmath>
 #include <tgmath.h>
 #include "reverb.h"
 #include "fx_common.hpp"
+#include "fx_workers.hpp"
+#include "fx_snapshot.hpp"
 
 
 // Code was taken from FreeVerb: https://github.com/sinshu/freeverb (Public Domain)
@@ -54,6 +62,8 @@ const float initialwidth    = 1;
 const float initialmode     = 0;
 const float freezemode      = 0.5f;
 const int   stereospread    = 23;
+// Rear tank of the quad surround gets longer lines, so it doesn't correlate with the front one
+const int   rearspread      = stereospread * 2;
 
 // These values assume 44.1KHz sample rate
 // they will probably be OK for 48KHz sample rate
@@ -84,6 +94,25 @@ const int allpasstuningR3   = 341 + stereospread;
 const int allpasstuningL4   = 225;
 const int allpasstuningR4   = 225 + stereospread;
 
+static const int combtuning[numcombs] =
+{
+    combtuningL1, combtuningL2, combtuningL3, combtuningL4,
+    combtuningL5, combtuningL6, combtuningL7, combtuningL8
+};
+static const int allpasstuning[numallpasses] =
+{
+    allpasstuningL1, allpasstuningL2, allpasstuningL3, allpasstuningL4
+};
+
+//! Delay lines are carved from the arena by whole cache lines, 16 floats of 64 bytes
+const size_t arenaalign     = 16;
+//! Samples passed through the comb bank at once
+const int   combblock       = 256;
+//! Full scale of FX_LINE_S16 comb lines, they keep 4x headroom like the fixed-point combs do
+const float combscale       = 8192.f;
+//! Allpasses take the sum of all combs, their FX_LINE_S16 lines keep 32x headroom
+const float allpassscale    = 1024.f;
+
 
 static inline void undenormalise(float &sample)
 {
@@ -93,88 +122,28 @@ static inline void undenormalise(float &sample)
 }
 
 
-class comb
+class allpass
 {
 public:
-    comb()
+    allpass()
     {
-        filterstore = 0;
         bufidx = 0;
     }
 
     void setbuffer(float* buf, int size)
     {
         buffer = buf;
+        compact = nullptr;
+        format = FX_LINE_F32;
         bufsize = size;
     }
 
-    // Big to inline - but crucial for speed
-    inline float process(float input)
-    {
-        float output;
-
-        output = buffer[bufidx];
-        undenormalise(output);
-
-        filterstore = (output * damp2) + (filterstore * damp1);
-        undenormalise(filterstore);
-
-        buffer[bufidx] = input + (filterstore * feedback);
-
-        if(++bufidx >= bufsize) bufidx = 0;
-
-        return output;
-    }
-
-    void mute()
-    {
-        for(int i = 0; i < bufsize; i++)
-            buffer[i] = 0;
-    }
-
-    void setdamp(float val)
-    {
-        damp1 = val;
-        damp2 = 1 - val;
-    }
-
-    float getdamp()
-    {
-        return damp1;
-    }
-
-    void setfeedback(float val)
-    {
-        feedback = val;
-    }
-
-    float getfeedback()
-    {
-        return feedback;
-    }
-
-private:
-    float   feedback = 0.f;
-    float   filterstore = 0.f;
-    float   damp1 = 0.f;
-    float   damp2 = 0.f;
-    float*  buffer = nullptr;
-    int     bufsize = 0;
-    int     bufidx = 0;
-};
-
-
-class allpass
-{
-public:
-    allpass()
-    {
-        bufidx = 0;
-    }
-
-    void setbuffer(float* buf, int size)
+    //! Keep the line in the compact format, only processBlock() takes it
+    void setbuffer(uint16_t* buf, int size, int i_format)
     {
-        buffer = buf;
+        buffer = nullptr;
+        compact = buf;
+        format = i_format;
         bufsize = size;
     }
 
@@ -196,8 +165,50 @@ public:
         return output;
     }
 
+    //! Same as process() over the whole block in place, the ring is split at the wrap
+    void processBlock(float* io, int count)
+    {
+        float line[FX_LINE_RUN];
+
+        while(count > 0)
+        {
+            int run = count < bufsize - bufidx ? count : bufsize - bufidx;
+            float* d = compact ? line : buffer + bufidx;
+
+            if(compact)
+            {
+                run = run < FX_LINE_RUN ? run : FX_LINE_RUN;
+                fxLineLoad(format, compact + bufidx, line, run, allpassscale);
+            }
+
+            for(int j = 0; j < run; j++)
+            {
+                float input = io[j];
+                float bufout = d[j];
+                undenormalise(bufout);
+                io[j] = -input + bufout;
+                d[j] = input + (bufout * feedback);
+            }
+
+            if(compact)
+                fxLineStore(format, compact + bufidx, line, run, allpassscale);
+
+            io += run;
+            count -= run;
+            bufidx += run;
+            if(bufidx >= bufsize)
+                bufidx = 0;
+        }
+    }
+
     void mute()
     {
+        if(compact)
+        {
+            memset(compact, 0, sizeof(uint16_t) * bufsize);
+            return;
+        }
+
         for(int i = 0; i < bufsize; i++)
             buffer[i] = 0;
     }
@@ -215,183 +226,34 @@ public:
     // private:
     float   feedback = 0.f;
     float*  buffer = nullptr;
+    //! Line of the FxLineFormat other than FX_LINE_F32, replaces the buffer
+    uint16_t* compact = nullptr;
+    int     format = FX_LINE_F32;
     int     bufsize = 0;
     int     bufidx = 0;
 };
 
 
-class revmodel
+/**
+ * Settings of the FreeVerb model, shared by the float and the fixed-point
+ * engines. Setters keep the derived values up to date, engines pick them up
+ * at every processing call.
+ */
+class revparams
 {
-    double rateScale = 1.0;
+    friend class revbank;
 
 public:
-    void setSampleRate(int rate)
-    {
-        rateScale = rate / 44100.0;
-        // Prepare buffers
-        bufcombL1.resize(static_cast<size_t>(combtuningL1 * rateScale));
-        bufcombR1.resize(static_cast<size_t>(combtuningR1 * rateScale));
-        bufcombL2.resize(static_cast<size_t>(combtuningL2 * rateScale));
-        bufcombR2.resize(static_cast<size_t>(combtuningR2 * rateScale));
-        bufcombL3.resize(static_cast<size_t>(combtuningL3 * rateScale));
-        bufcombR3.resize(static_cast<size_t>(combtuningR3 * rateScale));
-        bufcombL4.resize(static_cast<size_t>(combtuningL4 * rateScale));
-        bufcombR4.resize(static_cast<size_t>(combtuningR4 * rateScale));
-        bufcombL5.resize(static_cast<size_t>(combtuningL5 * rateScale));
-        bufcombR5.resize(static_cast<size_t>(combtuningR5 * rateScale));
-        bufcombL6.resize(static_cast<size_t>(combtuningL6 * rateScale));
-        bufcombR6.resize(static_cast<size_t>(combtuningR6 * rateScale));
-        bufcombL7.resize(static_cast<size_t>(combtuningL7 * rateScale));
-        bufcombR7.resize(static_cast<size_t>(combtuningR7 * rateScale));
-        bufcombL8.resize(static_cast<size_t>(combtuningL8 * rateScale));
-        bufcombR8.resize(static_cast<size_t>(combtuningR8 * rateScale));
-        bufallpassL1.resize(static_cast<size_t>(allpasstuningL1 * rateScale));
-        bufallpassR1.resize(static_cast<size_t>(allpasstuningR1 * rateScale));
-        bufallpassL2.resize(static_cast<size_t>(allpasstuningL2 * rateScale));
-        bufallpassR2.resize(static_cast<size_t>(allpasstuningR2 * rateScale));
-        bufallpassL3.resize(static_cast<size_t>(allpasstuningL3 * rateScale));
-        bufallpassR3.resize(static_cast<size_t>(allpasstuningR3 * rateScale));
-        bufallpassL4.resize(static_cast<size_t>(allpasstuningL4 * rateScale));
-        bufallpassR4.resize(static_cast<size_t>(allpasstuningR4 * rateScale));
-
-        // Tie the components to their buffers
-        combL[0].setbuffer(bufcombL1.data(), static_cast<int>(bufcombL1.size()));
-        combR[0].setbuffer(bufcombR1.data(), static_cast<int>(bufcombR1.size()));
-        combL[1].setbuffer(bufcombL2.data(), static_cast<int>(bufcombL2.size()));
-        combR[1].setbuffer(bufcombR2.data(), static_cast<int>(bufcombR2.size()));
-        combL[2].setbuffer(bufcombL3.data(), static_cast<int>(bufcombL3.size()));
-        combR[2].setbuffer(bufcombR3.data(), static_cast<int>(bufcombR3.size()));
-        combL[3].setbuffer(bufcombL4.data(), static_cast<int>(bufcombL4.size()));
-        combR[3].setbuffer(bufcombR4.data(), static_cast<int>(bufcombR4.size()));
-        combL[4].setbuffer(bufcombL5.data(), static_cast<int>(bufcombL5.size()));
-        combR[4].setbuffer(bufcombR5.data(), static_cast<int>(bufcombR5.size()));
-        combL[5].setbuffer(bufcombL6.data(), static_cast<int>(bufcombL6.size()));
-        combR[5].setbuffer(bufcombR6.data(), static_cast<int>(bufcombR6.size()));
-        combL[6].setbuffer(bufcombL7.data(), static_cast<int>(bufcombL7.size()));
-        combR[6].setbuffer(bufcombR7.data(), static_cast<int>(bufcombR7.size()));
-        combL[7].setbuffer(bufcombL8.data(), static_cast<int>(bufcombL8.size()));
-        combR[7].setbuffer(bufcombR8.data(), static_cast<int>(bufcombR8.size()));
-        allpassL[0].setbuffer(bufallpassL1.data(), static_cast<int>(bufallpassL1.size()));
-        allpassR[0].setbuffer(bufallpassR1.data(), static_cast<int>(bufallpassR1.size()));
-        allpassL[1].setbuffer(bufallpassL2.data(), static_cast<int>(bufallpassL2.size()));
-        allpassR[1].setbuffer(bufallpassR2.data(), static_cast<int>(bufallpassR2.size()));
-        allpassL[2].setbuffer(bufallpassL3.data(), static_cast<int>(bufallpassL3.size()));
-        allpassR[2].setbuffer(bufallpassR3.data(), static_cast<int>(bufallpassR3.size()));
-        allpassL[3].setbuffer(bufallpassL4.data(), static_cast<int>(bufallpassL4.size()));
-        allpassR[3].setbuffer(bufallpassR4.data(), static_cast<int>(bufallpassR4.size()));
-    }
-
-    revmodel()
+    revparams()
     {
-        // Set default values
-        allpassL[0].setfeedback(0.5f);
-        allpassR[0].setfeedback(0.5f);
-        allpassL[1].setfeedback(0.5f);
-        allpassR[1].setfeedback(0.5f);
-        allpassL[2].setfeedback(0.5f);
-        allpassR[2].setfeedback(0.5f);
-        allpassL[3].setfeedback(0.5f);
-        allpassR[3].setfeedback(0.5f);
         setwet(initialwet);
         setroomsize(initialroom);
         setdry(initialdry);
         setdamp(initialdamp);
         setwidth(initialwidth);
         setmode(initialmode);
-
-        // Buffer will be full of rubbish - so we MUST mute them
-        mute();
-    }
-
-    void mute()
-    {
-        if(getmode() >= freezemode)
-            return;
-
-        for(int i = 0; i < numcombs; i++)
-        {
-            combL[i].mute();
-            combR[i].mute();
-        }
-
-        for(int i = 0; i < numallpasses; i++)
-        {
-            allpassL[i].mute();
-            allpassR[i].mute();
-        }
-    }
-
-    void processmix(float* inputL, float* inputR, float* outputL, float* outputR, long numsamples, int skip)
-    {
-        float outL, outR, input;
-
-        while(numsamples-- > 0)
-        {
-            outL = outR = 0;
-            input = (*inputL + *inputR) * gain;
-
-            // Accumulate comb filters in parallel
-            for(int i = 0; i < numcombs; i++)
-            {
-                outL += combL[i].process(input);
-                outR += combR[i].process(input);
-            }
-
-            // Feed through allpasses in series
-            for(int i = 0; i < numallpasses; i++)
-            {
-                outL = allpassL[i].process(outL);
-                outR = allpassR[i].process(outR);
-            }
-
-            // Calculate output MIXING with anything already there
-            *outputL += outL * wet1 + outR * wet2 + *inputL * dry;
-            *outputR += outR * wet1 + outL * wet2 + *inputR * dry;
-
-            // Increment sample pointers, allowing for interleave (if any)
-            inputL += skip;
-            inputR += skip;
-            outputL += skip;
-            outputR += skip;
-        }
-    }
-
-    void processreplace(float* inputL, float* inputR, float* outputL, float* outputR, long numsamples, int skip)
-    {
-        float outL, outR, input;
-
-        while(numsamples-- > 0)
-        {
-            outL = outR = 0;
-            input = (*inputL + *inputR) * gain;
-
-            // Accumulate comb filters in parallel
-            for(int i = 0; i < numcombs; i++)
-            {
-                outL += combL[i].process(input);
-                outR += combR[i].process(input);
-            }
-
-            // Feed through allpasses in series
-            for(int i = 0; i < numallpasses; i++)
-            {
-                outL = allpassL[i].process(outL);
-                outR = allpassR[i].process(outR);
-            }
-
-            // Calculate output REPLACING anything already there
-            *outputL = outL * wet1 + outR * wet2 + *inputL * dry;
-            *outputR = outR * wet1 + outL * wet2 + *inputR * dry;
-
-            // Increment sample pointers, allowing for interleave (if any)
-            inputL += skip;
-            inputR += skip;
-            outputL += skip;
-            outputR += skip;
-        }
     }
 
-
     // The following get/set functions are not inlined, because
     // speed is never an issue when calling them, and also
     // because as you develop the reverb model, you may
@@ -465,13 +327,23 @@ public:
             return 0;
     }
 
-private:
+    //! Take all settings at once with a single update()
+    void setsetup(const ReverbSetup &setup)
+    {
+        roomsize = (setup.roomSize * scaleroom) + offsetroom;
+        damp = setup.damping * scaledamp;
+        wet = setup.wetLevel * scalewet;
+        dry = setup.dryLevel * scaledry;
+        width = setup.width;
+        mode = setup.mode;
+        update();
+    }
+
+protected:
     void update()
     {
         // Recalculate internal values after parameter change
 
-        int i;
-
         wet1 = wet * (width / 2 + 0.5f);
         wet2 = wet * ((1 - width) / 2);
 
@@ -487,21 +359,9 @@ private:
             damp1 = damp;
             gain = fixedgain;
         }
-
-        for(i = 0; i < numcombs; i++)
-        {
-            combL[i].setfeedback(roomsize1);
-            combR[i].setfeedback(roomsize1);
-        }
-
-        for(i = 0; i < numcombs; i++)
-        {
-            combL[i].setdamp(damp1);
-            combR[i].setdamp(damp1);
-        }
     }
 
-private:
+protected:
     float   gain = 0.0f;
     float   roomsize = 0.0f, roomsize1 = 0.0f;
     float   damp = 0.0f, damp1 = 0.0f;
@@ -509,246 +369,1775 @@ private:
     float   dry = 0.0f;
     float   width = 0.0f;
     float   mode = 0.0f;
+};
 
-    // The following are all declared inline
-    // to remove the need for dynamic allocation
-    // with its subsequent error-checking messiness
 
-    // Comb filters
-    comb    combL[numcombs];
-    comb    combR[numcombs];
+class revmodel : public revparams
+{
+    double rateScale = 1.0;
 
-    // Allpass filters
-    allpass allpassL[numallpasses];
-    allpass allpassR[numallpasses];
+public:
+    //! Length of the delay line at the rate
+    static int lineSize(int tuning, double scale)
+    {
+        return static_cast<int>(tuning * scale);
+    }
 
-    // Buffers for the combs
-    std::vector<float>  bufcombL1;
-    std::vector<float>  bufcombR1;
-    std::vector<float>  bufcombL2;
-    std::vector<float>  bufcombR2;
-    std::vector<float>  bufcombL3;
-    std::vector<float>  bufcombR3;
-    std::vector<float>  bufcombL4;
-    std::vector<float>  bufcombR4;
-    std::vector<float>  bufcombL5;
-    std::vector<float>  bufcombR5;
-    std::vector<float>  bufcombL6;
-    std::vector<float>  bufcombR6;
-    std::vector<float>  bufcombL7;
-    std::vector<float>  bufcombR7;
-    std::vector<float>  bufcombL8;
-    std::vector<float>  bufcombR8;
-
-    // Buffers for the allpasses
-    std::vector<float> bufallpassL1;
-    std::vector<float> bufallpassR1;
-    std::vector<float> bufallpassL2;
-    std::vector<float> bufallpassR2;
-    std::vector<float> bufallpassL3;
-    std::vector<float> bufallpassR3;
-    std::vector<float> bufallpassL4;
-    std::vector<float> bufallpassR4;
-};
+    /**
+     * @brief Arena space taken by the delay line, rounded up to whole cache lines
+     * @param size Line length in samples
+     * @param format One of FxLineFormat, compact lines take a half
+     * @return Number of floats
+     */
+    static size_t lineStride(int size, int format = FX_LINE_F32)
+    {
+        if(format != FX_LINE_F32)
+            return ((static_cast<size_t>(size) + arenaalign * 2 - 1) & ~(arenaalign * 2 - 1)) / 2;
 
+        return (static_cast<size_t>(size) + arenaalign - 1) & ~(arenaalign - 1);
+    }
 
-typedef struct FxReverb
-{
-    int         channels = 0;
-    int         sampleRate = 0;
-    uint16_t    format = AUDIO_F32LSB;
-    bool        isValid = false;
-    ReverbSetup m_setup;
+    /**
+     * @brief Arena size needed by all delay lines of the model
+     * @param rate Sample rate
+     * @param spread Extra length of every line at 44.1 kHz
+     * @param format One of FxLineFormat
+     * @return Number of floats
+     */
+    static size_t arenaSize(int rate, int spread = 0, int format = FX_LINE_F32)
+    {
+        const double scale = rate / 44100.0;
+        size_t size = 0;
 
-    revmodel    rev[MAX_CHANNELS / 2];
+        for(int i = 0; i < numcombs; i++)
+        {
+            size += lineStride(lineSize(combtuning[i] + spread, scale), format);
+            size += lineStride(lineSize(combtuning[i] + spread + stereospread, scale), format);
+        }
 
-    std::vector<std::vector<float>> inBuffer;
-    std::vector<std::vector<float>> outBuffer;
-    int                             lastBufferSize = 0;
+        for(int i = 0; i < numallpasses; i++)
+        {
+            size += lineStride(lineSize(allpasstuning[i] + spread, scale), format);
+            size += lineStride(lineSize(allpasstuning[i] + spread + stereospread, scale), format);
+        }
 
-    ReadSampleCB    readSample = nullptr;
-    WriteSampleCB   writeSample = nullptr;
-    int             sample_size = 2;
+        return size;
+    }
 
-    int init(int i_rate, uint16_t i_format, int i_channels)
+    /**
+     * @brief Tie the delay lines to the arena
+     * @param rate Sample rate
+     * @param arena Cache-line aligned memory of arenaSize() floats, must be zeroed
+     * @param spread Extra length of every line at 44.1 kHz, the same as given to arenaSize()
+     * @param format One of FxLineFormat, the same as given to arenaSize()
+     */
+    void setSampleRate(int rate, float *arena, int spread = 0, int format = FX_LINE_F32)
     {
-        isValid = false;
-
-        if(channels > MAX_CHANNELS)
-            return -1;
+        const float *start = arena;
+        // Compact lines are indexed by 16-bit samples, two of them per float of the arena
+        const int32_t unit = format == FX_LINE_F32 ? 1 : 2;
+        int size;
 
-        format = i_format;
-        sampleRate = i_rate;
-        channels = i_channels;
+        rateScale = rate / 44100.0;
 
-        if(!initFormat(readSample, writeSample, sample_size, format))
-            return -1;
+        combs.format = format;
+        combs.scale = combscale;
+        combs.arena = format == FX_LINE_F32 ? arena : nullptr;
+        combs.compact = format == FX_LINE_F32 ? nullptr : reinterpret_cast<uint16_t*>(arena);
 
-        for(int i = 0; i < channels; i += 2)
+        for(int i = 0; i < numcombs; i++)
         {
-            auto &c = rev[i / 2];
-            c.setSampleRate(sampleRate);
+            size = lineSize(combtuning[i] + spread, rateScale);
+            combs.base[i] = static_cast<int32_t>(arena - start) * unit;
+            combs.size[i] = size;
+            combs.idx[i] = 0;
+            arena += lineStride(size, format);
+
+            size = lineSize(combtuning[i] + spread + stereospread, rateScale);
+            combs.base[numcombs + i] = static_cast<int32_t>(arena - start) * unit;
+            combs.size[numcombs + i] = size;
+            combs.idx[numcombs + i] = 0;
+            arena += lineStride(size, format);
         }
 
-        setSettings(m_setup);
-
-        inBuffer.clear();
-        outBuffer.clear();
-        inBuffer.resize(channels + (channels % 2));
-        outBuffer.resize(channels + (channels % 2));
-        lastBufferSize = 0;
+        for(int i = 0; i < numallpasses; i++)
+        {
+            size = lineSize(allpasstuning[i] + spread, rateScale);
+            setAllpass(allpassL[i], arena, size, format);
+            arena += lineStride(size, format);
 
-        isValid = true;
-        return 0;
+            size = lineSize(allpasstuning[i] + spread + stereospread, rateScale);
+            setAllpass(allpassR[i], arena, size, format);
+            arena += lineStride(size, format);
+        }
     }
 
-    void updateSetup(const ReverbSetup& setup)
+    //! Tie the allpass to its place at the arena
+    static void setAllpass(allpass &ap, float *line, int size, int format)
     {
-        m_setup = setup;
+        if(format == FX_LINE_F32)
+            ap.setbuffer(line, size);
+        else
+            ap.setbuffer(reinterpret_cast<uint16_t*>(line), size, format);
     }
 
-    void getSetup(ReverbSetup& setup)
+    revmodel()
     {
-        setup = m_setup;
+        // Set default values
+        allpassL[0].setfeedback(0.5f);
+        allpassR[0].setfeedback(0.5f);
+        allpassL[1].setfeedback(0.5f);
+        allpassR[1].setfeedback(0.5f);
+        allpassL[2].setfeedback(0.5f);
+        allpassR[2].setfeedback(0.5f);
+        allpassL[3].setfeedback(0.5f);
+        allpassR[3].setfeedback(0.5f);
+
+        // Buffer will be full of rubbish - so we MUST mute them
+        mute();
     }
 
-    void setSettings(const ReverbSetup& setup)
+    void mute()
     {
-        for(int i = 0; i < channels; i += 2)
+        if(getmode() >= freezemode)
+            return;
+
+        for(int i = 0; i < FX_COMB_LANES && combs.arena; i++)
+            memset(combs.arena + combs.base[i], 0, sizeof(float) * combs.size[i]);
+
+        for(int i = 0; i < FX_COMB_LANES && combs.compact; i++)
+            memset(combs.compact + combs.base[i], 0, sizeof(uint16_t) * combs.size[i]);
+
+        for(int i = 0; i < numallpasses; i++)
         {
-            auto &c = rev[i / 2];
-            c.setroomsize(setup.roomSize);
-            c.setdamp(setup.damping);
-            c.setmode(setup.mode);
-            c.setdry(setup.dryLevel);
-            c.setwet(setup.wetLevel);
-            c.setwidth(setup.width);
+            allpassL[i].mute();
+            allpassR[i].mute();
         }
     }
 
-    void setMode(float val)
+    //! Zero the filter state of combs, delay lines are zeroed with the arena of the owner
+    void clearstate()
     {
-        m_setup.mode = val;
-        for(int i = 0; i < channels; i += 2)
-        {
-            auto &c = rev[i / 2];
-            c.setmode(val);
-        }
+        for(int i = 0; i < FX_COMB_LANES; i++)
+            combs.store[i] = 0.0f;
     }
 
-    void setRoomSize(float val)
+    void processmix(float* inputL, float* inputR, float* outputL, float* outputR, long numsamples, int skip)
     {
-        m_setup.roomSize = val;
-        for(int i = 0; i < channels; i += 2)
-        {
-            auto &c = rev[i / 2];
-            c.setroomsize(val);
-        }
+        process<true>(inputL, inputR, outputL, outputR, numsamples, skip);
     }
 
-    void setDamping(float val)
+    void processreplace(float* inputL, float* inputR, float* outputL, float* outputR, long numsamples, int skip)
     {
-        m_setup.damping = val;
-        for(int i = 0; i < channels; i += 2)
-        {
-            auto &c = rev[i / 2];
-            c.setdamp(val);
-        }
+        process<false>(inputL, inputR, outputL, outputR, numsamples, skip);
     }
 
-    void setWetLevel(float val)
+    /**
+     * @brief Run the model, combs go by blocks through the vector bank
+     *
+     * Mix adds the output to anything already there instead of replacing it
+     */
+    template<bool Mix>
+    void process(float* inputL, float* inputR, float* outputL, float* outputR, long numsamples, int skip)
     {
-        m_setup.wetLevel = val;
-        for(int i = 0; i < channels; i += 2)
+        float input[combblock];
+        float combOutL[combblock];
+        float combOutR[combblock];
+        float outL, outR;
+
+        updatecombs();
+
+        while(numsamples > 0)
+        {
+            const int n = numsamples > combblock ? combblock : static_cast<int>(numsamples);
+
+            for(int p = 0; p < n; p++)
+                input[p] = (inputL[p * skip] + inputR[p * skip]) * gain;
+
+            // Accumulate comb filters over the whole block
+            fxCombBlock(combs, input, combOutL, combOutR, n);
+
+            // Feed through allpasses in series, one line at a time
+            for(int i = 0; i < numallpasses; i++)
+            {
+                allpassL[i].processBlock(combOutL, n);
+                allpassR[i].processBlock(combOutR, n);
+            }
+
+            for(int p = 0; p < n; p++)
+            {
+                outL = combOutL[p];
+                outR = combOutR[p];
+
+                if(Mix)
+                {
+                    // Calculate output MIXING with anything already there
+                    *outputL += outL * wet1 + outR * wet2 + *inputL * dry;
+                    *outputR += outR * wet1 + outL * wet2 + *inputR * dry;
+                }
+                else
+                {
+                    // Calculate output REPLACING anything already there
+                    *outputL = outL * wet1 + outR * wet2 + *inputL * dry;
+                    *outputR = outR * wet1 + outL * wet2 + *inputR * dry;
+                }
+
+                // Increment sample pointers, allowing for interleave (if any)
+                inputL += skip;
+                inputR += skip;
+                outputL += skip;
+                outputR += skip;
+            }
+
+            numsamples -= n;
+        }
+    }
+
+    /**
+     * @brief Wet part only, of the mono input
+     * @param input Input samples, the sum of the channels fed into the model
+     * @param wetL Left output, width is applied already
+     * @param wetR Right output
+     * @param numsamples Number of samples
+     *
+     * The surround mode downmixes all channels into the model and spreads
+     * the result over speakers by itself
+     */
+    void processwet(const float* input, float* wetL, float* wetR, long numsamples)
+    {
+        float in[combblock];
+        float outL, outR;
+
+        updatecombs();
+
+        while(numsamples > 0)
+        {
+            const int n = numsamples > combblock ? combblock : static_cast<int>(numsamples);
+
+            for(int p = 0; p < n; p++)
+                in[p] = input[p] * gain;
+
+            fxCombBlock(combs, in, wetL, wetR, n);
+
+            for(int i = 0; i < numallpasses; i++)
+            {
+                allpassL[i].processBlock(wetL, n);
+                allpassR[i].processBlock(wetR, n);
+            }
+
+            for(int p = 0; p < n; p++)
+            {
+                outL = wetL[p];
+                outR = wetR[p];
+                wetL[p] = outL * wet1 + outR * wet2;
+                wetR[p] = outR * wet1 + outL * wet2;
+            }
+
+            input += n;
+            wetL += n;
+            wetR += n;
+            numsamples -= n;
+        }
+    }
+
+private:
+    //! Pass the settings into the comb bank
+    void updatecombs()
+    {
+        for(int i = 0; i < FX_COMB_LANES; i++)
+        {
+            combs.feedback[i] = roomsize1;
+            combs.damp1[i] = damp1;
+            combs.damp2[i] = 1 - damp1;
+        }
+    }
+
+    // The following are all declared inline
+    // to remove the need for dynamic allocation
+    // with its subsequent error-checking messiness
+
+    // Comb filters, left ones are lanes 0...7 and right ones are 8...15
+    FxCombLanes combs;
+
+    // Allpass filters
+    allpass allpassL[numallpasses];
+    allpass allpassR[numallpasses];
+
+};
+
+
+/**
+ * Up to FX_COMB_MODELS stereo models of the same tuning, run side by side.
+ *
+ * Models keep their parameters, the bank owns delay lines of all of them,
+ * interleaved by models, and advances every model in one loop. Each model
+ * gets the same output as it would get by its own processreplace().
+ */
+class revbank
+{
+public:
+    /**
+     * @brief Arena size needed by all delay lines of the bank
+     * @param rate Sample rate
+     * @param spread Extra length of every line at 44.1 kHz
+     * @return Number of floats
+     */
+    static size_t arenaSize(int rate, int spread = 0)
+    {
+        return revmodel::arenaSize(rate, spread) * FX_COMB_MODELS;
+    }
+
+    /**
+     * @brief Tie the delay lines to the arena
+     * @param rate Sample rate
+     * @param arena Cache-line aligned memory of arenaSize() floats, must be zeroed
+     * @param spread Extra length of every line at 44.1 kHz, the same as given to arenaSize()
+     */
+    void setSampleRate(int rate, float *arena, int spread = 0)
+    {
+        const double scale = rate / 44100.0;
+        int size;
+
+        combs.arena = arena;
+
+        for(int i = 0; i < numcombs; i++)
+        {
+            size = revmodel::lineSize(combtuning[i] + spread, scale);
+            combs.base[i] = static_cast<int32_t>(arena - combs.arena);
+            combs.size[i] = size;
+            combs.idx[i] = 0;
+            arena += revmodel::lineStride(size) * FX_COMB_MODELS;
+
+            size = revmodel::lineSize(combtuning[i] + spread + stereospread, scale);
+            combs.base[numcombs + i] = static_cast<int32_t>(arena - combs.arena);
+            combs.size[numcombs + i] = size;
+            combs.idx[numcombs + i] = 0;
+            arena += revmodel::lineStride(size) * FX_COMB_MODELS;
+        }
+
+        for(int i = 0; i < numallpasses; i++)
+        {
+            size = revmodel::lineSize(allpasstuning[i] + spread, scale);
+            allpassL[i].setbuffer(arena, size);
+            allpassL[i].bufidx = 0;
+            allpassL[i].setfeedback(0.5f);
+            arena += revmodel::lineStride(size) * FX_COMB_MODELS;
+
+            size = revmodel::lineSize(allpasstuning[i] + spread + stereospread, scale);
+            allpassR[i].setbuffer(arena, size);
+            allpassR[i].bufidx = 0;
+            allpassR[i].setfeedback(0.5f);
+            arena += revmodel::lineStride(size) * FX_COMB_MODELS;
+        }
+    }
+
+    //! Models run by the bank, lanes past the count stay silent
+    void setModels(revmodel *i_models, int count)
+    {
+        numModels = count < FX_COMB_MODELS ? count : FX_COMB_MODELS;
+        for(int m = 0; m < numModels; m++)
+            models[m] = i_models + m;
+    }
+
+    /**
+     * @brief Process all models, replacing the output
+     * @param in_planes Inputs, the model m takes the planes 2m and 2m + 1
+     * @param out_planes Outputs, the same planes as inputs
+     * @param numsamples Number of samples per plane
+     */
+    void processreplace(float *const *in_planes, float *const *out_planes, long numsamples)
+    {
+        const int M = FX_COMB_MODELS;
+        long pos = 0;
+
+        // Parameters can change between calls, the models keep them up to date
+        for(int m = 0; m < M; m++)
+        {
+            combs.damp1[m] = m < numModels ? models[m]->damp1 : 0.0f;
+            combs.damp2[m] = m < numModels ? 1 - models[m]->damp1 : 0.0f;
+            combs.feedback[m] = m < numModels ? models[m]->roomsize1 : 0.0f;
+        }
+
+        while(pos < numsamples)
+        {
+            const int n = numsamples - pos > combblock ? combblock : static_cast<int>(numsamples - pos);
+
+            for(int m = 0; m < M; m++)
+            {
+                if(m >= numModels)
+                {
+                    for(int p = 0; p < n; p++)
+                        input[p * M + m] = 0.0f;
+                    continue;
+                }
+
+                const float *inputL = in_planes[m * 2] + pos;
+                const float *inputR = in_planes[m * 2 + 1] + pos;
+                const float gain = models[m]->gain;
+
+                for(int p = 0; p < n; p++)
+                    input[p * M + m] = (inputL[p] + inputR[p]) * gain;
+            }
+
+            // Accumulate comb filters of all models at once
+            fxCombModelsBlock(combs, input, combOutL, combOutR, n);
+
+            // Feed through allpasses in series
+            for(int i = 0; i < numallpasses; i++)
+            {
+                fxAllpassModelsBlock(allpassL[i].buffer, allpassL[i].bufsize, allpassL[i].bufidx,
+                                     allpassL[i].feedback, combOutL, n);
+                fxAllpassModelsBlock(allpassR[i].buffer, allpassR[i].bufsize, allpassR[i].bufidx,
+                                     allpassR[i].feedback, combOutR, n);
+            }
+
+            for(int m = 0; m < numModels; m++)
+            {
+                const revparams &r = *models[m];
+                const float *inputL = in_planes[m * 2] + pos;
+                const float *inputR = in_planes[m * 2 + 1] + pos;
+                float *outputL = out_planes[m * 2] + pos;
+                float *outputR = out_planes[m * 2 + 1] + pos;
+
+                for(int p = 0; p < n; p++)
+                {
+                    const float outL = combOutL[p * M + m];
+                    const float outR = combOutR[p * M + m];
+                    outputL[p] = outL * r.wet1 + outR * r.wet2 + inputL[p] * r.dry;
+                    outputR[p] = outR * r.wet1 + outL * r.wet2 + inputR[p] * r.dry;
+                }
+            }
+
+            pos += n;
+        }
+    }
+
+    //! Zero the filter state of combs, delay lines are zeroed with the arena of the owner
+    void clearstate()
+    {
+        for(int i = 0; i < FX_COMB_LANES * FX_COMB_MODELS; i++)
+            combs.store[i] = 0.0f;
+    }
+
+private:
+    revparams  *models[FX_COMB_MODELS] = {};
+    int         numModels = 0;
+
+    // Comb filters, left ones are lines 0...7 and right ones are 8...15
+    FxCombModels combs;
+
+    // Allpass filters, the buffers are interleaved by models
+    allpass     allpassL[numallpasses];
+    allpass     allpassR[numallpasses];
+
+    // Scratch of one block, interleaved by models
+    float       input[combblock * FX_COMB_MODELS];
+    float       combOutL[combblock * FX_COMB_MODELS];
+    float       combOutR[combblock * FX_COMB_MODELS];
+};
+
+
+/*
+ * Fixed-point FreeVerb of the int16 domain samples.
+ *
+ * Coefficients are Q15, comb lines are int16 and allpass lines are int32,
+ * since the sum of combs goes beyond 16 bits. The input gets 4x more gain
+ * than the float model gives, and the output gets it back, so quiet tails
+ * keep two more bits while the combs still have headroom. The damping
+ * lowpass keeps 8 more bits of the fraction, it rounds the most. Products
+ * round to nearest, the floor would bias every one of them down and the
+ * combs would amplify that into a DC offset. Only the feedback going back
+ * into lines gets rounded toward zero, so it decays to silence instead of
+ * sticking at -1.
+ */
+const int   fixedlineshift  = 2;
+const int   fixedstorebits  = 8;
+
+//! Q15 product, rounds to nearest
+static inline int32_t mulq15(int32_t a, int32_t b)
+{
+    return static_cast<int32_t>((static_cast<int64_t>(a) * b + (1 << 14)) >> 15);
+}
+
+//! Q15 product dropping the more bits of the fraction, rounds toward zero
+static inline int32_t mulq15tozero(int32_t a, int32_t b, int bits)
+{
+    const int shift = 15 + bits;
+    const int64_t p = static_cast<int64_t>(a) * b;
+    return static_cast<int32_t>((p + ((p >> 63) & ((INT64_C(1) << shift) - 1))) >> shift);
+}
+
+static inline int32_t toq15(float v)
+{
+    return static_cast<int32_t>(v * 32768.0f + (v < 0 ? -0.5f : 0.5f));
+}
+
+static inline int16_t satq15(int32_t v)
+{
+    return static_cast<int16_t>(v < INT16_MIN ? INT16_MIN : (v > INT16_MAX ? INT16_MAX : v));
+}
+
+class revmodelfixed : public revparams
+{
+public:
+    /**
+     * @brief Allocate delay lines for the rate
+     * @param rate Sample rate
+     */
+    void setSampleRate(int rate)
+    {
+        const double scale = rate / 44100.0;
+        size_t combSize = 0, allpassSize = 0;
+        int32_t *ap;
+        int16_t *cb;
+
+        for(int i = 0; i < numcombs; i++)
+        {
+            combLen[i] = revmodel::lineSize(combtuning[i], scale);
+            combLen[numcombs + i] = revmodel::lineSize(combtuning[i] + stereospread, scale);
+        }
+
+        for(int i = 0; i < numallpasses; i++)
+        {
+            allpassLen[i] = revmodel::lineSize(allpasstuning[i], scale);
+            allpassLen[numallpasses + i] = revmodel::lineSize(allpasstuning[i] + stereospread, scale);
+        }
+
+        for(int i = 0; i < FX_COMB_LANES; i++)
+            combSize += combLen[i];
+        for(int i = 0; i < numallpasses * 2; i++)
+            allpassSize += allpassLen[i];
+
+        combMem.assign(combSize, 0);
+        allpassMem.assign(allpassSize, 0);
+
+        cb = combMem.data();
+        for(int i = 0; i < FX_COMB_LANES; i++)
+        {
+            combLine[i] = cb;
+            combIdx[i] = 0;
+            combStore[i] = 0;
+            cb += combLen[i];
+        }
+
+        ap = allpassMem.data();
+        for(int i = 0; i < numallpasses * 2; i++)
+        {
+            allpassLine[i] = ap;
+            allpassIdx[i] = 0;
+            ap += allpassLen[i];
+        }
+    }
+
+    /**
+     * @brief Run the model, replacing the output
+     * @param inputL Left input, int16 domain
+     * @param inputR Right input
+     * @param outputL Left output, saturated to the int16 domain
+     * @param outputR Right output
+     * @param numsamples Number of samples
+     */
+    void processreplace(const int32_t* inputL, const int32_t* inputR,
+                        int32_t* outputL, int32_t* outputR, long numsamples)
+    {
+        int32_t input[combblock];
+        int32_t combOutL[combblock];
+        int32_t combOutR[combblock];
+        const int32_t q_gain = toq15(gain * (1 << fixedlineshift));
+        const int32_t q_feedback = toq15(roomsize1);
+        const int32_t q_damp1 = toq15(damp1);
+        const int32_t q_damp2 = toq15(1 - damp1);
+        const int32_t q_wet1 = toq15(wet1 / (1 << fixedlineshift));
+        const int32_t q_wet2 = toq15(wet2 / (1 << fixedlineshift));
+        const int32_t q_dry = toq15(dry);
+
+        while(numsamples > 0)
+        {
+            const int n = numsamples > combblock ? combblock : static_cast<int>(numsamples);
+
+            for(int p = 0; p < n; p++)
+                input[p] = mulq15(inputL[p] + inputR[p], q_gain);
+
+            // Combs go one by one over the block, the ring is split at the wrap
+            for(int i = 0; i < FX_COMB_LANES; i++)
+            {
+                int32_t *out = i < numcombs ? combOutL : combOutR;
+                const bool first = i == 0 || i == numcombs;
+                int32_t store = combStore[i];
+                int idx = combIdx[i];
+
+                for(int p = 0; p < n;)
+                {
+                    const int run = n - p < combLen[i] - idx ? n - p : combLen[i] - idx;
+                    int16_t *d = combLine[i] + idx;
+
+                    for(int j = 0; j < run; j++)
+                    {
+                        const int32_t v = d[j];
+                        store = mulq15(v * (1 << fixedstorebits), q_damp2) + mulq15(store, q_damp1);
+                        d[j] = satq15(input[p + j] + mulq15tozero(store, q_feedback, fixedstorebits));
+                        out[p + j] = first ? v : out[p + j] + v;
+                    }
+
+                    p += run;
+                    idx += run;
+                    if(idx >= combLen[i])
+                        idx = 0;
+                }
+
+                combStore[i] = store;
+                combIdx[i] = idx;
+            }
+
+            // Allpasses in series, in place
+            for(int i = 0; i < numallpasses * 2; i++)
+            {
+                int32_t *io = i < numallpasses ? combOutL : combOutR;
+                int idx = allpassIdx[i];
+
+                for(int p = 0; p < n;)
+                {
+                    const int run = n - p < allpassLen[i] - idx ? n - p : allpassLen[i] - idx;
+                    int32_t *d = allpassLine[i] + idx;
+
+                    for(int j = 0; j < run; j++)
+                    {
+                        const int32_t in = io[p + j];
+                        const int32_t bufout = d[j];
+                        io[p + j] = bufout - in;
+                        // Feedback of allpasses is always 0.5
+                        d[j] = in + bufout / 2;
+                    }
+
+                    p += run;
+                    idx += run;
+                    if(idx >= allpassLen[i])
+                        idx = 0;
+                }
+
+                allpassIdx[i] = idx;
+            }
+
+            for(int p = 0; p < n; p++)
+            {
+                const int64_t outL = combOutL[p];
+                const int64_t outR = combOutR[p];
+                const int64_t l = outL * q_wet1 + outR * q_wet2 + (int64_t)inputL[p] * q_dry;
+                const int64_t r = outR * q_wet1 + outL * q_wet2 + (int64_t)inputR[p] * q_dry;
+                outputL[p] = satq15(static_cast<int32_t>((l + (1 << 14)) >> 15));
+                outputR[p] = satq15(static_cast<int32_t>((r + (1 << 14)) >> 15));
+            }
+
+            inputL += n;
+            inputR += n;
+            outputL += n;
+            outputR += n;
+            numsamples -= n;
+        }
+    }
+
+    //! Zero the delay lines and the filter state
+    void clearstate()
+    {
+        std::fill(combMem.begin(), combMem.end(), 0);
+        std::fill(allpassMem.begin(), allpassMem.end(), 0);
+        for(int i = 0; i < FX_COMB_LANES; i++)
+            combStore[i] = 0;
+    }
+
+private:
+    // Comb filters, left ones are lines 0...7 and right ones are 8...15
+    std::vector<int16_t> combMem;
+    int16_t    *combLine[FX_COMB_LANES] = {};
+    int         combLen[FX_COMB_LANES] = {};
+    int         combIdx[FX_COMB_LANES] = {};
+    int32_t     combStore[FX_COMB_LANES] = {};
+
+    // Allpass filters, left ones go first
+    std::vector<int32_t> allpassMem;
+    int32_t    *allpassLine[numallpasses * 2] = {};
+    int         allpassLen[numallpasses * 2] = {};
+    int         allpassIdx[numallpasses * 2] = {};
+};
+
+
+/*
+ * Feedback delay network: 8 lines of mutually prime lengths, a one-pole
+ * damping in every loop and the Householder feedback matrix. The input goes
+ * through the same allpasses as the FreeVerb has, in series, to get dense
+ * from the start. Costs about a half of the FreeVerb operations per sample.
+ */
+static const int fdntuning[FX_FDN_LINES] =
+{
+    1039, 1153, 1277, 1399, 1523, 1637, 1753, 1879
+};
+//! Average FreeVerb comb length, the room size gives the feedback over this many samples
+const double fdnreference   = 1378.0;
+//! Input level of the network, gives about the same wet level as the FreeVerb does
+const float fdngain         = 1.2f;
+//! Line signs at the input and at both outputs, rows of the Hadamard matrix
+static const float fdninsign[FX_FDN_LINES] = {1, 1, 1, 1, 1, 1, 1, 1};
+static const float fdntapl[FX_FDN_LINES]   = {1, -1, 1, -1, 1, -1, 1, -1};
+static const float fdntapr[FX_FDN_LINES]   = {1, 1, -1, -1, 1, 1, -1, -1};
+
+class fdnmodel : public revparams
+{
+public:
+    /**
+     * @brief Arena size needed by all delay lines of the model
+     * @param rate Sample rate
+     * @param spread Extra length of every line at 44.1 kHz
+     * @param format One of FxLineFormat
+     * @return Number of floats
+     */
+    static size_t arenaSize(int rate, int spread = 0, int format = FX_LINE_F32)
+    {
+        const double scale = rate / 44100.0;
+        size_t size = 0;
+
+        for(int k = 0; k < FX_FDN_LINES; k++)
+            size += revmodel::lineStride(revmodel::lineSize(fdntuning[k] + spread, scale), format);
+
+        for(int i = 0; i < numallpasses; i++)
+            size += revmodel::lineStride(revmodel::lineSize(allpasstuning[i] + spread, scale), format);
+
+        return size;
+    }
+
+    /**
+     * @brief Tie the delay lines to the arena
+     * @param rate Sample rate
+     * @param arena Cache-line aligned memory of arenaSize() floats, must be zeroed
+     * @param spread Extra length of every line at 44.1 kHz, the same as given to arenaSize()
+     * @param format One of FxLineFormat, the same as given to arenaSize()
+     */
+    void setSampleRate(int rate, float *arena, int spread = 0, int format = FX_LINE_F32)
+    {
+        const double scale = rate / 44100.0;
+        int size;
+
+        block = combblock;
+        lineFormat = format;
+
+        for(int k = 0; k < FX_FDN_LINES; k++)
+        {
+            size = revmodel::lineSize(fdntuning[k] + spread, scale);
+            line[k] = format == FX_LINE_F32 ? arena : nullptr;
+            compact[k] = format == FX_LINE_F32 ? nullptr : reinterpret_cast<uint16_t*>(arena);
+            lineSize[k] = size;
+            lineIdx[k] = 0;
+            store[k] = 0.0f;
+            lineRatio[k] = (fdntuning[k] + spread) / fdnreference;
+            arena += revmodel::lineStride(size, format);
+
+            // Block must not be longer than any line, the input written into the block is read back later
+            block = size < block ? size : block;
+        }
+
+        for(int i = 0; i < numallpasses; i++)
+        {
+            size = revmodel::lineSize(allpasstuning[i] + spread, scale);
+            revmodel::setAllpass(diffuser[i], arena, size, format);
+            diffuser[i].bufidx = 0;
+            diffuser[i].setfeedback(0.5f);
+            arena += revmodel::lineStride(size, format);
+        }
+
+        scratch.assign(static_cast<size_t>(block) * FX_FDN_LINES * 2, 0.0f);
+        for(int k = 0; k < FX_FDN_LINES; k++)
+        {
+            outs[k] = scratch.data() + static_cast<size_t>(block) * k;
+            mixes[k] = scratch.data() + static_cast<size_t>(block) * (FX_FDN_LINES + k);
+        }
+    }
+
+    void processreplace(const float* inputL, const float* inputR, float* outputL, float* outputR, long numsamples)
+    {
+        float input[combblock];
+        // Outputs may be the same planes as inputs, the dry part is taken before the block overwrites them
+        float dryL[combblock];
+        float dryR[combblock];
+
+        updatelines();
+
+        while(numsamples > 0)
+        {
+            const int n = numsamples > block ? block : static_cast<int>(numsamples);
+
+            for(int p = 0; p < n; p++)
+            {
+                input[p] = inputL[p] + inputR[p];
+                dryL[p] = inputL[p] * dry;
+                dryR[p] = inputR[p] * dry;
+            }
+
+            processblock(input, outputL, outputR, n);
+
+            for(int p = 0; p < n; p++)
+            {
+                outputL[p] += dryL[p];
+                outputR[p] += dryR[p];
+            }
+
+            inputL += n;
+            inputR += n;
+            outputL += n;
+            outputR += n;
+            numsamples -= n;
+        }
+    }
+
+    //! Wet part only of the mono input, the same as revmodel::processwet()
+    void processwet(const float* input, float* wetL, float* wetR, long numsamples)
+    {
+        updatelines();
+
+        while(numsamples > 0)
+        {
+            const int n = numsamples > block ? block : static_cast<int>(numsamples);
+
+            processblock(input, wetL, wetR, n);
+
+            input += n;
+            wetL += n;
+            wetR += n;
+            numsamples -= n;
+        }
+    }
+
+    //! Zero the filter state of lines, delay lines are zeroed with the arena of the owner
+    void clearstate()
+    {
+        for(int k = 0; k < FX_FDN_LINES; k++)
+            store[k] = 0.0f;
+    }
+
+private:
+    //! Pass the settings into the per-line gains
+    void updatelines()
+    {
+        for(int k = 0; k < FX_FDN_LINES; k++)
+        {
+            // Longer lines lose more per pass, so every line decays at the same rate
+            const float g = static_cast<float>(std::pow(static_cast<double>(roomsize1), lineRatio[k]));
+            loopGain[k] = g * (1 - damp1);
+            inGain[k] = fdninsign[k] * gain * fdngain;
+        }
+    }
+
+    void processblock(const float* input, float* wetL, float* wetR, int n)
+    {
+        float in[combblock];
+        float outL, outR;
+
+        memcpy(in, input, sizeof(float) * n);
+        for(int i = 0; i < numallpasses; i++)
+            diffuser[i].processBlock(in, n);
+
+        // Outputs of the lines, the ring gets split at the wrap
+        for(int k = 0; k < FX_FDN_LINES; k++)
+        {
+            const int first = n < lineSize[k] - lineIdx[k] ? n : lineSize[k] - lineIdx[k];
+
+            if(compact[k])
+            {
+                fxLineLoad(lineFormat, compact[k] + lineIdx[k], outs[k], first, combscale);
+                fxLineLoad(lineFormat, compact[k], outs[k] + first, n - first, combscale);
+                continue;
+            }
+
+            memcpy(outs[k], line[k] + lineIdx[k], sizeof(float) * first);
+            memcpy(outs[k] + first, line[k], sizeof(float) * (n - first));
+        }
+
+        fxFdnDampBlock(outs, mixes, store, loopGain, damp1, n);
+        fxFdnMatrixBlock(mixes, mixes, in, inGain, n);
+
+        for(int k = 0; k < FX_FDN_LINES; k++)
+        {
+            const int first = n < lineSize[k] - lineIdx[k] ? n : lineSize[k] - lineIdx[k];
+
+            if(compact[k])
+            {
+                fxLineStore(lineFormat, compact[k] + lineIdx[k], mixes[k], first, combscale);
+                fxLineStore(lineFormat, compact[k], mixes[k] + first, n - first, combscale);
+            }
+            else
+            {
+                memcpy(line[k] + lineIdx[k], mixes[k], sizeof(float) * first);
+                memcpy(line[k], mixes[k] + first, sizeof(float) * (n - first));
+            }
+
+            lineIdx[k] = (lineIdx[k] + n) % lineSize[k];
+        }
+
+        fxFdnTapsBlock(outs, fdntapl, fdntapr, wetL, wetR, n);
+
+        for(int p = 0; p < n; p++)
+        {
+            outL = wetL[p];
+            outR = wetR[p];
+            wetL[p] = outL * wet1 + outR * wet2;
+            wetR[p] = outR * wet1 + outL * wet2;
+        }
+    }
+
+    // Delay lines, float or compact ones of the lineFormat
+    float      *line[FX_FDN_LINES] = {};
+    uint16_t   *compact[FX_FDN_LINES] = {};
+    int         lineFormat = FX_LINE_F32;
+    int         lineSize[FX_FDN_LINES] = {};
+    int         lineIdx[FX_FDN_LINES] = {};
+    double      lineRatio[FX_FDN_LINES] = {};
+    float       store[FX_FDN_LINES] = {};
+    float       loopGain[FX_FDN_LINES] = {};
+    float       inGain[FX_FDN_LINES] = {};
+
+    // Input diffusion
+    allpass     diffuser[numallpasses];
+
+    //! Samples processed at once, not longer than the shortest line
+    int         block = combblock;
+    //! Outputs of lines and inputs of lines, block samples per line
+    std::vector<float>  scratch;
+    float      *outs[FX_FDN_LINES] = {};
+    float      *mixes[FX_FDN_LINES] = {};
+};
+
+
+/**
+ * @brief Should the stream be processed by the fixed-point model
+ * @param format Audio format (one of AUDIO_*)
+ * @param config Options of the effect
+ *
+ * S16 streams only, on request, the INTEGER_ONLY_REVERB build has nothing else.
+ */
+static inline bool reverbUseFixed(uint16_t format, const ReverbConfig &config)
+{
+#ifdef INTEGER_ONLY_REVERB
+    (void)format;
+    (void)config;
+    return true;
+#else
+    return (format == AUDIO_S16LSB || format == AUDIO_S16MSB) && config.fixedPoint;
+#endif
+}
+
+
+//! Speaker positions of the SDL channel layouts
+enum ReverbSpeaker
+{
+    SPK_FL = 0, SPK_FR, SPK_FC, SPK_LFE, SPK_BL, SPK_BR, SPK_BC, SPK_SL, SPK_SR, SPK_NONE
+};
+
+//! Speakers by the number of channels, in the SDL order
+static const int surroundLayouts[9][8] =
+{
+    {SPK_NONE},
+    {SPK_FC},
+    {SPK_FL, SPK_FR},
+    {SPK_FL, SPK_FR, SPK_LFE},
+    {SPK_FL, SPK_FR, SPK_BL, SPK_BR},
+    {SPK_FL, SPK_FR, SPK_LFE, SPK_BL, SPK_BR},
+    {SPK_FL, SPK_FR, SPK_FC, SPK_LFE, SPK_BL, SPK_BR},
+    {SPK_FL, SPK_FR, SPK_FC, SPK_LFE, SPK_BC, SPK_SL, SPK_SR},
+    {SPK_FL, SPK_FR, SPK_FC, SPK_LFE, SPK_BL, SPK_BR, SPK_SL, SPK_SR}
+};
+
+//! Surround matrix row of the speaker
+struct ReverbSpeakerGains
+{
+    //! Part of the input fed into the front and the rear tanks
+    float send[2];
+    //! Quad: front left, front right, rear left and rear right tank outputs
+    float quad[4];
+    //! Stereo: left and right tank outputs
+    float stereo[2];
+};
+
+// LFE gets neither the send nor the wet signal
+static const ReverbSpeakerGains surroundGains[SPK_NONE] =
+{
+    /* FL  */ {{1.0f, 0.5f}, {1.0f, 0.0f, 0.0f, 0.0f}, {1.0f, 0.0f}},
+    /* FR  */ {{1.0f, 0.5f}, {0.0f, 1.0f, 0.0f, 0.0f}, {0.0f, 1.0f}},
+    /* FC  */ {{1.0f, 0.5f}, {0.5f, 0.5f, 0.0f, 0.0f}, {0.5f, 0.5f}},
+    /* LFE */ {{0.0f, 0.0f}, {0.0f, 0.0f, 0.0f, 0.0f}, {0.0f, 0.0f}},
+    /* BL  */ {{0.5f, 1.0f}, {0.0f, 0.0f, 1.0f, 0.0f}, {1.0f, 0.0f}},
+    /* BR  */ {{0.5f, 1.0f}, {0.0f, 0.0f, 0.0f, 1.0f}, {0.0f, 1.0f}},
+    /* BC  */ {{0.5f, 1.0f}, {0.0f, 0.0f, 0.5f, 0.5f}, {0.5f, 0.5f}},
+    /* SL  */ {{1.0f, 1.0f}, {0.7071f, 0.0f, 0.7071f, 0.0f}, {1.0f, 0.0f}},
+    /* SR  */ {{1.0f, 1.0f}, {0.0f, 0.7071f, 0.0f, 0.7071f}, {0.0f, 1.0f}}
+};
+
+
+typedef struct FxReverb
+{
+    int         channels = 0;
+    int         sampleRate = 0;
+    uint16_t    format = AUDIO_F32LSB;
+    bool        isValid = false;
+    //! Setup of the control thread, models get it through the sharedSetup at the start of the block
+    ReverbSetup m_setup;
+    FxSnapshot<ReverbSetup> sharedSetup;
+    //! Tail of the m_setup, counted by the control thread as it publishes, see tailLength()
+    std::atomic<int> tailFrames{0};
+
+    revmodel    rev[MAX_CHANNELS / 2];
+    //! Number of models in use
+    int         models = 0;
+    //! Channel pairs of the same tuning run side by side by the bank
+    revbank     bank;
+    bool        useBank = false;
+    //! Feedback delay networks in place of FreeVerb models, see ReverbEngine
+    fdnmodel    fdn[MAX_CHANNELS / 2];
+    bool        useFdn = false;
+
+    //! Delay lines of models in use, one after another
+    std::vector<float>  arena;
+    //! Storage of the delay lines, see ReverbConfig::lines
+    int         lineFormat = FX_LINE_F32;
+
+    ReverbConfig m_config;
+    //! Surround mode in effect, pairs for mono, stereo and unknown layouts
+    int         surround = REVERB_SURROUND_PAIRS;
+    //! Surround: part of every channel fed into each tank
+    float       surroundSend[2][MAX_CHANNELS];
+    //! Surround: gain of every tank output per channel
+    float       surroundWet[MAX_CHANNELS][4];
+    //! Surround: dry gain of the applied setup, the audio thread never reads the m_setup
+    float       surroundDry = 0.0f;
+
+    //! Input and output planes of maxFrames each, the odd channel gets a pair
+    std::vector<float>  buffers;
+    float              *inPlanes[MAX_CHANNELS + 1];
+    float              *outPlanes[MAX_CHANNELS + 1];
+    //! Surround: tank inputs and outputs, maxFrames each
+    float              *tankIn[2];
+    float              *tankOut[4];
+
+    FxCodec<float>  codec;
+
+    //! Kernel instantiated for the current number of channels
+    void (FxReverb::*processFramesCB)(float *const *in_planes, float *const *out_planes, int frames) = nullptr;
+
+    //! The stream is processed by the fixed-point models, see reverbUseFixed()
+    bool            useFixed = false;
+    revmodelfixed   fixedRev[MAX_CHANNELS / 2];
+    FxCodec<int32_t> fixedCodec;
+    //! Fixed-point input and output planes, the same layout as the float ones
+    std::vector<int32_t> fixedBuffers;
+    int32_t        *fixedIn[MAX_CHANNELS + 1];
+    int32_t        *fixedOut[MAX_CHANNELS + 1];
+    void (FxReverb::*processFixedCB)(int32_t *const *in_planes, int32_t *const *out_planes, int frames) = nullptr;
+
+    //! Models of more than two channels run in parallel, see ReverbConfig::threads
+    FxWorkers       workers;
+    //! Block length of the current run, workers process the member planes
+    int             jobFrames = 0;
+
+    int init(int i_rate, uint16_t i_format, int i_channels, const ReverbConfig &config)
+    {
+        isValid = false;
+
+        if(i_channels > MAX_CHANNELS)
+            return -1;
+
+        if(config.maxFrames <= 0)
+            return -1;
+
+        if(config.surround < REVERB_SURROUND_PAIRS || config.surround > REVERB_SURROUND_QUAD)
+            return -1;
+
+        if(config.engine < REVERB_ENGINE_FREEVERB || config.engine > REVERB_ENGINE_FDN)
+            return -1;
+
+        if(config.threads < 0)
+            return -1;
+
+        if(config.lines < REVERB_LINES_FLOAT || config.lines > REVERB_LINES_HALF)
+            return -1;
+
+        m_config = config;
+        sharedSetup.reset(m_setup);
+
+        format = i_format;
+        sampleRate = i_rate;
+        channels = i_channels;
+
+#ifdef INTEGER_ONLY_REVERB
+        if(format != AUDIO_S16LSB && format != AUDIO_S16MSB)
+            return -1; /* Disallowed format */
+#endif
+
+        useFixed = reverbUseFixed(format, config);
+        useFdn = !useFixed && config.engine == REVERB_ENGINE_FDN;
+
+        switch(config.lines)
+        {
+        case REVERB_LINES_S16:
+            lineFormat = FX_LINE_S16;
+            break;
+        case REVERB_LINES_HALF:
+            lineFormat = FX_LINE_F16;
+            break;
+        default:
+            lineFormat = FX_LINE_F32;
+            break;
+        }
+
+        if(useFixed)
+            return initFixed();
+
+        if(!codec.init(format, channels))
+            return -1;
+
+        surround = channels > 2 && channels <= 8 ? config.surround : REVERB_SURROUND_PAIRS;
+
+        switch(surround)
+        {
+        case REVERB_SURROUND_STEREO:
+            models = 1;
+            break;
+        case REVERB_SURROUND_QUAD:
+            models = 2;
+            break;
+        default:
+            models = (channels + 1) / 2;
+            break;
+        }
+
+        if(surround != REVERB_SURROUND_PAIRS)
+        {
+            setSurroundMatrix();
+
+            switch(channels)
+            {
+            case 6:
+                processFramesCB = &FxReverb::processSurround<6>;
+                break;
+            case 8:
+                processFramesCB = &FxReverb::processSurround<8>;
+                break;
+            default:
+                processFramesCB = &FxReverb::processSurround<0>;
+                break;
+            }
+        }
+        else
+        {
+            switch(channels)
+            {
+            case 1:
+                processFramesCB = &FxReverb::processFrames<1>;
+                break;
+            case 2:
+                processFramesCB = &FxReverb::processFrames<2>;
+                break;
+            case 6:
+                processFramesCB = &FxReverb::processFrames<6>;
+                break;
+            case 8:
+                processFramesCB = &FxReverb::processFrames<8>;
+                break;
+            default:
+                processFramesCB = &FxReverb::processFrames<0>;
+                break;
+            }
+        }
+
+        size_t arenaFloats = 0;
+        float *lines;
+
+        startWorkers();
+
+        // Pairs share the tuning, the bank pays off once more than a half of its lanes is in use
+        useBank = !workers.active() && !useFdn && lineFormat == FX_LINE_F32 &&
+                  surround == REVERB_SURROUND_PAIRS && models > FX_COMB_MODELS / 2 && models <= FX_COMB_MODELS;
+
+        if(useBank)
+            arenaFloats = revbank::arenaSize(sampleRate);
+        else if(useFdn)
+        {
+            for(int i = 0; i < models; ++i)
+                arenaFloats += fdnmodel::arenaSize(sampleRate, modelSpread(i), lineFormat);
+        }
+        else
+        {
+            for(int i = 0; i < models; ++i)
+                arenaFloats += revmodel::arenaSize(sampleRate, modelSpread(i), lineFormat);
+        }
+
+        // The spare cache line lets the start get aligned, the memory is reused by the next init if it fits
+        arena.assign(arenaFloats + arenaalign, 0.0f);
+        lines = arena.data();
+        lines += (arenaalign - (reinterpret_cast<uintptr_t>(lines) / sizeof(float)) % arenaalign) % arenaalign;
+
+        if(useBank)
+        {
+            bank.setSampleRate(sampleRate, lines);
+            bank.setModels(rev, models);
+        }
+        else if(useFdn)
+        {
+            for(int i = 0; i < models; ++i)
+            {
+                fdn[i].setSampleRate(sampleRate, lines, modelSpread(i), lineFormat);
+                lines += fdnmodel::arenaSize(sampleRate, modelSpread(i), lineFormat);
+            }
+        }
+        else
+        {
+            for(int i = 0; i < models; ++i)
+            {
+                rev[i].setSampleRate(sampleRate, lines, modelSpread(i), lineFormat);
+                lines += revmodel::arenaSize(sampleRate, modelSpread(i), lineFormat);
+            }
+        }
+
+        setSettings(m_setup);
+
+        const int planes = channels + (channels % 2);
+        const int tankPlanes = surround != REVERB_SURROUND_PAIRS ? models * 3 : 0;
+        const size_t stride = (size_t)m_config.maxFrames;
+
+        buffers.assign(stride * (planes * 2 + tankPlanes), 0.0f);
+        for(int i = 0; i < planes; ++i)
         {
-            auto &c = rev[i / 2];
-            c.setwet(val);
+            inPlanes[i] = buffers.data() + stride * i;
+            outPlanes[i] = buffers.data() + stride * (planes + i);
         }
+
+        for(int i = 0; i < tankPlanes; ++i)
+        {
+            float *plane = buffers.data() + stride * (planes * 2 + i);
+            if(i < models)
+                tankIn[i] = plane;
+            else
+                tankOut[i - models] = plane;
+        }
+
+        updateTail();
+        isValid = true;
+        return 0;
     }
 
-    void setDryLevel(float val)
+    //! Set up the fixed-point path, it runs a model per channel pair
+    int initFixed()
     {
-        m_setup.dryLevel = val;
-        for(int i = 0; i < channels; i += 2)
+        if(!fixedCodec.init(format, channels))
+            return -1;
+
+        surround = REVERB_SURROUND_PAIRS;
+        models = (channels + 1) / 2;
+        useBank = false;
+
+        switch(channels)
+        {
+        case 1:
+            processFixedCB = &FxReverb::processFixed<1>;
+            break;
+        case 2:
+            processFixedCB = &FxReverb::processFixed<2>;
+            break;
+        case 6:
+            processFixedCB = &FxReverb::processFixed<6>;
+            break;
+        case 8:
+            processFixedCB = &FxReverb::processFixed<8>;
+            break;
+        default:
+            processFixedCB = &FxReverb::processFixed<0>;
+            break;
+        }
+
+        for(int i = 0; i < models; ++i)
+            fixedRev[i].setSampleRate(sampleRate);
+
+        startWorkers();
+
+        setSettings(m_setup);
+
+        const int planes = channels + (channels % 2);
+        const size_t stride = (size_t)m_config.maxFrames;
+
+        fixedBuffers.assign(stride * planes * 2, 0);
+        for(int i = 0; i < planes; ++i)
+        {
+            fixedIn[i] = fixedBuffers.data() + stride * i;
+            fixedOut[i] = fixedBuffers.data() + stride * (planes + i);
+        }
+
+        updateTail();
+        isValid = true;
+        return 0;
+    }
+
+    //! Spread models over the workers if the config asks for it and there are more than one to share
+    void startWorkers()
+    {
+        const int count = m_config.threads < models - 1 ? m_config.threads : models - 1;
+
+        workers.stop();
+        if(channels > 2 && count > 0)
+            workers.start(count, &FxReverb::modelJob, this, models);
+    }
+
+    static void modelJob(void *owner, int job)
+    {
+        static_cast<FxReverb*>(owner)->runModel(job);
+    }
+
+    //! Process one model of the current block by the member planes, the job of workers
+    void runModel(int i)
+    {
+        const int frames = jobFrames;
+
+        if(useFixed)
+            fixedRev[i].processreplace(fixedIn[i * 2], fixedIn[i * 2 + 1], fixedOut[i * 2], fixedOut[i * 2 + 1], frames);
+        else if(surround != REVERB_SURROUND_PAIRS)
+            runTank<0>(inPlanes, i, frames);
+        else if(useFdn)
+            fdn[i].processreplace(inPlanes[i * 2], inPlanes[i * 2 + 1], outPlanes[i * 2], outPlanes[i * 2 + 1], frames);
+        else
+            rev[i].processreplace(inPlanes[i * 2], inPlanes[i * 2 + 1], outPlanes[i * 2], outPlanes[i * 2 + 1], frames, 1);
+    }
+
+    //! Settings of the model in use
+    revparams &params(int i)
+    {
+        if(useFixed)
+            return fixedRev[i];
+        if(useFdn)
+            return fdn[i];
+        return rev[i];
+    }
+
+    //! Extra line length of the model, the rear tank of the quad is tuned apart
+    int modelSpread(int model) const
+    {
+        return surround == REVERB_SURROUND_QUAD && model == 1 ? rearspread : 0;
+    }
+
+    //! Fill the send and wet gains of the surround mode from the speaker layout
+    void setSurroundMatrix()
+    {
+        const int *layout = surroundLayouts[channels];
+        float sendPower[2] = {0.0f, 0.0f};
+
+        for(int c = 0; c < channels; ++c)
+        {
+            const ReverbSpeakerGains &g = surroundGains[layout[c]];
+
+            if(surround == REVERB_SURROUND_QUAD)
+            {
+                surroundSend[0][c] = g.send[0];
+                surroundSend[1][c] = g.send[1];
+                for(int k = 0; k < 4; ++k)
+                    surroundWet[c][k] = g.quad[k];
+            }
+            else
+            {
+                surroundSend[0][c] = g.send[0] > 0.0f || g.send[1] > 0.0f ? 1.0f : 0.0f;
+                surroundSend[1][c] = 0.0f;
+                surroundWet[c][0] = g.stereo[0];
+                surroundWet[c][1] = g.stereo[1];
+                surroundWet[c][2] = 0.0f;
+                surroundWet[c][3] = 0.0f;
+            }
+
+            sendPower[0] += surroundSend[0][c] * surroundSend[0][c];
+            sendPower[1] += surroundSend[1][c] * surroundSend[1][c];
+        }
+
+        // Uncorrelated channels give every tank the same level as a model of one channel pair gets
+        for(int t = 0; t < 2; ++t)
         {
-            auto &c = rev[i / 2];
-            c.setdry(val);
+            const float norm = sendPower[t] > 0.0f ? std::sqrt(2.0f / sendPower[t]) : 0.0f;
+            for(int c = 0; c < channels; ++c)
+                surroundSend[t][c] *= norm;
         }
     }
 
+    //! Control thread: pass the changed m_setup to the audio thread
+    void publishSetup()
+    {
+        updateTail();
+        sharedSetup.publish(m_setup);
+    }
+
+    //! Control thread: the whole setup goes to the audio thread at once
+    void updateSetup(const ReverbSetup& setup)
+    {
+        m_setup = setup;
+        publishSetup();
+    }
+
+    void getSetup(ReverbSetup& setup)
+    {
+        setup = m_setup;
+    }
+
+    //! Audio thread: pass the setup into every model with a single recompute each
+    void setSettings(const ReverbSetup& setup)
+    {
+        for(int i = 0; i < models; ++i)
+            params(i).setsetup(setup);
+
+        surroundDry = setup.dryLevel * scaledry;
+    }
+
+    //! Audio thread: take the setup published since the last block
+    void acquireSetup()
+    {
+        if(sharedSetup.acquire())
+            setSettings(sharedSetup.read());
+    }
+
+    void setMode(float val)
+    {
+        m_setup.mode = val;
+        publishSetup();
+    }
+
+    void setRoomSize(float val)
+    {
+        m_setup.roomSize = val;
+        publishSetup();
+    }
+
+    void setDamping(float val)
+    {
+        m_setup.damping = val;
+        publishSetup();
+    }
+
+    void setWetLevel(float val)
+    {
+        m_setup.wetLevel = val;
+        publishSetup();
+    }
+
+    void setDryLevel(float val)
+    {
+        m_setup.dryLevel = val;
+        publishSetup();
+    }
+
     void setWidth(float val)
     {
         m_setup.width = val;
-        for(int i = 0; i < channels; i += 2)
+        publishSetup();
+    }
+
+    //! Silence all delay lines and filters, the setup is kept
+    void reset()
+    {
+        // Float and compact lines of every model are placed at the arena
+        std::fill(arena.begin(), arena.end(), 0.0f);
+        bank.clearstate();
+
+        for(int i = 0; i < models; ++i)
         {
-            auto &c = rev[i / 2];
-            c.setwidth(val);
+            rev[i].clearstate();
+            fdn[i].clearstate();
+            fixedRev[i].clearstate();
         }
     }
 
+    //! Frames the tail stays above -96 dB once the input got silent, by the last published setup. Any thread
+    int tailLength() const
+    {
+        return tailFrames.load(std::memory_order_relaxed);
+    }
+
+    //! Control thread: count the tail of the m_setup for tailLength()
+    void updateTail()
+    {
+        tailFrames.store(countTail(m_setup), std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Frames the tail of the setup stays above -96 dB once the input got silent
+     * @param setup Setup to count by
+     * @return Decay time of the slowest feedback loop and the diffusion, or FX_TAIL_INFINITE
+     *
+     * The damping only makes loops lose more, the DC gain of the loop is the feedback.
+     */
+    int countTail(const ReverbSetup &setup) const
+    {
+        const double floor_level = 1.0 / 65536.0;
+        const double scale = sampleRate / 44100.0;
+        // The rear tank of the quad is the longest one
+        const int spread = models > 0 ? modelSpread(models - 1) : 0;
+        const double feedback = setup.roomSize * scaleroom + offsetroom;
+        double loop, passes = 1.0, diffusion = 0.0;
+
+        if(setup.mode >= freezemode || feedback >= 1.0)
+            return FX_TAIL_INFINITE;
+
+        if(feedback > 0.0)
+            passes = std::ceil(std::log(floor_level) / std::log(feedback));
+
+        // FDN lines lose the feedback per the reference length, FreeVerb combs per their own length
+        if(useFdn)
+            loop = fdnreference * scale;
+        else
+            loop = revmodel::lineSize(combtuning[numcombs - 1] + spread + stereospread, scale);
+
+        // Allpasses of the feedback 0.5 lose 6 dB per pass
+        for(int i = 0; i < numallpasses; i++)
+            diffusion += revmodel::lineSize(allpasstuning[i] + spread + stereospread, scale) * 16.0;
+
+        const double tail = passes * loop + diffusion;
+        if(tail > INT32_MAX / 2)
+            return FX_TAIL_INFINITE;
+
+        return (int)tail;
+    }
+
     void close()
     {
         isValid = false;
+        workers.stop();
     }
 
-    void process(uint8_t* stream, int len)
+    /**
+     * @brief Process the planar block
+     *
+     * CH is the compile-time number of channels (or 0 to use the runtime value),
+     * the odd channel handling gets compiled out for even channel counts
+     */
+    template<int CH>
+    void processFrames(float *const *in_planes, float *const *out_planes, int frames)
     {
-        if(!isValid)
-            return; // Do nothing
+        const int chans = CH ? CH : channels;
+
+        if(chans % 2 == 1) // Mono to Stereo
+            memcpy(in_planes[chans], in_planes[chans - 1], sizeof(float) * frames);
+
+        if(useBank)
+            bank.processreplace(in_planes, out_planes, frames);
+        else if(workers.active())
+        {
+            jobFrames = frames;
+            workers.run();
+        }
+        else if(useFdn)
+        {
+            for(int i = 0; i < chans; i += 2)
+                fdn[i / 2].processreplace(in_planes[i], in_planes[i + 1], out_planes[i], out_planes[i + 1], frames);
+        }
+        else
+        {
+            for(int i = 0; i < chans; i += 2)
+            {
+                auto &c = rev[i / 2];
+                c.processreplace(in_planes[i], in_planes[i + 1],
+                                 out_planes[i], out_planes[i + 1], frames, 1);
+            }
+        }
+
+        if(chans % 2 == 1) // Stereo to Mono
+        {
+            float *l = out_planes[chans - 1];
+            float *r = out_planes[chans];
+            for(int p = 0; p < frames; ++p)
+                l[p] = (l[p] + r[p]) / 2.0f;
+        }
+    }
 
-        int frames = len / (sample_size * channels);
-        uint8_t* in_stream = stream;
-        uint8_t* out_stream = stream;
+    /**
+     * @brief Process the planar block by the shared tanks
+     *
+     * All channels are downmixed into one or two models, and the wet output
+     * gets spread over speakers by the matrix. Costs one or two models in
+     * place of one per channel pair, and the tail stays the same everywhere.
+     */
+    template<int CH>
+    void processSurround(float *const *in_planes, float *const *out_planes, int frames)
+    {
+        const int chans = CH ? CH : channels;
+        const float dry = surroundDry;
 
-        for(int i = 0; i < channels; i += 2)
+        if(workers.active())
+        {
+            jobFrames = frames;
+            workers.run();
+        }
+        else
         {
-            if(inBuffer[i].size() < size_t(frames))
-                inBuffer[i].resize(frames);
-            if(inBuffer[i + 1].size() < size_t(frames))
-                inBuffer[i + 1].resize(frames);
-            if(outBuffer[i].size() < size_t(frames))
-                outBuffer[i].resize(frames);
-            if(outBuffer[i + 1].size() < size_t(frames))
-                outBuffer[i + 1].resize(frames);
+            for(int t = 0; t < models; ++t)
+                runTank<CH>(in_planes, t, frames);
         }
 
-        for(int i = 0; i < frames; ++i)
+        for(int c = 0; c < chans; ++c)
         {
-            for(int c = 0; c < channels; ++c)
+            const float *x = in_planes[c];
+            float *y = out_planes[c];
+
+            for(int p = 0; p < frames; ++p)
+                y[p] = x[p] * dry;
+
+            for(int k = 0; k < models * 2; ++k)
+            {
+                const float g = surroundWet[c][k];
+                const float *w = tankOut[k];
+
+                if(g == 0.0f)
+                    continue;
+
+                for(int p = 0; p < frames; ++p)
+                    y[p] += w[p] * g;
+            }
+        }
+    }
+
+    //! Downmix the block into the tank and run it, the wet output goes to its pair of tankOut planes
+    template<int CH>
+    void runTank(const float *const *in_planes, int t, int frames)
+    {
+        const int chans = CH ? CH : channels;
+        float *mono = tankIn[t];
+
+        memset(mono, 0, sizeof(float) * frames);
+        for(int c = 0; c < chans; ++c)
+        {
+            const float g = surroundSend[t][c];
+            const float *x = in_planes[c];
+
+            if(g == 0.0f)
+                continue;
+
+            for(int p = 0; p < frames; ++p)
+                mono[p] += x[p] * g;
+        }
+
+        if(useFdn)
+            fdn[t].processwet(mono, tankOut[t * 2], tankOut[t * 2 + 1], frames);
+        else
+            rev[t].processwet(mono, tankOut[t * 2], tankOut[t * 2 + 1], frames);
+    }
+
+    //! Same as processFrames() by the fixed-point models
+    template<int CH>
+    void processFixed(int32_t *const *in_planes, int32_t *const *out_planes, int frames)
+    {
+        const int chans = CH ? CH : channels;
+
+        if(chans % 2 == 1) // Mono to Stereo
+            memcpy(in_planes[chans], in_planes[chans - 1], sizeof(int32_t) * frames);
+
+        if(workers.active())
+        {
+            jobFrames = frames;
+            workers.run();
+        }
+        else
+        {
+            for(int i = 0; i < chans; i += 2)
             {
-                inBuffer[c][i] = readSample(in_stream, c);
-                if(channels % 2 == 1 && c == channels - 1) // Mono to Stereo
-                    inBuffer[c + 1][i] = inBuffer[c][i];
+                fixedRev[i / 2].processreplace(in_planes[i], in_planes[i + 1],
+                                               out_planes[i], out_planes[i + 1], frames);
             }
+        }
 
-            in_stream += sample_size * channels;
+        if(chans % 2 == 1) // Stereo to Mono
+        {
+            int32_t *l = out_planes[chans - 1];
+            const int32_t *r = out_planes[chans];
+            for(int p = 0; p < frames; ++p)
+                l[p] = (l[p] + r[p]) >> 1;
         }
+    }
+
+    void process(uint8_t* stream, int len)
+    {
+        if(!isValid)
+            return; // Do nothing
 
-        for(int i = 0; i < channels; i += 2)
+        acquireSetup();
+
+        const int frame_size = (useFixed ? fixedCodec.sample_size : codec.sample_size) * channels;
+        int frames = len / frame_size;
+
+        // Never allocates here, chunks bigger than the config are processed by slices
+        while(frames > 0)
         {
-            auto &c = rev[i / 2];
-            c.processreplace(inBuffer[i].data(), inBuffer[i + 1].data(),
-                             outBuffer[i].data(), outBuffer[i + 1].data(), frames, 1);
+            int todo = frames > m_config.maxFrames ? m_config.maxFrames : frames;
+
+            if(useFixed)
+            {
+                fixedCodec.decode(stream, fixedIn, todo);
+                (this->*processFixedCB)(fixedIn, fixedOut, todo);
+                fixedCodec.encode(stream, fixedOut, todo);
+            }
+            else
+            {
+                codec.decode(stream, inPlanes, todo);
+                (this->*processFramesCB)(inPlanes, outPlanes, todo);
+                codec.encode(stream, outPlanes, todo);
+            }
+
+            stream += todo * frame_size;
+            frames -= todo;
         }
+    }
+
+    /**
+     * @brief Process float planes in place, the fixed-point path doesn't take them
+     *
+     * Models take the caller's planes as they are. Only workers and the odd
+     * channel pair need the own planes, the slice gets copied through them then
+     */
+    void processPlanes(float *const *planes, int frames)
+    {
+        if(!isValid || useFixed)
+            return; // Do nothing
 
-        for(int p = 0; p < frames; ++p)
+        acquireSetup();
+
+        const bool direct = channels % 2 == 0 && !workers.active();
+        float *slice[MAX_CHANNELS];
+
+        for(int offset = 0; offset < frames; offset += m_config.maxFrames)
         {
-            for(int w = 0; w < channels; ++w)
+            const int todo = frames - offset > m_config.maxFrames ? m_config.maxFrames : frames - offset;
+
+            if(direct)
             {
-                if(channels % 2 == 1 && w == channels - 1) // Stereo to Mono
-                    outBuffer[w][p] = (outBuffer[w][p] + outBuffer[w + 1][p]) / 2.0f;
+                for(int c = 0; c < channels; ++c)
+                    slice[c] = planes[c] + offset;
 
-                writeSample(&out_stream, outBuffer[w][p]);
+                (this->*processFramesCB)(slice, slice, todo);
+                continue;
             }
+
+            for(int c = 0; c < channels; ++c)
+                memcpy(inPlanes[c], planes[c] + offset, sizeof(float) * todo);
+
+            (this->*processFramesCB)(inPlanes, outPlanes, todo);
+
+            for(int c = 0; c < channels; ++c)
+                memcpy(planes[c] + offset, outPlanes[c], sizeof(float) * todo);
         }
     }
 } FxReverb;
 
 
 FxReverb* reverbEffectInit(int rate, uint16_t format, int channels)
+{
+    return reverbEffectInitEx(rate, format, channels, nullptr);
+}
+
+FxReverb* reverbEffectInitEx(int rate, uint16_t format, int channels, const ReverbConfig *config)
 {
     FxReverb* out = new FxReverb();
-    out->init(rate, format, channels);
+    fxSimdInit();
+    if(out->init(rate, format, channels, config ? *config : ReverbConfig()) < 0)
+    {
+        reverbEffectFree(out);
+        return nullptr;
+    }
     return out;
 }
 
@@ -771,13 +2160,20 @@ void reverbEffect(int, void* stream, int len, void* context)
     out->process((uint8_t*)stream, len);
 }
 
+void reverbEffectPlanar(void *context, float *const *planes, int frames)
+{
+    FxReverb* out = reinterpret_cast<FxReverb*>(context);
+
+    if(!out)
+        return; // Effect doesn't working
+
+    out->processPlanes(planes, frames);
+}
+
 void reverbUpdateSetup(FxReverb* context, const ReverbSetup& setup)
 {
     if(context)
-    {
-        context->setSettings(setup);
         context->updateSetup(setup);
-    }
 }
 
 void reverbGetSetup(FxReverb *context, ReverbSetup &setup)
@@ -821,3 +2217,128 @@ void reverbUpdateWidth(FxReverb *context, float width)
     if(context)
         context->setWidth(width);
 }
+
+void reverbEffectSetDither(FxReverb *context, int mode)
+{
+    if(context)
+        context->codec.setDither(mode);
+}
+
+
+//! Fields of the ReverbSetup by ReverbParam
+static const FxEffectParam reverb_params[] =
+{
+    {REVERB_PARAM_MODE,         "mode",         0.0f,   1.0f,   0.0f},
+    {REVERB_PARAM_ROOM_SIZE,    "room-size",    0.0f,   1.0f,   0.7f},
+    {REVERB_PARAM_DAMPING,      "damping",      0.0f,   1.0f,   0.5f},
+    {REVERB_PARAM_WET_LEVEL,    "wet-level",    0.0f,   1.0f,   0.2f},
+    {REVERB_PARAM_DRY_LEVEL,    "dry-level",    0.0f,   1.0f,   0.4f},
+    {REVERB_PARAM_WIDTH,        "width",        0.0f,   1.0f,   1.0f}
+};
+
+static void *reverbClassCreate(int rate, int channels)
+{
+    return reverbEffectInit(rate, FX_AUDIO_F32SYS, channels);
+}
+
+static void reverbClassDestroy(void *effect)
+{
+    reverbEffectFree(reinterpret_cast<FxReverb*>(effect));
+}
+
+static void reverbClassReset(void *effect)
+{
+    FxReverb *out = reinterpret_cast<FxReverb*>(effect);
+    if(out)
+        out->reset();
+}
+
+static int reverbClassSetParam(void *effect, int id, float value)
+{
+    FxReverb *out = reinterpret_cast<FxReverb*>(effect);
+
+    if(!out)
+        return -1;
+
+    switch(id)
+    {
+    case REVERB_PARAM_MODE:
+        out->setMode(value);
+        break;
+    case REVERB_PARAM_ROOM_SIZE:
+        out->setRoomSize(value);
+        break;
+    case REVERB_PARAM_DAMPING:
+        out->setDamping(value);
+        break;
+    case REVERB_PARAM_WET_LEVEL:
+        out->setWetLevel(value);
+        break;
+    case REVERB_PARAM_DRY_LEVEL:
+        out->setDryLevel(value);
+        break;
+    case REVERB_PARAM_WIDTH:
+        out->setWidth(value);
+        break;
+    default:
+        return -1;
+    }
+
+    return 0;
+}
+
+static float reverbClassGetParam(void *effect, int id)
+{
+    FxReverb *out = reinterpret_cast<FxReverb*>(effect);
+
+    if(!out)
+        return 0.0f;
+
+    switch(id)
+    {
+    case REVERB_PARAM_MODE:
+        return out->m_setup.mode;
+    case REVERB_PARAM_ROOM_SIZE:
+        return out->m_setup.roomSize;
+    case REVERB_PARAM_DAMPING:
+        return out->m_setup.damping;
+    case REVERB_PARAM_WET_LEVEL:
+        return out->m_setup.wetLevel;
+    case REVERB_PARAM_DRY_LEVEL:
+        return out->m_setup.dryLevel;
+    case REVERB_PARAM_WIDTH:
+        return out->m_setup.width;
+    }
+
+    return 0.0f;
+}
+
+static int reverbClassLatency(void *)
+{
+    return 0;
+}
+
+static int reverbClassTailLength(void *effect)
+{
+    FxReverb *out = reinterpret_cast<FxReverb*>(effect);
+    if(!out || !out->isValid)
+        return 0;
+    return out->tailLength();
+}
+
+const FxEffectClass reverbEffectClass =
+{
+    "reverb",
+    "Reverb",
+    reverb_params,
+    (int)(sizeof(reverb_params) / sizeof(reverb_params[0])),
+    reverbClassCreate,
+    reverbClassDestroy,
+    reverbEffectPlanar,
+    reverbClassReset,
+    reverbClassSetParam,
+    reverbClassGetParam,
+    reverbClassLatency,
+    reverbClassTailLength,
+    0
+};
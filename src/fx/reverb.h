@@ -32,6 +32,7 @@ extern "C" {
 #endif
 
 #include "fx_format.h"
+#include "fx_effect.h"
 
 typedef struct FxReverb FxReverb;
 
@@ -45,11 +46,75 @@ typedef struct ReverbSetup
     float width        = 1.0f; // 0.0...1.0
 } ReverbSetup;
 
+/* Reverb of more than two channels */
+typedef enum ReverbSurroundMode
+{
+    REVERB_SURROUND_PAIRS = 0,  /**< Separate stereo model per channel pair, the odd channel gets a fake pair */
+    REVERB_SURROUND_STEREO,     /**< All channels are downmixed into one stereo tank */
+    REVERB_SURROUND_QUAD        /**< Front and rear tanks of different tunings, decorrelated between speakers */
+} ReverbSurroundMode;
+
+/* Algorithm of the reverb tail */
+typedef enum ReverbEngine
+{
+    REVERB_ENGINE_FREEVERB = 0, /**< Schroeder-Moorer model of 8 parallel combs and 4 allpasses */
+    REVERB_ENGINE_FDN           /**< 8-line feedback delay network, denser tail at a half of the cost */
+} ReverbEngine;
+
+/* Storage of the delay lines, the math runs on floats anyway */
+typedef enum ReverbLineFormat
+{
+    REVERB_LINES_FLOAT = 0, /**< 32-bit floats */
+    REVERB_LINES_S16,       /**< 16-bit integers with headroom, very quiet tails fade out into the rounding sooner */
+    REVERB_LINES_HALF       /**< IEEE half floats, the same 11-bit precision at every level */
+} ReverbLineFormat;
+
+// Options fixed for the lifetime of the effect
+typedef struct ReverbConfig
+{
+    // Biggest chunk processed at once, like the audio_buffers given to Mix_OpenAudio().
+    // Scratch buffers get allocated once by this size, bigger chunks are processed by slices
+    int maxFrames       = 4096;
+    // One of ReverbSurroundMode, has no effect on mono, stereo and more than 8 channels
+    int surround        = REVERB_SURROUND_PAIRS;
+    // Run S16 streams through the fixed-point model, always on for the integer-only builds.
+    // Only the pairs surround mode is available then
+    int fixedPoint      = 0;
+    // One of ReverbEngine. The fixed-point model is always the FreeVerb one
+    int engine          = REVERB_ENGINE_FREEVERB;
+    // Worker threads sharing the models of more than two channels with the audio thread,
+    // 0 keeps everything at the audio thread. Channel pairs don't use the SIMD bank then
+    int threads         = 0;
+    // One of ReverbLineFormat. 16-bit lines take a half of the memory and of the cache traffic,
+    // channel pairs don't use the SIMD bank then. The fixed-point model has 16-bit combs anyway
+    int lines           = REVERB_LINES_FLOAT;
+} ReverbConfig;
+
+/* Returns NULL if the format, the rate or the number of channels isn't supported */
 extern FxReverb *reverbEffectInit(int rate, uint16_t format, int channels);
+extern FxReverb *reverbEffectInitEx(int rate, uint16_t format, int channels, const ReverbConfig *config);
 extern void reverbEffectFree(FxReverb *context);
 
 extern void reverbEffect(int chan, void *stream, int len, void *context);
+/* Planes of float samples processed in place, the FxChainProcessCB of fx_chain.h.
+   The reverb must be created with AUDIO_F32SYS, the fixed-point model doesn't take them */
+extern void reverbEffectPlanar(void *context, float *const *planes, int frames);
+
+// Parameters of the reverbEffectClass, see fx_effect.h. The same as fields of the ReverbSetup
+typedef enum ReverbParam
+{
+    REVERB_PARAM_MODE = 0,
+    REVERB_PARAM_ROOM_SIZE,
+    REVERB_PARAM_DAMPING,
+    REVERB_PARAM_WET_LEVEL,
+    REVERB_PARAM_DRY_LEVEL,
+    REVERB_PARAM_WIDTH
+} ReverbParam;
+
+extern const FxEffectClass reverbEffectClass;
 
+// Setters are safe to call from one control thread while the effect is running,
+// the audio thread applies the setup at the start of the next block.
 // Update all setup at once
 extern void reverbUpdateSetup(FxReverb *context, const ReverbSetup &setup);
 extern void reverbGetSetup(FxReverb *context, ReverbSetup &setup);
@@ -62,6 +127,9 @@ extern void reverbUpdateWetLevel(FxReverb *context, float wet);
 extern void reverbUpdateDryLevel(FxReverb *context, float dry);
 extern void reverbUpdateWidth(FxReverb *context, float width);
 
+// Requantization of 8 and 16-bit outputs, one of FxDitherMode
+extern void reverbEffectSetDither(FxReverb *context, int mode);
+
 #ifdef __cplusplus
 }
 #endif
@@ -26,41 +26,24 @@
 #define INTEGER_ONLY_ECHO
 #endif
 
-#ifdef INTEGER_ONLY_ECHO
-#define EFFECT_FX_COMMON_INT16DST
-#endif
-
 #include <tgmath.h>
 #include <string.h>
+#include <stdlib.h>
+#include <vector>
+#include <atomic>
 #include "spc_echo.h"
 #include "fx_common.hpp"
-
-#ifdef INTEGER_ONLY_ECHO
-typedef int32_t spc_sample_t;
-#else
-typedef float spc_sample_t;
-#endif
-
-#ifdef INTEGER_ONLY_ECHO
-#define CLAMP16F( io )\
-{\
-    if ( (int16_t) io != io )\
-        io = (io >> 31) ^ 0x7FFF;\
-}
-#else
-#define CLAMP16F( io )\
-    {\
-        if(io < -1.f)\
-            io = -1.f;\
-        else if(io > 1.f)\
-            io = 1.f;\
-    }
-#endif
+#include "fx_resample.hpp"
+#include "fx_snapshot.hpp"
 
 #define ECHO_HIST_SIZE  8
 #define SDSP_RATE       32000
 #define MAX_CHANNELS    10
-#define ECHO_BUFFER_SIZE (32 * 1024 * MAX_CHANNELS)
+//! Frames decoded from the stream at once
+#define ECHO_BLOCK_FRAMES 256
+//! FIR input of one channel: the history followed by the run
+#define ECHO_HIST_STRIDE (ECHO_HIST_SIZE - 1 + ECHO_BLOCK_FRAMES)
+
 
 
 //// Global registers
@@ -92,29 +75,258 @@ typedef float spc_sample_t;
 //};
 
 
-typedef struct SpcEcho
+/*
+ * Sample math of the echo. The integer flavour works on 16-bit samples with
+ * the shifts of the S-DSP, the float one works on [-1, 1] samples.
+ */
+template<typename Sample>
+struct EchoMath;
+
+template<>
+struct EchoMath<int32_t>
 {
-    int is_valid = 0;
+    //! Samples going into the delay memory are clamped to 16 bits already
+    typedef int16_t Line;
 
-    spc_sample_t echo_ram[ECHO_BUFFER_SIZE];
+    static inline int32_t clamp(int32_t v)
+    {
+        if((int16_t)v != v)
+            v = (v >> 31) ^ 0x7FFF;
+        return v;
+    }
 
-    // Echo history keeps most recent 8 samples (twice the size to simplify wrap handling)
-    spc_sample_t echo_hist[ECHO_HIST_SIZE * 2 * MAX_CHANNELS][MAX_CHANNELS];
-    spc_sample_t (*echo_hist_pos)[MAX_CHANNELS] = echo_hist; // &echo_hist [0 to 7]
+    static inline void fir(const int32_t *x, int32_t *y, int n, const int32_t *coef)
+    {
+        for(int i = 0; i < n; ++i)
+        {
+            int32_t acc = x[i + 7] * coef[7];
+            for(int f = 0; f <= 6; ++f)
+                acc += x[i + f] * coef[f];
+            y[i] = acc;
+        }
+    }
 
-    //! offset from ESA in echo buffer
-    int echo_offset = 0;
-    //! number of bytes that echo_offset will stop at
-    int echo_length = 0;
+    static inline void feed(int32_t *d, const int32_t *in, const int32_t *wet, int n, int32_t eon, int32_t efb)
+    {
+        for(int i = 0; i < n; ++i)
+            d[i] = clamp(((in[i] * 128 * eon) >> 7) + ((wet[i] * efb) >> 14));
+    }
 
-    double  rate_factor = 1.0;
-    int     rate = SDSP_RATE;
-    int     channels = 2;
+    static inline void mix(int32_t *io, const int32_t *wet, int n, int32_t mvol, int32_t evol)
+    {
+        for(int i = 0; i < n; ++i)
+            io[i] = clamp((io[i] * 128 * mvol + wet[i] * evol) >> 14);
+    }
+
+    //! Echo part of the output
+    static inline int32_t echo(int32_t wet, int32_t evol)
+    {
+        return (wet * evol) >> 14;
+    }
+
+    //! Bank voice with no input gets released once its echo stays below 8 LSB, the feedback may keep cycling below it forever
+    static inline int32_t silence()
+    {
+        return 8;
+    }
+};
+
+template<>
+struct EchoMath<float>
+{
+    //! Full precision by default, see ECHO_FLAG_COMPACT_RAM
+    typedef float Line;
+
+    static inline float clamp(float v)
+    {
+        return fxClampF(v, -1.f, 1.f);
+    }
+
+    static inline void fir(const float *x, float *y, int n, const float *coef)
+    {
+        fxFir8Block(x, y, n, coef);
+    }
+
+    static inline void feed(float *d, const float *in, const float *wet, int n, float eon, float efb)
+    {
+        // (main / 128) + (echo * efb / 16384) with main = in * 128
+        fxMixBlock(d, in, wet, n, 16384 * eon, efb, 1.f / 16384, -1.f, 1.f);
+    }
+
+    static inline void mix(float *io, const float *wet, int n, float mvol, float evol)
+    {
+        fxMixBlock(io, io, wet, n, 128 * mvol, evol, 1.f / 16384, -1.f, 1.f);
+    }
+
+    static inline float echo(float wet, float evol)
+    {
+        return wet * evol * (1.f / 16384);
+    }
+
+    static inline float silence()
+    {
+        return 8.f / 32768;
+    }
+};
+
+/*
+ * Transfer between the FIR history of the Sample type and the delay memory
+ * of the Line type. Feedback is computed into the Sample buffer given by
+ * feedTo() and stored into the line by store(), the same type gets written
+ * in place.
+ */
+template<typename Sample, typename Line>
+struct EchoLine;
+
+template<typename Sample>
+struct EchoLine<Sample, Sample>
+{
+    static inline void load(const Sample *d, Sample *x, int n)
+    {
+        memcpy(x, d, n * sizeof(Sample));
+    }
+
+    static inline Sample *feedTo(Sample *d, Sample *)
+    {
+        return d;
+    }
+
+    static inline void store(Sample *, const Sample *, int)
+    {}
+};
+
+//! 16-bit memory of the integer math, the same as the S-DSP has
+template<>
+struct EchoLine<int32_t, int16_t>
+{
+    static inline void load(const int16_t *d, int32_t *x, int n)
+    {
+        for(int i = 0; i < n; ++i)
+            x[i] = d[i];
+    }
+
+    static inline int32_t *feedTo(int16_t *, int32_t *tmp)
+    {
+        return tmp;
+    }
+
+    static inline void store(int16_t *d, const int32_t *v, int n)
+    {
+        for(int i = 0; i < n; ++i)
+            d[i] = static_cast<int16_t>(v[i]);
+    }
+};
+
+//! 16-bit memory of the float math, the feedback is clamped to [-1, 1] already
+template<>
+struct EchoLine<float, int16_t>
+{
+    static inline void load(const int16_t *d, float *x, int n)
+    {
+        fxLineLoad(FX_LINE_S16, reinterpret_cast<const uint16_t*>(d), x, n, 32768.f);
+    }
+
+    static inline float *feedTo(int16_t *, float *tmp)
+    {
+        return tmp;
+    }
+
+    static inline void store(int16_t *d, const float *v, int n)
+    {
+        fxLineStore(FX_LINE_S16, reinterpret_cast<uint16_t*>(d), v, n, 32768.f);
+    }
+};
+
+/**
+ * @brief Should the stream be processed by the integer math
+ * @param format Audio format (one of AUDIO_*)
+ * @param flags Set of EchoFlags
+ *
+ * 16-bit streams go through the integer math unless ECHO_FLAG_FORCE_FLOAT is
+ * set, the INTEGER_ONLY_ECHO build has nothing else.
+ */
+static inline bool echoUseFixed(uint16_t format, int flags)
+{
 #ifdef INTEGER_ONLY_ECHO
-    uint16_t format = AUDIO_S16;
+    (void)format;
+    (void)flags;
+    return true;
 #else
-    uint16_t format = AUDIO_F32;
+    return (format == AUDIO_S16LSB || format == AUDIO_S16MSB) && !(flags & ECHO_FLAG_FORCE_FLOAT);
 #endif
+}
+
+
+//! Delay memory shared by voices of the echo bank
+template<typename Sample>
+struct EchoPool
+{
+    std::vector<Sample> ram;
+    //! Free ranges as offset and size in samples, sorted by offset
+    std::vector<std::pair<size_t, size_t> > free_list;
+
+    void init(size_t size, int max_slices)
+    {
+        ram.assign(size, 0);
+        free_list.clear();
+        // Never grows beyond one hole between every two slices
+        free_list.reserve((size_t)max_slices + 2);
+        if(size > 0)
+            free_list.push_back(std::make_pair((size_t)0, size));
+    }
+
+    bool alloc(size_t size, size_t &offset)
+    {
+        for(size_t i = 0; i < free_list.size(); ++i)
+        {
+            if(free_list[i].second < size)
+                continue;
+
+            offset = free_list[i].first;
+            free_list[i].first += size;
+            free_list[i].second -= size;
+            if(free_list[i].second == 0)
+                free_list.erase(free_list.begin() + i);
+
+            memset(ram.data() + offset, 0, size * sizeof(Sample));
+            return true;
+        }
+
+        return false;
+    }
+
+    void release(size_t offset, size_t size)
+    {
+        size_t i = 0;
+
+        while(i < free_list.size() && free_list[i].first < offset)
+            ++i;
+
+        free_list.insert(free_list.begin() + i, std::make_pair(offset, size));
+
+        // Merge with the next and the previous holes
+        if(i + 1 < free_list.size() && free_list[i].first + free_list[i].second == free_list[i + 1].first)
+        {
+            free_list[i].second += free_list[i + 1].second;
+            free_list.erase(free_list.begin() + i + 1);
+        }
+
+        if(i > 0 && free_list[i - 1].first + free_list[i - 1].second == free_list[i].first)
+        {
+            free_list[i - 1].second += free_list[i].second;
+            free_list.erase(free_list.begin() + i);
+        }
+    }
+};
+
+//! FIR Defaults: 80 FF 9A FF 67 FF 0F FF
+static const uint8_t echo_fir_initial[8] = {0x80, 0xFF, 0x9A, 0xFF, 0x67, 0xFF, 0x0F, 0xFF};
+
+//! Registers of one echo unit
+struct SpcEchoRegs
+{
+    //! Output rate divided by the S-DSP rate, delay and FIR get stretched by it
+    double  rate_factor = 1.0;
 
     //! Flags
     uint8_t reg_flg = 0;
@@ -130,17 +342,9 @@ typedef struct SpcEcho
     int8_t reg_evoll = 0;
     int8_t reg_evolr = 0;
 
-    //! FIR Defaults: 80 FF 9A FF 67 FF 0F FF
-    const uint8_t reg_fir_initial[8] = {0x80, 0xFF, 0x9A, 0xFF, 0x67, 0xFF, 0x0F, 0xFF};
     //! $xf rw FFCx - Echo FIR Filter Coefficient (FFC) X
     int8_t reg_fir[8] = {0, 0, 0, 0, 0, 0, 0, 0};
     int8_t reg_fir_resampled[8];
-
-    // Runtime buffers
-    spc_sample_t main_out[MAX_CHANNELS];
-    spc_sample_t echo_out[MAX_CHANNELS];
-    spc_sample_t echo_in[MAX_CHANNELS];
-
     void recomputeFirResampled()
     {
         const double y_factor1 = 1.0;
@@ -154,7 +358,7 @@ typedef struct SpcEcho
 
     void setDefaultFir()
     {
-        memcpy(reg_fir, reg_fir_initial, 8);
+        memcpy(reg_fir, echo_fir_initial, 8);
         recomputeFirResampled();
     }
 
@@ -177,177 +381,1407 @@ typedef struct SpcEcho
         reg_edl = 3;
     }
 
-    ReadSampleCB    readSample = nullptr;
-    WriteSampleCB   writeSample = nullptr;
-    int             sample_size = 2;
-
-    int init(int i_rate, uint16_t i_format, int i_channels)
+    /**
+     * @brief Length of the echo ring for the given EDL
+     * @param chans Number of channels
+     * @param edl Echo delay, 0...15
+     * @return Number of frames the echo_offset wraps at
+     */
+    int echoLength(int chans, int edl) const
     {
-        is_valid = 0;
-        rate = i_rate;
-        format = i_format;
-        channels = i_channels;
-        rate_factor = (double)i_rate / SDSP_RATE;
-
-#ifdef INTEGER_ONLY_ECHO
-        if (i_format != AUDIO_S16LSB && i_format != AUDIO_S16MSB)
-            return -1; /* Disallowed format */
-#endif
+        // Rounded as an interleaved length, the last frame may start right before its end
+        int samples = (int)round((((edl & 0x0F) * 0x400 * chans) / 2.0) * rate_factor);
+        int frames = (samples + chans - 1) / chans;
+        return frames > 0 ? frames : 1;
+    }
 
-        if(rate_factor > 50.0)
-            return -1; /* Too big scale factor */
+    //! Length of the echo ring for the current EDL
+    int echoLength(int chans) const
+    {
+        return echoLength(chans, reg_edl);
+    }
 
-        if(i_rate < 4000)
-            return -1; /* Too small sample rate */
+    /**
+     * @brief Write the register without the FIR recompute
+     */
+    void setReg(int key, int val)
+    {
+        switch(key)
+        {
+        case ECHO_EON:
+            reg_eon = (uint8_t)val;
+            break;
+        case ECHO_EDL:
+            reg_edl = (uint8_t)val;
+            break;
+        case ECHO_EFB:
+            reg_efb = (int8_t)val;
+            break;
+        case ECHO_MVOLL:
+            reg_mvoll = (int8_t)val;
+            break;
+        case ECHO_MVOLR:
+            reg_mvolr = (int8_t)val;
+            break;
+        case ECHO_EVOLL:
+            reg_evoll = (int8_t)val;
+            break;
+        case ECHO_EVOLR:
+            reg_evolr = (int8_t)val;
+            break;
+
+        case ECHO_FIR0:
+        case ECHO_FIR1:
+        case ECHO_FIR2:
+        case ECHO_FIR3:
+        case ECHO_FIR4:
+        case ECHO_FIR5:
+        case ECHO_FIR6:
+        case ECHO_FIR7:
+            reg_fir[key - ECHO_FIR0] = (int8_t)val;
+            break;
+        }
+    }
 
-        memset(echo_ram, 0, sizeof(echo_ram));
-        memset(echo_hist, 0, sizeof(echo_hist));
-        memset(reg_fir_resampled, 0, sizeof(reg_fir_resampled));
+    int getReg(int key) const
+    {
+        switch(key)
+        {
+        case ECHO_EON:
+            return reg_eon;
+        case ECHO_EDL:
+            return reg_edl;
+        case ECHO_EFB:
+            return reg_efb;
+        case ECHO_MVOLL:
+            return reg_mvoll;
+        case ECHO_MVOLR:
+            return reg_mvolr;
+        case ECHO_EVOLL:
+            return reg_evoll;
+        case ECHO_EVOLR:
+            return reg_evolr;
+
+        case ECHO_FIR0:
+            return reg_fir[0];
+        case ECHO_FIR1:
+            return reg_fir[1];
+        case ECHO_FIR2:
+            return reg_fir[2];
+        case ECHO_FIR3:
+            return reg_fir[3];
+        case ECHO_FIR4:
+            return reg_fir[4];
+        case ECHO_FIR5:
+            return reg_fir[5];
+        case ECHO_FIR6:
+            return reg_fir[6];
+        case ECHO_FIR7:
+            return reg_fir[7];
+        }
 
-        if(!initFormat(readSample, writeSample, sample_size, format))
-            return -1;
+        return 0;
+    }
 
-        setDefaultRegs();
+    /**
+     * @brief Write the set of registers with a single FIR recompute
+     * @param regs Values indexed by EchoSetup
+     * @param mask ECHO_REG_BIT() of every register to write
+     */
+    void setRegs(const int *regs, uint32_t mask)
+    {
+        for(int key = 0; key < ECHO_REGS_COUNT; ++key)
+        {
+            if(mask & ECHO_REG_BIT(key))
+                setReg(key, regs[key]);
+        }
 
-        is_valid = 1;
-        return 0;
+        if(mask & ECHO_REGS_FIR)
+            recomputeFirResampled();
     }
+};
 
-    void close()
+enum
+{
+    //! The control thread owns the spare
+    ECHO_SPARE_NONE = 0,
+    //! The audio thread may take the spare at the ring wrap
+    ECHO_SPARE_READY,
+    //! The spare holds the old delay memory the control thread frees
+    ECHO_SPARE_TAKEN,
+    //! The old delay memory is freed, the ring is at its biggest
+    ECHO_SPARE_DONE
+};
+
+//! Delay memory passed from the control thread to the audio thread, no allocation happens at the audio thread
+template<typename Line>
+struct EchoSpare
+{
+    std::vector<Line> ram;
+    //! Ring length the ram fits in frames
+    int length = 0;
+    std::atomic<int> state;
+
+    EchoSpare() : state(ECHO_SPARE_NONE)
     {}
 
-    void process(uint8_t *stream, int len)
+    void reset()
     {
-        int frames = len / (sample_size * channels);
-#ifdef INTEGER_ONLY_ECHO
-        int16_t *s_in = (int16_t*)stream;
-        int16_t *s_out = (int16_t*)stream;
-#endif
+        ram.clear();
+        length = 0;
+        state.store(ECHO_SPARE_NONE, std::memory_order_relaxed);
+    }
+};
+
+//! DSP state of one echo unit, registers are taken at the ring wrap
+template<typename Sample, typename Line = typename EchoMath<Sample>::Line>
+struct SpcEchoCore
+{
+    typedef EchoMath<Sample> Math;
+    typedef EchoLine<Sample, Line> Lines;
+
+    //! Planar delay memory, echo_stride frames per channel
+    Line *echo_ram = nullptr;
+    int echo_stride = 0;
+    //! Own delay memory, sized by the EDL at init, see growEchoRam()
+    std::vector<Line> echo_own;
+    //! Bigger own delay memory made by the control thread
+    EchoSpare<Line> *spare = nullptr;
+    //! Shared delay memory, echo_ram points into it when set
+    EchoPool<Line> *pool = nullptr;
+    size_t pool_offset = 0;
+
+    //! FIR input per channel: 7 most recent delay samples followed by the current run
+    std::vector<Sample> echo_hist;
+
+    //! offset from ESA in echo buffer, in frames
+    int echo_offset = 0;
+    //! number of frames that echo_offset will stop at
+    int echo_length = 0;
 
-        int c;
-        spc_sample_t ov;
+    int     channels = 2;
 
-        int f, e_offset;
-        spc_sample_t v;
+    //! Registers latched at the ring wrap, changes made in the middle take effect at the next wrap
+    struct EchoLatch
+    {
+        uint8_t flg = 0;
+        //! 1 if the input feeds the delay line, 0 if not
+        Sample  eon = 0;
+        Sample  efb = 0;
+        Sample  mvol[2] = {0, 0};
+        Sample  evol[2] = {0, 0};
+        Sample  fir[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    } latch;
+
+    //! FIR output of the current run
+    Sample echo_in[ECHO_BLOCK_FRAMES];
+
+    /**
+     * @brief Control thread: allocate the own delay memory before the audio thread runs
+     * @param length Ring length in frames
+     */
+    void allocEchoRam(int length)
+    {
+        echo_own.assign((size_t)length * channels, 0);
+        echo_ram = echo_own.data();
+        echo_stride = length;
+    }
 
-        spc_sample_t mvoll[2] = {(spc_sample_t)reg_mvoll, (spc_sample_t)reg_mvolr};
-        spc_sample_t evoll[2] = {(spc_sample_t)reg_evoll, (spc_sample_t)reg_evolr};
+    /**
+     * @brief Control thread: prepare the own delay memory for the ring before its EDL gets published
+     * @param length Ring length in frames
+     * @param max_length Ring length of the EDL 15, allocated at once to need one handoff only
+     */
+    void growEchoRam(int length, int max_length)
+    {
+        if(!spare)
+            return;
 
-        spc_sample_t (*echohist_pos)[MAX_CHANNELS];
-        spc_sample_t *echo_ptr;
+        int state = spare->state.load(std::memory_order_acquire);
 
-        memset(main_out, 0, sizeof(main_out));
-        memset(echo_out, 0, sizeof(echo_out));
-        memset(echo_in, 0, sizeof(echo_in));
+        if(state == ECHO_SPARE_TAKEN)
+        {
+            // Holds the old delay memory given back by the audio thread
+            std::vector<Line>().swap(spare->ram);
+            spare->state.store(ECHO_SPARE_DONE, std::memory_order_relaxed);
+            return;
+        }
 
-        if(!is_valid)
+        if(state != ECHO_SPARE_NONE || length <= (int)(echo_own.size() / channels))
             return;
 
-        do
+        spare->ram.assign((size_t)max_length * channels, 0);
+        spare->length = max_length;
+        spare->state.store(ECHO_SPARE_READY, std::memory_order_release);
+    }
+
+    /**
+     * @brief Audio thread: grow the delay memory to fit the ring, never shrinks and never allocates
+     * @param length Ring length in frames
+     * @return false if there is no room for the ring
+     */
+    bool reserveEchoRam(int length)
+    {
+        Line *ram;
+        size_t offset = 0;
+
+        if(echo_stride >= length)
+            return true;
+
+        if(pool)
         {
-#ifdef INTEGER_ONLY_ECHO
-            for(c = 0; c < channels; ++c)
-                main_out[c] = *(s_in++) * 128;
-#else
-            for(c = 0; c < channels; ++c)
-                main_out[c] = readSample(stream, c) * 128;
-#endif
+            if(!pool->alloc((size_t)length * channels, offset))
+                return false;
+            ram = pool->ram.data() + offset;
+        }
+        else
+        {
+            if(!spare || spare->state.load(std::memory_order_acquire) != ECHO_SPARE_READY || spare->length < length)
+                return false;
+
+            for(int c = 0; c < channels && echo_stride > 0; ++c)
+                memcpy(spare->ram.data() + (size_t)c * spare->length, echo_ram + (size_t)c * echo_stride,
+                       echo_stride * sizeof(Line));
+            echo_own.swap(spare->ram);
+            echo_ram = echo_own.data();
+            echo_stride = spare->length;
+            spare->state.store(ECHO_SPARE_TAKEN, std::memory_order_release);
+            return true;
+        }
 
-            if(reg_eon & 1)
-            {
-                for(c = 0; c < channels; c++)
-                    echo_out[c] = main_out[c];
-            }
+        for(int c = 0; c < channels && echo_stride > 0; ++c)
+            memcpy(ram + (size_t)c * length, echo_ram + (size_t)c * echo_stride,
+                   echo_stride * sizeof(Line));
+
+        releaseEchoRam();
+        echo_ram = ram;
+        echo_stride = length;
+        pool_offset = offset;
+        return true;
+    }
+
+    //! Give the delay memory back to the pool
+    void releaseEchoRam()
+    {
+        if(pool && echo_stride > 0)
+            pool->release(pool_offset, (size_t)echo_stride * channels);
+
+        if(pool)
+        {
+            echo_ram = nullptr;
+            echo_stride = 0;
+        }
+    }
+
+    //! Clear the history and restart the ring
+    void resetState()
+    {
+        echo_offset = 0;
+        echo_length = 0;
+        std::fill(echo_hist.begin(), echo_hist.end(), 0);
+    }
+
+    /**
+     * @brief Set up the core
+     * @param i_channels Number of channels
+     * @param i_pool Shared delay memory, or nullptr to own one
+     */
+    void initCore(int i_channels, EchoPool<Line> *i_pool)
+    {
+        releaseEchoRam();
+        channels = i_channels;
+        pool = i_pool;
+        echo_own.clear();
+        echo_ram = nullptr;
+        echo_stride = 0;
+        echo_hist.assign((size_t)channels * ECHO_HIST_STRIDE, 0);
+        resetState();
+    }
+
+    /**
+     * @brief Take the snapshot of registers and the ring length at the wrap of the echo_offset
+     * @param regs Registers to take
+     * @param chans Number of channels
+     * @return false if there is no delay memory to run
+     */
+    bool latchRegs(const SpcEchoRegs &regs, int chans)
+    {
+        latch.flg = regs.reg_flg;
+        latch.eon = (Sample)(regs.reg_eon & 1);
+        latch.efb = (Sample)regs.reg_efb;
+        latch.mvol[0] = (Sample)regs.reg_mvoll;
+        latch.mvol[1] = (Sample)regs.reg_mvolr;
+        latch.evol[0] = (Sample)regs.reg_evoll;
+        latch.evol[1] = (Sample)regs.reg_evolr;
+        for(int i = 0; i < 8; ++i)
+            latch.fir[i] = (Sample)regs.reg_fir_resampled[i];
+
+        echo_length = regs.echoLength(chans);
+        if(!reserveEchoRam(echo_length))
+            echo_length = echo_stride; // No room yet, keep the ring it has
+
+        return echo_length > 0;
+    }
+
+    /**
+     * @brief Echo core of one channel for the run that doesn't cross the ring wrap
+     * @param c Channel index
+     * @param in Input samples
+     * @param wet Output of the FIR filter
+     * @param n Number of frames, not bigger than the ECHO_BLOCK_FRAMES
+     *
+     * Every frame of the run reads the delay line before it gets written by
+     * the feedback of the same run, so each stage is done for the whole run at once.
+     */
+    void coreRun(int c, const Sample *in, Sample *wet, int n)
+    {
+        Sample *x = echo_hist.data() + (size_t)c * ECHO_HIST_STRIDE;
+        Line *d = echo_ram + (size_t)c * echo_stride + echo_offset;
 
-            e_offset = echo_offset;
-            echo_ptr = echo_ram + echo_offset;
+        Lines::load(d, x + ECHO_HIST_SIZE - 1, n);
 
-            if(!echo_offset)
-                echo_length = (int)round((((reg_edl & 0x0F) * 0x400 * channels) / 2.0) * rate_factor);
-            e_offset += channels;
-            if(e_offset >= echo_length)
-                e_offset = 0;
-            echo_offset = e_offset;
+        /* --------------- FIR filter-------------- */
+        Math::fir(x, wet, n, latch.fir);
+        memmove(x, x + n, (ECHO_HIST_SIZE - 1) * sizeof(Sample));
+        /* ---------------------------------------- */
 
-            /* FIR */
-            for(c = 0; c < channels; c++)
-                echo_in[c] = echo_ptr[c];
+        /* Echo out, the run part of the history is free until the next load */
+        if(!(latch.flg & 0x20))
+        {
+            Sample *f = Lines::feedTo(d, x + ECHO_HIST_SIZE - 1);
+            Math::feed(f, in, wet, n, latch.eon, latch.efb);
+            Lines::store(d, f, n);
+        }
+    }
 
-            echohist_pos = echo_hist_pos;
-            if(++echohist_pos >= &echo_hist[ECHO_HIST_SIZE])
-                echohist_pos = echo_hist;
-            echo_hist_pos = echohist_pos;
+    /**
+     * @brief Mix the dry and wet signals of one channel
+     * @param c Channel index
+     * @param io Input samples, get replaced with the output
+     * @param wet Output of the FIR filter
+     * @param n Number of frames
+     */
+    void mixRun(int c, Sample *io, const Sample *wet, int n)
+    {
+        /* Sound out */
+        if((latch.flg & 0x40))
+        {
+            memset(io, 0, n * sizeof(Sample));
+            return;
+        }
 
-            /* --------------- FIR filter-------------- */
-            for(c = 0; c < channels; c++)
-                echohist_pos[0][c] = echohist_pos[8][c] = echo_in[c];
+        Math::mix(io, wet, n, latch.mvol[c & 1], latch.evol[c & 1]);
+    }
 
-            for(c = 0; c < channels; ++c)
-                echo_in[c] *= reg_fir_resampled[7];
+    /**
+     * @brief Run the echo core over planar buffers
+     * @param regs Registers to latch at the ring wrap
+     * @param in Input planes, get replaced with the output when Mix is set
+     * @param wet Planes for the output of the FIR filter, unused when Mix is set
+     * @param frames Number of frames, not bigger than the ECHO_BLOCK_FRAMES
+     *
+     * The buffers are split into runs that end at the ring wrap, registers and
+     * the ring length are latched at the wrap like the hardware does with EDL.
+     * CH is the compile-time number of channels (or 0 to use the runtime value)
+     */
+    template<int CH, bool Mix>
+    void processRuns(const SpcEchoRegs &regs, Sample *const *in, Sample *const *wet, int frames)
+    {
+        const int chans = CH ? CH : channels;
+        int i = 0, n;
 
-            for(f = 0; f <= 6; ++f)
+        while(i < frames)
+        {
+            if(!echo_offset && !latchRegs(regs, chans))
             {
-                for(c = 0; c < channels; ++c)
-                    echo_in[c] += echo_hist_pos[f + 1][c] * reg_fir_resampled[f];
+                // No delay memory, nothing to echo
+                for(int c = 0; c < chans && !Mix; ++c)
+                    memset(wet[c] + i, 0, (frames - i) * sizeof(Sample));
+                return;
             }
-            /* ---------------------------------------- */
 
-            /* Echo out */
-            if(!(reg_flg & 0x20))
+            n = echo_length - echo_offset;
+            if(n > frames - i)
+                n = frames - i;
+
+            for(int c = 0; c < chans; ++c)
             {
-                for(c = 0; c < channels; c++)
+                if(Mix)
                 {
-#ifdef INTEGER_ONLY_ECHO
-                    v = (echo_out[c] >> 7) + ((echo_in[c] * reg_efb) >> 14);
-#else
-                    v = (echo_out[c] / 128) + ((echo_in[c] * reg_efb) / 16384.f);
-#endif
-                    CLAMP16F(v);
-                    echo_ptr[c] = v;
+                    coreRun(c, in[c] + i, echo_in, n);
+                    mixRun(c, in[c] + i, echo_in, n);
                 }
+                else
+                    coreRun(c, in[c] + i, wet[c] + i, n);
             }
 
-            /* Sound out */
-            for(c = 0; c < channels; c++)
-            {
-#ifdef INTEGER_ONLY_ECHO
-                ov = (main_out[c] * mvoll[c % 2] + echo_in[c] * evoll[c % 2]) >> 14;
-#else
-                ov = (main_out[c] * mvoll[c % 2] + echo_in[c] * evoll[c % 2]) / 16384;
-#endif
-                CLAMP16F(ov);
-                if((reg_flg & 0x40))
-                    ov = 0;
-
-#ifdef INTEGER_ONLY_ECHO
-                *(s_out++) = ov;
-#else
-                writeSample(&stream, ov);
-#endif
-            }
+            echo_offset += n;
+            if(echo_offset >= echo_length)
+                echo_offset = 0;
+            i += n;
         }
-        while(--frames);
     }
-} SpcEcho;
-
-
-SpcEcho *echoEffectInit(int rate, uint16_t format, int channels)
-{
-    SpcEcho *out = new SpcEcho();
-    out->init(rate, format, channels);
-    return out;
-}
+};
 
-void echoEffectFree(SpcEcho *context)
+//! Stream processing of SpcEcho in the given sample type
+template<typename Sample, typename Line = typename EchoMath<Sample>::Line>
+struct SpcEchoUnit
 {
-    if(context)
+    SpcEchoCore<Sample, Line> core;
+    //! Delay memory the core grows to by the bigger EDL
+    EchoSpare<Line> spare;
+    //! Registers of the owning SpcEcho
+    const SpcEchoRegs *regs = nullptr;
+    int channels = 2;
+
+    //! Planar copy of the currently processing part of the stream
+    Sample block[MAX_CHANNELS][ECHO_BLOCK_FRAMES];
+    //! Frames of the stream processed at once
+    int block_frames = ECHO_BLOCK_FRAMES;
+
+    //! Echo core runs at the S-DSP rate and gets resampled, see ECHO_FLAG_NATIVE_RATE
+    bool native = false;
+    FxResampler<Sample> native_down;
+    FxResampler<Sample> native_up;
+    //! Input and wet signal at the S-DSP rate, and the wet signal at the output rate
+    std::vector<Sample> native_buf;
+
+    FxCodec<Sample> codec;
+
+    //! DSP kernel instantiated for the current number of channels
+    void (SpcEchoUnit::*processFramesCB)(Sample *const *planes, int frames) = nullptr;
+
+    template<int CH>
+    void setKernel()
     {
-        context->close();
-        delete context;
+        if(native)
+            processFramesCB = &SpcEchoUnit::processFramesNative<CH>;
+        else
+            processFramesCB = &SpcEchoUnit::processFrames<CH>;
     }
-}
 
-void spcEchoEffect(int, void *stream, int len, void *context)
+    /**
+     * @brief Set up the processing
+     * @param i_regs Registers to take
+     * @param rate Output sample rate
+     * @param format Audio format (one of AUDIO_*)
+     * @param i_channels Number of channels
+     * @param i_native Run the core at the S-DSP rate
+     * @return true on success
+     */
+    bool init(const SpcEchoRegs *i_regs, int rate, uint16_t format, int i_channels, bool i_native)
+    {
+        regs = i_regs;
+        channels = i_channels;
+        native = i_native;
+        block_frames = ECHO_BLOCK_FRAMES;
+        native_buf.clear();
+
+        if(native)
+        {
+            // Keep the upsampled core input within the block
+            if(rate < SDSP_RATE)
+                block_frames = (ECHO_BLOCK_FRAMES - 2) * rate / SDSP_RATE;
+            native_down.init(rate, SDSP_RATE, channels, block_frames);
+            native_up.init(SDSP_RATE, rate, channels, ECHO_BLOCK_FRAMES);
+            native_buf.resize((size_t)3 * channels * ECHO_BLOCK_FRAMES, 0);
+        }
+
+        core.initCore(channels, nullptr);
+        core.allocEchoRam(regs->echoLength(channels));
+        spare.reset();
+        core.spare = &spare;
+
+        if(!codec.init(format, channels))
+            return false;
+
+        switch(channels)
+        {
+        case 1:
+            setKernel<1>();
+            break;
+        case 2:
+            setKernel<2>();
+            break;
+        case 6:
+            setKernel<6>();
+            break;
+        case 8:
+            setKernel<8>();
+            break;
+        default:
+            setKernel<0>();
+            break;
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Process the planar block at the output rate
+     * @param planes Planes of the block, processed in place
+     * @param frames Number of frames in the block, not bigger than the block_frames
+     */
+    template<int CH>
+    void processFrames(Sample *const *planes, int frames)
+    {
+        core.template processRuns<CH, true>(*regs, planes, nullptr, frames);
+    }
+
+    /**
+     * @brief Process the planar block by the core running at the S-DSP rate
+     * @param planes Planes of the block, processed in place
+     * @param frames Number of frames in the block, not bigger than the block_frames
+     *
+     * Input is downsampled to feed the delay line, the wet signal is upsampled
+     * back and mixed with the dry signal at the output rate.
+     */
+    template<int CH>
+    void processFramesNative(Sample *const *planes, int frames)
+    {
+        const int chans = CH ? CH : channels;
+        Sample *in32[MAX_CHANNELS] = {};
+        Sample *wet32[MAX_CHANNELS] = {};
+        Sample *wet[MAX_CHANNELS] = {};
+        int m, k;
+
+        for(int c = 0; c < chans; ++c)
+        {
+            in32[c] = native_buf.data() + (size_t)c * ECHO_BLOCK_FRAMES;
+            wet32[c] = native_buf.data() + (size_t)(chans + c) * ECHO_BLOCK_FRAMES;
+            wet[c] = native_buf.data() + (size_t)(chans * 2 + c) * ECHO_BLOCK_FRAMES;
+        }
+
+        m = native_down.process(planes, frames, in32, ECHO_BLOCK_FRAMES);
+        core.template processRuns<CH, false>(*regs, in32, wet32, m);
+        k = native_up.process(wet32, m, wet, frames);
+
+        for(int c = 0; c < chans; ++c)
+        {
+            if(k < frames)
+                memset(wet[c] + k, 0, (frames - k) * sizeof(Sample));
+            core.mixRun(c, planes[c], wet[c], frames);
+        }
+    }
+
+    void process(uint8_t *stream, int len)
+    {
+        int frame_size, frames, todo;
+        Sample *planes[MAX_CHANNELS];
+
+        frame_size = codec.sample_size * channels;
+        frames = len / frame_size;
+
+        for(int c = 0; c < channels; ++c)
+            planes[c] = block[c];
+
+        while(frames > 0)
+        {
+            todo = frames > block_frames ? block_frames : frames;
+
+            codec.decode(stream, planes, todo);
+            (this->*processFramesCB)(planes, todo);
+            codec.encode(stream, planes, todo);
+
+            stream += todo * frame_size;
+            frames -= todo;
+        }
+    }
+
+    //! Process planes of any length in place, they get sliced by the block_frames
+    void processPlanes(Sample *const *planes, int frames)
+    {
+        Sample *slice[MAX_CHANNELS];
+
+        for(int offset = 0; offset < frames; offset += block_frames)
+        {
+            const int todo = frames - offset > block_frames ? block_frames : frames - offset;
+
+            for(int c = 0; c < channels; ++c)
+                slice[c] = planes[c] + offset;
+
+            (this->*processFramesCB)(slice, todo);
+        }
+    }
+
+    //! Silence the delay memory, the FIR history and the resamplers, registers are kept
+    void reset()
+    {
+        core.resetState();
+        std::fill(core.echo_own.begin(), core.echo_own.end(), (Line)0);
+        native_down.reset();
+        native_up.reset();
+    }
+
+    /**
+     * @brief Frames the wet signal comes late by
+     * @param rate Output sample rate
+     * @return Delay of the resamplers of the native rate, 0 if the core runs at the output rate
+     */
+    int latency(int rate) const
+    {
+        if(!native)
+            return 0;
+
+        return native_down.taps / 2 + (native_up.taps / 2) * rate / SDSP_RATE;
+    }
+};
+
+typedef struct SpcEcho : SpcEchoRegs
+{
+    int is_valid = 0;
+
+    int     rate = SDSP_RATE;
+    int     channels = 2;
+    int     flags = 0;
+#ifdef INTEGER_ONLY_ECHO
+    uint16_t format = AUDIO_S16;
+#else
+    uint16_t format = AUDIO_F32;
+#endif
+
+    //! The stream is processed by the integer math, see echoUseFixed()
+    bool use_fixed = false;
+    SpcEchoUnit<int32_t> fixed_unit;
+#ifndef INTEGER_ONLY_ECHO
+    SpcEchoUnit<float> float_unit;
+    //! Float math over the 16-bit delay memory, see ECHO_FLAG_COMPACT_RAM
+    bool use_compact = false;
+    SpcEchoUnit<float, int16_t> compact_unit;
+#endif
+
+    //! Registers as the audio thread sees them, the own ones get published here by every change
+    FxSnapshot<SpcEchoRegs> regs_shared;
+    //! Tail of the own registers, counted by the control thread as it publishes, see tailLength()
+    std::atomic<int> tail_frames{0};
+
+    int init(int i_rate, uint16_t i_format, int i_channels, int i_flags = 0)
+    {
+        bool native, ok;
+
+        is_valid = 0;
+        rate = i_rate;
+        format = i_format;
+        channels = i_channels;
+        flags = i_flags;
+        rate_factor = (double)i_rate / SDSP_RATE;
+
+#ifdef INTEGER_ONLY_ECHO
+        if (i_format != AUDIO_S16LSB && i_format != AUDIO_S16MSB)
+            return -1; /* Disallowed format */
+#endif
+
+        if(rate_factor > 50.0)
+            return -1; /* Too big scale factor */
+
+        if(i_rate < 4000)
+            return -1; /* Too small sample rate */
+
+        native = (flags & ECHO_FLAG_NATIVE_RATE) && i_rate != SDSP_RATE;
+        if(native)
+            rate_factor = 1.0; // The core works at the real S-DSP timing, no stretch of delay and FIR is needed
+
+        use_fixed = echoUseFixed(format, flags);
+        memset(reg_fir_resampled, 0, sizeof(reg_fir_resampled));
+        setDefaultRegs();
+        regs_shared.reset(*this);
+
+#ifndef INTEGER_ONLY_ECHO
+        use_compact = !use_fixed && (flags & ECHO_FLAG_COMPACT_RAM);
+        if(use_compact)
+            ok = compact_unit.init(&regs_shared.read(), rate, format, channels, native);
+        else if(!use_fixed)
+            ok = float_unit.init(&regs_shared.read(), rate, format, channels, native);
+        else
+#endif
+            ok = fixed_unit.init(&regs_shared.read(), rate, format, channels, native);
+
+        if(!ok)
+            return -1;
+
+        tail_frames.store(countTail(*this), std::memory_order_relaxed);
+        is_valid = 1;
+        return 0;
+    }
+
+    void close()
+    {}
+
+    //! Control thread: pass the changed registers to the audio thread, the delay memory for them goes first
+    void publishRegs()
+    {
+        const int length = echoLength(channels), max_length = echoLength(channels, 0x0F);
+
+#ifndef INTEGER_ONLY_ECHO
+        if(use_compact)
+            compact_unit.core.growEchoRam(length, max_length);
+        else if(!use_fixed)
+            float_unit.core.growEchoRam(length, max_length);
+        else
+#endif
+            fixed_unit.core.growEchoRam(length, max_length);
+
+        tail_frames.store(countTail(*this), std::memory_order_relaxed);
+        regs_shared.publish(*this);
+    }
+
+    //! Take the registers published since the last block, units latch them at the ring wrap
+    void acquireRegs()
+    {
+        if(!regs_shared.acquire())
+            return;
+
+        const SpcEchoRegs *r = &regs_shared.read();
+        fixed_unit.regs = r;
+#ifndef INTEGER_ONLY_ECHO
+        float_unit.regs = r;
+        compact_unit.regs = r;
+#endif
+    }
+
+    void process(uint8_t *stream, int len)
+    {
+        if(!is_valid)
+            return;
+
+        acquireRegs();
+
+#ifndef INTEGER_ONLY_ECHO
+        if(use_compact)
+        {
+            compact_unit.process(stream, len);
+            return;
+        }
+
+        if(!use_fixed)
+        {
+            float_unit.process(stream, len);
+            return;
+        }
+#endif
+        fixed_unit.process(stream, len);
+    }
+
+    //! Float planes in place, the integer math doesn't take them
+    void processPlanes(float *const *planes, int frames)
+    {
+        if(!is_valid)
+            return;
+
+        acquireRegs();
+
+#ifndef INTEGER_ONLY_ECHO
+        if(use_compact)
+            compact_unit.processPlanes(planes, frames);
+        else if(!use_fixed)
+            float_unit.processPlanes(planes, frames);
+#else
+        (void)planes;
+        (void)frames;
+#endif
+    }
+
+    void reset()
+    {
+        fixed_unit.reset();
+#ifndef INTEGER_ONLY_ECHO
+        float_unit.reset();
+        compact_unit.reset();
+#endif
+    }
+
+    int latency() const
+    {
+#ifndef INTEGER_ONLY_ECHO
+        if(use_compact)
+            return compact_unit.latency(rate);
+        if(!use_fixed)
+            return float_unit.latency(rate);
+#endif
+        return fixed_unit.latency(rate);
+    }
+
+    //! Frames the echo stays above -96 dB once the input got silent, by the last published registers. Any thread
+    int tailLength() const
+    {
+        return tail_frames.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Frames the echo of the registers stays above -96 dB once the input got silent
+     * @param r Registers to count by
+     * @return Length of all passes through the ring till the feedback loop fades out, or FX_TAIL_INFINITE
+     *
+     * Every pass is bounded by the sum of FIR taps times the feedback. The
+     * ring keeps the input at the full level however low the echo volume
+     * is, so the tail is counted from the full level at least, and the raised
+     * volume never brings back the loud echo.
+     */
+    int countTail(const SpcEchoRegs &r) const
+    {
+        const double floor_level = 1.0 / 65536.0;
+        double fir = 0.0, loop, out, passes, ring;
+
+        for(int i = 0; i < 8; ++i)
+            fir += abs((int)r.reg_fir_resampled[i]) / 128.0;
+
+        loop = abs((int)r.reg_efb) / 128.0 * fir;
+        out = (abs((int)r.reg_evoll) > abs((int)r.reg_evolr) ? abs((int)r.reg_evoll) : abs((int)r.reg_evolr)) / 128.0 * fir;
+        if(out < 1.0)
+            out = 1.0;
+
+        if(loop >= 1.0)
+            return FX_TAIL_INFINITE;
+
+        passes = 1.0;
+        if(loop > 0.0)
+            passes += ceil(log(floor_level / out) / log(loop));
+
+        // The ring is counted at the S-DSP rate when the core runs there
+        ring = r.echoLength(1);
+        if(flags & ECHO_FLAG_NATIVE_RATE)
+            ring = ring * rate / SDSP_RATE;
+
+        const double tail = passes * ring + ECHO_HIST_SIZE;
+        if(tail > INT32_MAX / 2)
+            return FX_TAIL_INFINITE;
+
+        return (int)tail;
+    }
+
+    void setDither(int mode)
+    {
+#ifndef INTEGER_ONLY_ECHO
+        float_unit.codec.setDither(mode);
+        compact_unit.codec.setDither(mode);
+#else
+        (void)mode;
+#endif
+    }
+} SpcEcho;
+
+
+//! Echo of one Mix channel at the bank, delay memory comes from the pool
+template<typename Sample, typename Line>
+struct EchoBankVoice : SpcEchoCore<Sample, Line>
+{
+    //! Holds the ring at the pool and gets processed
+    bool active = false;
+    //! Send got some input since the last processing
+    bool has_input = false;
+    //! Echo got above the silence since the last processing
+    bool loud = false;
+    //! Frames processed without input and with the quiet tail
+    int silent_frames = 0;
+
+    //! Planar input sent by the channel effect, send_stride frames per channel
+    std::vector<Sample> send;
+    int send_stride = 0;
+    //! Frames sent since the last processing
+    int send_frames = 0;
+
+    //! Allocate the send planes, the audio thread never grows them
+    void initSend(int max_frames)
+    {
+        send.assign((size_t)max_frames * this->channels, 0);
+        send_stride = max_frames;
+        send_frames = 0;
+    }
+
+    /**
+     * @brief Start the echo from the silence
+     * @param regs Registers of the voice
+     * @return true if the ring has been allocated at the pool
+     */
+    bool activate(const SpcEchoRegs &regs)
+    {
+        this->resetState();
+        active = this->latchRegs(regs, this->channels);
+        silent_frames = 0;
+        return active;
+    }
+
+    void deactivate()
+    {
+        this->releaseEchoRam();
+        this->resetState();
+        active = false;
+        silent_frames = 0;
+    }
+};
+
+struct SpcEchoBank;
+
+//! Registers of one voice of the echo bank
+typedef struct SpcEchoVoice : SpcEchoRegs
+{
+    SpcEchoBank *bank = nullptr;
+    int index = 0;
+} SpcEchoVoice;
+
+//! Voices of the echo bank processed in the given sample type
+template<typename Sample, typename Line = typename EchoMath<Sample>::Line>
+struct EchoBankUnit
+{
+    typedef EchoMath<Sample> Math;
+    typedef EchoBankVoice<Sample, Line> Voice;
+
+    int channels = 2;
+    //! Frames of the send planes, the input sent past them in one callback doesn't echo
+    int max_frames = 0;
+
+    EchoPool<Line> pool;
+    std::vector<Voice> voices;
+    //! Registers of voices as the audio thread sees them, indexed like voices
+    const FxSnapshot<SpcEchoRegs> *regs = nullptr;
+
+    //! Planar copy of the currently processing part of the mixed stream
+    Sample block[MAX_CHANNELS][ECHO_BLOCK_FRAMES];
+    //! Output of the FIR filter of one voice
+    Sample wet[MAX_CHANNELS][ECHO_BLOCK_FRAMES];
+    //! Input of voices that got nothing sent
+    Sample zero[ECHO_BLOCK_FRAMES];
+
+    FxCodec<Sample> codec;
+
+    void (EchoBankUnit::*processVoicesCB)(int offset, int frames) = nullptr;
+
+    template<int CH>
+    void setKernel()
+    {
+        processVoicesCB = &EchoBankUnit::processVoices<CH>;
+    }
+
+    /**
+     * @brief Set up the processing
+     * @param i_regs Registers of voices
+     * @param i_voices Number of voices
+     * @param pool_size Size of the delay memory in frames
+     * @param i_max_frames Biggest chunk the send planes take
+     * @return true on success
+     */
+    bool init(const FxSnapshot<SpcEchoRegs> *i_regs, uint16_t format, int i_channels, int i_voices, size_t pool_size, int i_max_frames)
+    {
+        regs = i_regs;
+        channels = i_channels;
+        max_frames = i_max_frames;
+
+        if(!codec.init(format, channels))
+            return false;
+
+        pool.init(pool_size * channels, i_voices);
+
+        voices.clear();
+        voices.resize(i_voices);
+        for(Voice &v : voices)
+        {
+            v.initCore(channels, &pool);
+            v.initSend(max_frames);
+        }
+
+        memset(zero, 0, sizeof(zero));
+
+        switch(channels)
+        {
+        case 1:
+            setKernel<1>();
+            break;
+        case 2:
+            setKernel<2>();
+            break;
+        case 6:
+            setKernel<6>();
+            break;
+        case 8:
+            setKernel<8>();
+            break;
+        default:
+            setKernel<0>();
+            break;
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Take the input of the channel, the dry signal gets the main volume of the voice
+     * @param index Voice of the channel
+     * @param stream Output of the channel
+     * @param len Length of the stream in bytes
+     */
+    void sendVoice(int index, uint8_t *stream, int len)
+    {
+        Voice &v = voices[index];
+        int frame_size, frames, todo, room;
+        Sample *planes[MAX_CHANNELS];
+
+        frame_size = codec.sample_size * channels;
+        frames = len / frame_size;
+
+        if(!v.active)
+            v.activate(regs[index].read());
+
+        // The channel may get mixed by several pieces, they follow each other at the stream
+        while(frames > 0)
+        {
+            todo = frames > ECHO_BLOCK_FRAMES ? ECHO_BLOCK_FRAMES : frames;
+            room = v.send_stride - v.send_frames;
+            if(room > 0 && todo > room)
+                todo = room; // The rest goes past the send planes, it gets the main volume only
+
+            for(int c = 0; c < channels; ++c)
+                planes[c] = room > 0 ? v.send.data() + (size_t)c * v.send_stride + v.send_frames : block[c];
+
+            codec.decode(stream, planes, todo);
+
+            for(int c = 0; c < channels; ++c)
+            {
+                if(room > 0)
+                    memcpy(block[c], planes[c], todo * sizeof(Sample));
+                v.mixRun(c, block[c], zero, todo);
+                planes[c] = block[c];
+            }
+
+            codec.encode(stream, planes, todo);
+
+            if(room > 0)
+                v.send_frames += todo;
+            stream += todo * frame_size;
+            frames -= todo;
+        }
+
+        v.has_input = v.active;
+        if(!v.active)
+            v.send_frames = 0; // The pool is full, the channel goes dry
+    }
+
+    /**
+     * @brief Run every active voice and mix the wet signals into the block
+     * @param offset Position of the block at the callback
+     * @param frames Number of frames in the block
+     */
+    template<int CH>
+    void processVoices(int offset, int frames)
+    {
+        const int chans = CH ? CH : channels;
+        Sample *in[MAX_CHANNELS];
+        Sample *out[MAX_CHANNELS];
+
+        for(int c = 0; c < chans; ++c)
+            out[c] = wet[c];
+
+        for(size_t n = 0; n < voices.size(); ++n)
+        {
+            Voice &v = voices[n];
+
+            if(!v.active)
+                continue;
+
+            for(int c = 0; c < chans; ++c)
+                in[c] = v.has_input && offset < v.send_stride ? v.send.data() + (size_t)c * v.send_stride + offset : zero;
+
+            v.template processRuns<CH, false>(regs[n].read(), in, out, frames);
+
+            // Registers may be latched in the middle of the block, the mute is checked for the whole of it
+            if((v.latch.flg & 0x40))
+                continue;
+
+            for(int c = 0; c < chans; ++c)
+            {
+                const Sample evol = v.latch.evol[c & 1];
+                const Sample quiet = Math::silence();
+                Sample *dst = block[c];
+                const Sample *src = out[c];
+                bool loud = v.has_input || v.loud;
+
+                for(int i = 0; i < frames; ++i)
+                {
+                    Sample w = Math::echo(src[i], evol);
+                    dst[i] += w;
+                    loud |= w > quiet || w < -quiet;
+                }
+
+                v.loud = loud;
+            }
+        }
+    }
+
+    void process(uint8_t *stream, int len)
+    {
+        int frame_size, frames, sent, todo, offset = 0;
+        Sample *planes[MAX_CHANNELS];
+        bool any = false;
+
+        frame_size = codec.sample_size * channels;
+        frames = len / frame_size;
+        sent = frames > max_frames ? max_frames : frames;
+
+        for(Voice &v : voices)
+        {
+            if(!v.active)
+                continue;
+
+            any = true;
+            if(v.has_input)
+            {
+                // Channel stopped in the middle of the callback, the rest is a silence
+                for(int c = 0; c < channels && v.send_frames < sent; ++c)
+                    memset(v.send.data() + (size_t)c * v.send_stride + v.send_frames, 0,
+                           (sent - v.send_frames) * sizeof(Sample));
+            }
+        }
+
+        if(!any)
+            return;
+
+        for(int c = 0; c < channels; ++c)
+            planes[c] = block[c];
+
+        while(offset < frames)
+        {
+            todo = frames - offset > ECHO_BLOCK_FRAMES ? ECHO_BLOCK_FRAMES : frames - offset;
+            if(offset < sent && offset + todo > sent)
+                todo = sent - offset; // Slices past the send planes take the silence
+
+            codec.decode(stream, planes, todo);
+            (this->*processVoicesCB)(offset, todo);
+
+            for(int c = 0; c < channels; ++c)
+            {
+                for(int i = 0; i < todo; ++i)
+                    block[c][i] = Math::clamp(block[c][i]);
+            }
+
+            codec.encode(stream, planes, todo);
+
+            stream += todo * frame_size;
+            offset += todo;
+        }
+
+        for(Voice &v : voices)
+        {
+            if(!v.active)
+                continue;
+
+            // Tail is over once the whole ring has been played quietly twice
+            if(v.has_input || v.loud)
+                v.silent_frames = 0;
+            else
+            {
+                v.silent_frames += frames;
+                if(v.silent_frames >= v.echo_length * 2)
+                    v.deactivate();
+            }
+
+            v.has_input = false;
+            v.loud = false;
+            v.send_frames = 0;
+        }
+    }
+
+    void close()
+    {
+        for(Voice &v : voices)
+            v.deactivate();
+    }
+};
+
+//! Echoes of many Mix channels processed together by a single post-mix pass
+typedef struct SpcEchoBank
+{
+    int is_valid = 0;
+
+    int     rate = SDSP_RATE;
+    int     channels = 2;
+#ifdef INTEGER_ONLY_ECHO
+    uint16_t format = AUDIO_S16;
+#else
+    uint16_t format = AUDIO_F32;
+#endif
+
+    std::vector<SpcEchoVoice> voices;
+    //! Registers of voices as the audio thread sees them, every voice publishes its own ones here
+    std::vector<FxSnapshot<SpcEchoRegs> > regs_shared;
+
+    //! The stream is processed by the integer math, see echoUseFixed()
+    bool use_fixed = false;
+    EchoBankUnit<int32_t> fixed_unit;
+#ifndef INTEGER_ONLY_ECHO
+    EchoBankUnit<float> float_unit;
+    //! Float math over the 16-bit delay memory, see ECHO_FLAG_COMPACT_RAM
+    bool use_compact = false;
+    EchoBankUnit<float, int16_t> compact_unit;
+#endif
+
+    /**
+     * @brief Set up the bank
+     * @param i_voices Number of voices
+     * @param pool_edl Sum of EDL values the pool must fit at once, or 0 to fit every voice at the EDL 15
+     * @param max_frames Biggest chunk sent at once, or 0 for the default
+     * @param flags Set of EchoFlags, the ECHO_FLAG_NATIVE_RATE is not supported
+     */
+    int init(int i_rate, uint16_t i_format, int i_channels, int i_voices, int pool_edl, int max_frames, int flags)
+    {
+        double rate_factor = (double)i_rate / SDSP_RATE;
+        size_t edl_frames, pool_size;
+        bool ok;
+
+        is_valid = 0;
+        rate = i_rate;
+        format = i_format;
+        channels = i_channels;
+
+#ifdef INTEGER_ONLY_ECHO
+        if (i_format != AUDIO_S16LSB && i_format != AUDIO_S16MSB)
+            return -1; /* Disallowed format */
+#endif
+
+        if(rate_factor > 50.0)
+            return -1; /* Too big scale factor */
+
+        if(i_rate < 4000)
+            return -1; /* Too small sample rate */
+
+        if(i_voices <= 0)
+            return -1;
+
+        if(pool_edl <= 0)
+            pool_edl = i_voices * 15;
+
+        if(max_frames <= 0)
+            max_frames = ECHO_BANK_MAX_FRAMES;
+
+        // Biggest ring of the EDL 1 in frames, see SpcEchoRegs::echoLength()
+        edl_frames = (size_t)ceil(512.0 * rate_factor) + 1;
+        // Every voice needs at least one frame, even with the EDL 0
+        pool_size = (size_t)pool_edl * edl_frames + i_voices;
+
+        voices.clear();
+        voices.resize(i_voices);
+        // Snapshots can't be moved, the new vector takes the place of the old one
+        std::vector<FxSnapshot<SpcEchoRegs> >(i_voices).swap(regs_shared);
+        for(int i = 0; i < i_voices; ++i)
+        {
+            SpcEchoVoice &v = voices[i];
+            v.bank = this;
+            v.index = i;
+            v.rate_factor = rate_factor;
+            memset(v.reg_fir_resampled, 0, sizeof(v.reg_fir_resampled));
+            v.setDefaultRegs();
+            regs_shared[i].reset(v);
+        }
+
+        use_fixed = echoUseFixed(format, flags);
+
+#ifndef INTEGER_ONLY_ECHO
+        use_compact = !use_fixed && (flags & ECHO_FLAG_COMPACT_RAM);
+        if(use_compact)
+            ok = compact_unit.init(regs_shared.data(), format, channels, i_voices, pool_size, max_frames);
+        else if(!use_fixed)
+            ok = float_unit.init(regs_shared.data(), format, channels, i_voices, pool_size, max_frames);
+        else
+#endif
+            ok = fixed_unit.init(regs_shared.data(), format, channels, i_voices, pool_size, max_frames);
+
+        if(!ok)
+            return -1;
+
+        is_valid = 1;
+        return 0;
+    }
+
+    //! Control thread: pass the changed registers of the voice to the audio thread
+    void publishVoice(const SpcEchoVoice &v)
+    {
+        regs_shared[v.index].publish(v);
+    }
+
+    void sendVoice(const SpcEchoVoice &v, uint8_t *stream, int len)
+    {
+        if(!is_valid)
+            return;
+
+        regs_shared[v.index].acquire();
+
+#ifndef INTEGER_ONLY_ECHO
+        if(use_compact)
+        {
+            compact_unit.sendVoice(v.index, stream, len);
+            return;
+        }
+
+        if(!use_fixed)
+        {
+            float_unit.sendVoice(v.index, stream, len);
+            return;
+        }
+#endif
+        fixed_unit.sendVoice(v.index, stream, len);
+    }
+
+    void process(uint8_t *stream, int len)
+    {
+        if(!is_valid)
+            return;
+
+        // Units latch them at the ring wrap of every voice
+        for(FxSnapshot<SpcEchoRegs> &r : regs_shared)
+            r.acquire();
+
+#ifndef INTEGER_ONLY_ECHO
+        if(use_compact)
+        {
+            compact_unit.process(stream, len);
+            return;
+        }
+
+        if(!use_fixed)
+        {
+            float_unit.process(stream, len);
+            return;
+        }
+#endif
+        fixed_unit.process(stream, len);
+    }
+
+    void close()
+    {
+        fixed_unit.close();
+#ifndef INTEGER_ONLY_ECHO
+        float_unit.close();
+        compact_unit.close();
+#endif
+    }
+} SpcEchoBank;
+
+
+SpcEcho *echoEffectInit(int rate, uint16_t format, int channels)
+{
+    return echoEffectInitEx(rate, format, channels, 0);
+}
+
+SpcEcho *echoEffectInitEx(int rate, uint16_t format, int channels, int flags)
+{
+    SpcEcho *out = new SpcEcho();
+    fxSimdInit();
+    if(out->init(rate, format, channels, flags) < 0)
+    {
+        echoEffectFree(out);
+        return nullptr;
+    }
+    return out;
+}
+
+void echoEffectFree(SpcEcho *context)
+{
+    if(context)
+    {
+        context->close();
+        delete context;
+    }
+}
+
+void spcEchoEffect(int, void *stream, int len, void *context)
 {
     SpcEcho *out = reinterpret_cast<SpcEcho *>(context);
     if(!out)
@@ -355,111 +1789,40 @@ void spcEchoEffect(int, void *stream, int len, void *context)
     out->process((uint8_t*)stream, len);
 }
 
+void echoEffectPlanar(void *context, float *const *planes, int frames)
+{
+    SpcEcho *out = reinterpret_cast<SpcEcho *>(context);
+    if(!out)
+        return; // Effect doesn't working
+    out->processPlanes(planes, frames);
+}
+
 void echoEffectSetReg(SpcEcho *out, EchoSetup key, int val)
 {
     if(!out)
         return;
 
-    switch(key)
-    {
-    case ECHO_EON:
-        out->reg_eon = (uint8_t)val;
-        break;
-    case ECHO_EDL:
-        out->reg_edl = (uint8_t)val;
-        break;
-    case ECHO_EFB:
-        out->reg_efb = (int8_t)val;
-        break;
-    case ECHO_MVOLL:
-        out->reg_mvoll = (int8_t)val;
-        break;
-    case ECHO_MVOLR:
-        out->reg_mvolr = (int8_t)val;
-        break;
-    case ECHO_EVOLL:
-        out->reg_evoll = (int8_t)val;
-        break;
-    case ECHO_EVOLR:
-        out->reg_evolr = (int8_t)val;
-        break;
-
-    case ECHO_FIR0:
-        out->reg_fir[0]= (int8_t)val;
-        out->recomputeFirResampled();
-        break;
-    case ECHO_FIR1:
-        out->reg_fir[1]= (int8_t)val;
-        out->recomputeFirResampled();
-        break;
-    case ECHO_FIR2:
-        out->reg_fir[2]= (int8_t)val;
-        out->recomputeFirResampled();
-        break;
-    case ECHO_FIR3:
-        out->reg_fir[3]= (int8_t)val;
-        out->recomputeFirResampled();
-        break;
-    case ECHO_FIR4:
-        out->reg_fir[4]= (int8_t)val;
-        out->recomputeFirResampled();
-        break;
-    case ECHO_FIR5:
-        out->reg_fir[5]= (int8_t)val;
-        out->recomputeFirResampled();
-        break;
-    case ECHO_FIR6:
-        out->reg_fir[6]= (int8_t)val;
-        out->recomputeFirResampled();
-        break;
-    case ECHO_FIR7:
-        out->reg_fir[7]= (int8_t)val;
+    out->setReg(key, val);
+
+    if(key >= ECHO_FIR0 && key <= ECHO_FIR7)
         out->recomputeFirResampled();
-        break;
-    }
+
+    out->publishRegs();
+}
+
+void echoEffectSetRegs(SpcEcho *out, const int regs[], uint32_t mask)
+{
+    if(!out || !regs)
+        return;
+    out->setRegs(regs, mask);
+    out->publishRegs();
 }
 
 int echoEffectGetReg(SpcEcho *out, EchoSetup key)
 {
     if(!out)
         return 0;
-
-    switch(key)
-    {
-    case ECHO_EON:
-        return out->reg_eon;
-    case ECHO_EDL:
-        return out->reg_edl;
-    case ECHO_EFB:
-        return out->reg_efb;
-    case ECHO_MVOLL:
-        return out->reg_mvoll;
-    case ECHO_MVOLR:
-        return out->reg_mvolr;
-    case ECHO_EVOLL:
-        return out->reg_evoll;
-    case ECHO_EVOLR:
-        return out->reg_evolr;
-
-    case ECHO_FIR0:
-        return out->reg_fir[0];
-    case ECHO_FIR1:
-        return out->reg_fir[1];
-    case ECHO_FIR2:
-        return out->reg_fir[2];
-    case ECHO_FIR3:
-        return out->reg_fir[3];
-    case ECHO_FIR4:
-        return out->reg_fir[4];
-    case ECHO_FIR5:
-        return out->reg_fir[5];
-    case ECHO_FIR6:
-        return out->reg_fir[6];
-    case ECHO_FIR7:
-        return out->reg_fir[7];
-    }
-
-    return 0;
+    return out->getReg(key);
 }
 
 void echoEffectResetFir(SpcEcho *out)
@@ -467,6 +1830,7 @@ void echoEffectResetFir(SpcEcho *out)
     if(!out)
         return;
     out->setDefaultFir();
+    out->publishRegs();
 }
 
 void echoEffectResetDefaults(SpcEcho *out)
@@ -474,4 +1838,299 @@ void echoEffectResetDefaults(SpcEcho *out)
     if(!out)
         return;
     out->setDefaultRegs();
+    out->publishRegs();
+}
+
+void echoEffectSetDither(SpcEcho *out, int mode)
+{
+    if(!out)
+        return;
+    out->setDither(mode);
+}
+
+
+static const struct EchoPresetKey
+{
+    const char *name;
+    EchoSetup key;
+} echo_preset_keys[] =
+{
+    {"echo-on",             ECHO_EON},
+    {"delay",               ECHO_EDL},
+    {"feedback",            ECHO_EFB},
+    {"main-volume-left",    ECHO_MVOLL},
+    {"main-volume-right",   ECHO_MVOLR},
+    {"echo-volume-left",    ECHO_EVOLL},
+    {"echo-volume-right",   ECHO_EVOLR},
+    {"fir-0",               ECHO_FIR0},
+    {"fir-1",               ECHO_FIR1},
+    {"fir-2",               ECHO_FIR2},
+    {"fir-3",               ECHO_FIR3},
+    {"fir-4",               ECHO_FIR4},
+    {"fir-5",               ECHO_FIR5},
+    {"fir-6",               ECHO_FIR6},
+    {"fir-7",               ECHO_FIR7},
+    {NULL,                  ECHO_EON}
+};
+
+static void echoPresetTrim(const char *&begin, const char *&end)
+{
+    while(begin < end && (*begin == ' ' || *begin == '\t'))
+        ++begin;
+    while(end > begin && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'))
+        --end;
+}
+
+static bool echoPresetIs(const char *begin, const char *end, const char *word)
+{
+    size_t len = strlen(word);
+    return (size_t)(end - begin) == len && strncmp(begin, word, len) == 0;
+}
+
+int echoEffectParsePreset(EchoPreset *preset, const char *text)
+{
+    const char *line, *eol, *key, *key_end, *val, *val_end;
+    const EchoPresetKey *k;
+    char num[16], *num_end;
+    size_t len;
+    int is_echo = 1;
+
+    if(!preset || !text)
+        return -1;
+
+    memset(preset, 0, sizeof(EchoPreset));
+
+    for(line = text; *line; line = *eol ? eol + 1 : eol)
+    {
+        eol = strchr(line, '\n');
+        if(!eol)
+            eol = line + strlen(line);
+
+        key = line;
+        key_end = (const char *)memchr(line, '=', eol - line);
+        if(!key_end)
+            continue; // Empty line, comment or [section]
+
+        val = key_end + 1;
+        val_end = eol;
+        echoPresetTrim(key, key_end);
+        echoPresetTrim(val, val_end);
+
+        if(key == key_end || *key == ';' || *key == '#')
+            continue;
+
+        if(echoPresetIs(key, key_end, "fx"))
+        {
+            is_echo = echoPresetIs(val, val_end, "echo");
+            continue;
+        }
+
+        for(k = echo_preset_keys; k->name; ++k)
+        {
+            if(echoPresetIs(key, key_end, k->name))
+                break;
+        }
+
+        if(!k->name)
+            continue; // Unknown key
+
+        len = (size_t)(val_end - val);
+        if(len == 0 || len >= sizeof(num))
+            break;
+
+        memcpy(num, val, len);
+        num[len] = '\0';
+
+        preset->regs[k->key] = (int)strtol(num, &num_end, 10);
+        if(*num_end != '\0')
+            break; // Not a number
+
+        preset->mask |= ECHO_REG_BIT(k->key);
+    }
+
+    if(*line || !is_echo)
+    {
+        preset->mask = 0; // Nothing to apply from the broken preset
+        return -1;
+    }
+
+    return 0;
+}
+
+void echoEffectApplyPreset(SpcEcho *out, const EchoPreset *preset)
+{
+    if(!out || !preset)
+        return;
+    out->setRegs(preset->regs, preset->mask);
+    out->publishRegs();
+}
+
+
+//! Registers of the echoEffectClass, defaults are the ones of setDefaultRegs()
+static const FxEffectParam echo_params[ECHO_REGS_COUNT] =
+{
+    {ECHO_EON,      "echo-on",              0,      1,      1},
+    {ECHO_EDL,      "delay",                0,      15,     3},
+    {ECHO_EFB,      "feedback",             -128,   127,    14},
+    {ECHO_MVOLL,    "main-volume-left",     -128,   127,    -119},
+    {ECHO_MVOLR,    "main-volume-right",    -128,   127,    -100},
+    {ECHO_EVOLL,    "echo-volume-left",     -128,   127,    -97},
+    {ECHO_EVOLR,    "echo-volume-right",    -128,   127,    -100},
+    {ECHO_FIR0,     "fir-0",                -128,   127,    -128},
+    {ECHO_FIR1,     "fir-1",                -128,   127,    -1},
+    {ECHO_FIR2,     "fir-2",                -128,   127,    -102},
+    {ECHO_FIR3,     "fir-3",                -128,   127,    -1},
+    {ECHO_FIR4,     "fir-4",                -128,   127,    103},
+    {ECHO_FIR5,     "fir-5",                -128,   127,    -1},
+    {ECHO_FIR6,     "fir-6",                -128,   127,    15},
+    {ECHO_FIR7,     "fir-7",                -128,   127,    -1}
+};
+
+static void *echoClassCreate(int rate, int channels)
+{
+    return echoEffectInit(rate, FX_AUDIO_F32SYS, channels);
+}
+
+static void echoClassDestroy(void *effect)
+{
+    echoEffectFree(reinterpret_cast<SpcEcho *>(effect));
+}
+
+static void echoClassReset(void *effect)
+{
+    SpcEcho *out = reinterpret_cast<SpcEcho *>(effect);
+    if(!out)
+        return;
+    out->reset();
+}
+
+static int echoClassSetParam(void *effect, int id, float value)
+{
+    SpcEcho *out = reinterpret_cast<SpcEcho *>(effect);
+    if(!out || id < 0 || id >= ECHO_REGS_COUNT)
+        return -1;
+    echoEffectSetReg(out, (EchoSetup)id, (int)floor(value + 0.5f));
+    return 0;
+}
+
+static float echoClassGetParam(void *effect, int id)
+{
+    SpcEcho *out = reinterpret_cast<SpcEcho *>(effect);
+    if(!out || id < 0 || id >= ECHO_REGS_COUNT)
+        return 0.0f;
+    return (float)out->getReg(id);
+}
+
+static int echoClassLatency(void *effect)
+{
+    SpcEcho *out = reinterpret_cast<SpcEcho *>(effect);
+    if(!out || !out->is_valid)
+        return 0;
+    return out->latency();
+}
+
+static int echoClassTailLength(void *effect)
+{
+    SpcEcho *out = reinterpret_cast<SpcEcho *>(effect);
+    if(!out || !out->is_valid)
+        return 0;
+    return out->tailLength();
+}
+
+const FxEffectClass echoEffectClass =
+{
+    "echo",
+    "SPC700 echo",
+    echo_params,
+    ECHO_REGS_COUNT,
+    echoClassCreate,
+    echoClassDestroy,
+    echoEffectPlanar,
+    echoClassReset,
+    echoClassSetParam,
+    echoClassGetParam,
+    echoClassLatency,
+    echoClassTailLength,
+    0
+};
+
+
+SpcEchoBank *echoBankInit(int rate, uint16_t format, int channels, int voices, int pool_edl, int max_frames, int flags)
+{
+    SpcEchoBank *out = new SpcEchoBank();
+    fxSimdInit();
+    if(out->init(rate, format, channels, voices, pool_edl, max_frames, flags) < 0)
+    {
+        echoBankFree(out);
+        return nullptr;
+    }
+    return out;
+}
+
+void echoBankFree(SpcEchoBank *bank)
+{
+    if(bank)
+    {
+        bank->close();
+        delete bank;
+    }
+}
+
+SpcEchoVoice *echoBankGetVoice(SpcEchoBank *bank, int index)
+{
+    if(!bank || index < 0 || index >= (int)bank->voices.size())
+        return nullptr;
+    return &bank->voices[index];
+}
+
+void echoBankSendEffect(int, void *stream, int len, void *voice)
+{
+    SpcEchoVoice *v = reinterpret_cast<SpcEchoVoice *>(voice);
+    if(!v || !v->bank)
+        return;
+    v->bank->sendVoice(*v, (uint8_t*)stream, len);
+}
+
+void echoBankEffect(int, void *stream, int len, void *bank)
+{
+    SpcEchoBank *out = reinterpret_cast<SpcEchoBank *>(bank);
+    if(!out)
+        return;
+    out->process((uint8_t*)stream, len);
+}
+
+void echoBankSetReg(SpcEchoVoice *voice, EchoSetup key, int val)
+{
+    if(!voice)
+        return;
+
+    voice->setReg(key, val);
+
+    if(key >= ECHO_FIR0 && key <= ECHO_FIR7)
+        voice->recomputeFirResampled();
+
+    voice->bank->publishVoice(*voice);
+}
+
+void echoBankSetRegs(SpcEchoVoice *voice, const int regs[], uint32_t mask)
+{
+    if(!voice || !regs)
+        return;
+    voice->setRegs(regs, mask);
+    voice->bank->publishVoice(*voice);
+}
+
+int echoBankGetReg(SpcEchoVoice *voice, EchoSetup key)
+{
+    if(!voice)
+        return 0;
+    return voice->getReg(key);
+}
+
+void echoBankApplyPreset(SpcEchoVoice *voice, const EchoPreset *preset)
+{
+    if(!voice || !preset)
+        return;
+    voice->setRegs(preset->regs, preset->mask);
+    voice->bank->publishVoice(*voice);
 }
@@ -31,10 +31,28 @@
 extern "C" {
 #endif
 #include "fx_format.h"
+#include "fx_effect.h"
 
 typedef struct SpcEcho SpcEcho;
 
+typedef enum EchoFlags
+{
+    /* Run the echo at the 32 kHz of S-DSP between two resamplers instead of
+       stretching the delay and FIR taps to the output rate. Sounds closer to
+       the hardware, and the echo cost doesn't grow with the output rate */
+    ECHO_FLAG_NATIVE_RATE = 0x01,
+    /* 16-bit streams are processed by the integer math of the S-DSP, this
+       keeps them at the float math. Has no effect at integer-only builds */
+    ECHO_FLAG_FORCE_FLOAT = 0x02,
+    /* Float math keeps the delay memory as 16-bit samples like the S-DSP
+       does, a half of the memory and cache traffic. The integer math has
+       it always */
+    ECHO_FLAG_COMPACT_RAM = 0x04
+} EchoFlags;
+
+/* Returns NULL if the format, the rate or the number of channels isn't supported */
 extern SpcEcho *echoEffectInit(int rate, uint16_t format, int channels);
+extern SpcEcho *echoEffectInitEx(int rate, uint16_t format, int channels, int flags);
 extern void echoEffectFree(SpcEcho *context);
 
 typedef enum EchoSetup
@@ -58,13 +76,92 @@ typedef enum EchoSetup
     ECHO_FIR7
 } EchoSetup;
 
+#define ECHO_REGS_COUNT     (ECHO_FIR7 + 1)
+#define ECHO_REG_BIT(key)   (1u << (key))
+#define ECHO_REGS_FIR       (0xFFu << ECHO_FIR0)
+#define ECHO_REGS_ALL       ((1u << ECHO_REGS_COUNT) - 1)
+
+/* Register bank parsed from the preset */
+typedef struct EchoPreset
+{
+    int regs[ECHO_REGS_COUNT];  /* Values indexed by EchoSetup */
+    uint32_t mask;              /* ECHO_REG_BIT() of every value found at the preset */
+} EchoPreset;
+
 extern void spcEchoEffect(int chan, void *stream, int len, void *context);
+/* Planes of float samples processed in place, the FxChainProcessCB of fx_chain.h.
+   The echo must be created with AUDIO_F32SYS, the integer math doesn't take them */
+extern void echoEffectPlanar(void *context, float *const *planes, int frames);
+/* Echo for the FxChain and the player registry, see fx_effect.h. Parameters are EchoSetup registers */
+extern const FxEffectClass echoEffectClass;
 
+/* Setters below are safe to call from one control thread while the effect is running,
+   the audio thread takes all changes made by one call together at the start of the next block */
 extern void echoEffectResetFir(SpcEcho *out);
 extern void echoEffectResetDefaults(SpcEcho *out);
 
 extern void echoEffectSetReg(SpcEcho *out, EchoSetup key, int val);
+/* Write registers marked by the mask at once, the FIR gets recomputed once */
+extern void echoEffectSetRegs(SpcEcho *out, const int regs[], uint32_t mask);
 extern int  echoEffectGetReg(SpcEcho *out, EchoSetup key);
+
+/*
+ * Parse the INI-style preset:
+ *   fx = echo
+ *   echo-on = 1
+ *   delay = 4
+ *   feedback = 108
+ *   main-volume-left = 127
+ *   main-volume-right = 127
+ *   echo-volume-left = 21
+ *   echo-volume-right = 21
+ *   fir-0 = -1
+ *   ...
+ *   fir-7 = -1
+ * Values are decimal. Missing keys are left untouched on apply. Returns 0 on
+ * success, -1 on error: the mask is empty then, so nothing gets applied
+ */
+extern int  echoEffectParsePreset(EchoPreset *preset, const char *text);
+extern void echoEffectApplyPreset(SpcEcho *out, const EchoPreset *preset);
+
+/* Requantization of 8 and 16-bit outputs, one of FxDitherMode. Has no effect with the integer math */
+extern void echoEffectSetDither(SpcEcho *out, int mode);
+
+/*
+ * Echo bank: per-channel echoes of many Mix channels at once.
+ *
+ * Every voice is a separate echo unit with its own registers, the delay
+ * memory of voices is taken from the shared pool while the voice sounds and
+ * gets returned once its tail fades out. Register echoBankSendEffect() with
+ * the voice on every Mix channel that should echo, and echoBankEffect() with
+ * the bank on MIX_CHANNEL_POST: the send applies the main volume to the dry
+ * signal, and the post effect runs all sounding voices in one pass and adds
+ * their echoes into the mixed stream.
+ */
+typedef struct SpcEchoBank SpcEchoBank;
+typedef struct SpcEchoVoice SpcEchoVoice;
+
+/* Default biggest chunk of the bank */
+#define ECHO_BANK_MAX_FRAMES    4096
+
+/* pool_edl is the sum of EDL values that may sound at once, 0 fits all voices at the EDL 15.
+   max_frames is the biggest chunk given to the effects, like the audio_buffers given to
+   Mix_OpenAudio(), 0 is the ECHO_BANK_MAX_FRAMES. Send buffers get allocated once by this
+   size, bigger chunks are processed by slices and their input past max_frames doesn't echo.
+   flags are EchoFlags, the ECHO_FLAG_NATIVE_RATE is not supported by the bank.
+   Returns NULL if the format, the rate or the number of voices isn't supported */
+extern SpcEchoBank *echoBankInit(int rate, uint16_t format, int channels, int voices, int pool_edl, int max_frames, int flags);
+extern void echoBankFree(SpcEchoBank *bank);
+extern SpcEchoVoice *echoBankGetVoice(SpcEchoBank *bank, int index);
+
+extern void echoBankSendEffect(int chan, void *stream, int len, void *voice);
+extern void echoBankEffect(int chan, void *stream, int len, void *bank);
+
+/* Setters run at the control thread, the voice takes the new registers at its next ring wrap */
+extern void echoBankSetReg(SpcEchoVoice *voice, EchoSetup key, int val);
+extern void echoBankSetRegs(SpcEchoVoice *voice, const int regs[], uint32_t mask);
+extern int  echoBankGetReg(SpcEchoVoice *voice, EchoSetup key);
+extern void echoBankApplyPreset(SpcEchoVoice *voice, const EchoPreset *preset);
 #ifdef __cplusplus
 }
 #endif
@@ -90,6 +90,8 @@ int	vasprintf (char **, const char *, __VALIST) _ATTRIBUTE ((__format__ (__print
 #endif
 
 #include "fx/spc_echo.h"
+#include "fx/fx_effect.h"
+#include "fx/fx_chain.h"
 
 static int audio_open = 0;
 static Mix_Music *music = NULL;
@@ -181,7 +183,7 @@ void printMenu(int cursor)
         printLine("\n");
     }
 
-    printLine("  A - play sel.   B - toggle FX [%s]     X - Stop", (fx_on ? "x" : " "));
+    printLine("  A - play sel.   B - toggle FX [%s]     X - Stop", (fx_on ? fxEffectAt(fx_on - 1)->name : " "));
     printLine("  Y - quit        L - RWops [%s]", (rwops_on ? "x" : " "));
 #else
 #   ifdef __3DS__
@@ -192,7 +194,7 @@ void printMenu(int cursor)
         printLine("-- Playing: %s", curMusicPrint);
     else
         printLine(" ");
-    printLine("  A - play sel.   B - toggle FX [%s]     1 - Stop", (fx_on ? "x" : " "));
+    printLine("  A - play sel.   B - toggle FX [%s]     1 - Stop", (fx_on ? fxEffectAt(fx_on - 1)->name : " "));
 #   ifdef __3DS__
     printLine("  Y - quit     L - RWops [%s]", (rwops_on ? "x" : " "));
 #   else
@@ -448,26 +450,51 @@ void closeChunks(void)
     m_spotyeah = NULL;
 }
 
-static SDL_bool enableEffectEcho = SDL_FALSE;
+static FxChain *effectChain = NULL;
+static const FxEffectClass *effectClass = NULL;
+static void *effectCurrent = NULL;
+/* The echo on the device format, runs without the chain */
 static SpcEcho *effectEcho = NULL;
 static Uint16 audio_format;
 static int audio_rate;
 static int audio_channels;
 
+static void SoundFX_Free(void)
+{
+    fxChainFree(effectChain);
+    effectChain = NULL;
+    if(effectClass && effectCurrent)
+        effectClass->destroy(effectCurrent);
+    effectClass = NULL;
+    effectCurrent = NULL;
+}
+
+static void effectChainDone(int x, void *context)
+{
+    (void)x;
+    if(context == effectChain)
+        SoundFX_Free();
+}
+
 static void echoEffectDone(int x, void *context)
 {
-    SpcEcho *out = (SpcEcho *)(context);
     (void)x;
-    if(out == effectEcho)
+    if(context == effectEcho)
     {
         echoEffectFree(effectEcho);
         effectEcho = NULL;
-        enableEffectEcho = SDL_FALSE;
     }
 }
 
 void SoundFX_Clear(void)
 {
+    if(effectChain)
+    {
+        Mix_UnregisterEffect(MIX_CHANNEL_POST, fxChainEffect);
+        if(effectChain)
+            SoundFX_Free();
+    }
+
     if(effectEcho)
     {
         Mix_UnregisterEffect(MIX_CHANNEL_POST, spcEchoEffect);
@@ -476,67 +503,105 @@ void SoundFX_Clear(void)
             echoEffectFree(effectEcho);
             effectEcho = NULL;
         }
-        enableEffectEcho = SDL_FALSE;
     }
 }
 
-void SoundFX_SetEcho(void)
+void SoundFX_List(void)
 {
-    SDL_bool isNew = SDL_FALSE;
+    int i;
+    const FxEffectClass *fx;
 
-    // Clear previously installed effects first
-    if(!effectEcho)
+    for(i = 0; i < fxEffectsCount(); ++i)
     {
-        SoundFX_Clear();
+        fx = fxEffectAt(i);
+        SDL_Log("Effect %d: %s (%s)%s\n", i + 1, fx->name, fx->title,
+                fx->needsSetup ? ", needs a setup, not toggled" : "");
+    }
+}
 
-        effectEcho = echoEffectInit(audio_rate,
-                                    audio_format,
-                                    audio_channels);
-        isNew = SDL_TRUE;
+static const char *echoPresetText =
+    "fx = echo\n"
+    "echo-on = 1\n"
+    "delay = 4\n"
+    "feedback = 108\n"
+    "main-volume-left = 127\n"
+    "main-volume-right = 127\n"
+    "echo-volume-left = 21\n"
+    "echo-volume-right = 21\n"
+    "fir-0 = -1\n"
+    "fir-1 = 8\n"
+    "fir-2 = 23\n"
+    "fir-3 = 36\n"
+    "fir-4 = 36\n"
+    "fir-5 = 23\n"
+    "fir-6 = 8\n"
+    "fir-7 = -1\n";
+static EchoPreset echoPreset;
+static SDL_bool echoPresetParsed = SDL_FALSE;
+static SDL_bool echoPresetLoaded = SDL_FALSE;
+
+static void SoundFX_ApplyEchoPreset(SpcEcho *echo)
+{
+    if(!echoPresetParsed)
+    {
+        echoPresetLoaded = echoEffectParsePreset(&echoPreset, echoPresetText) == 0 ? SDL_TRUE : SDL_FALSE;
+        echoPresetParsed = SDL_TRUE;
+        if(!echoPresetLoaded)
+            SDL_Log("Couldn't parse the echo preset, keeping default registers\n");
     }
 
-    if(effectEcho)
+    if(echoPresetLoaded)
+        echoEffectApplyPreset(echo, &echoPreset);
+}
+
+/* The echo takes the stream of the device as is, the 16-bit one gets the integer math */
+static SDL_bool SoundFX_SetEcho(void)
+{
+    effectEcho = echoEffectInit(audio_rate, audio_format, audio_channels);
+    if(!effectEcho)
+        return SDL_FALSE;
+
+    SoundFX_ApplyEchoPreset(effectEcho);
+    Mix_RegisterEffect(MIX_CHANNEL_POST, spcEchoEffect, echoEffectDone, effectEcho);
+    return SDL_TRUE;
+}
+
+/* Install the effect of the registry by index, see fx_effect.h. Returns SDL_FALSE if it can't run */
+SDL_bool SoundFX_Set(int index)
+{
+    const FxEffectClass *fx = fxEffectAt(index);
+    const SDL_bool isEcho = (fx && fx == fxEffectFind("echo")) ? SDL_TRUE : SDL_FALSE;
+
+    // Clear previously installed effects first
+    SoundFX_Clear();
+
+    if(!fx || fx->needsSetup)
+        return SDL_FALSE;
+
+    if(isEcho && (audio_format == AUDIO_S16LSB || audio_format == AUDIO_S16MSB))
+        return SoundFX_SetEcho();
+
+    effectChain = fxChainInit(audio_rate, audio_format, audio_channels);
+    effectClass = fx;
+    effectCurrent = fx->create(audio_rate, audio_channels);
+
+    if(!effectChain || !effectCurrent || fxChainInsertEffect(effectChain, -1, fx, effectCurrent) < 0)
     {
-/**
-fx = echo
-echo-on = 1
-delay = 4
-feedback = 108
-main-volume-left = 127
-main-volume-right = 127
-echo-volume-left = 21
-echo-volume-right = 21
-fir-0 = -1
-fir-1 = 8
-fir-2 = 23
-fir-3 = 36
-fir-4 = 36
-fir-5 = 23
-fir-6 = 8
-fir-7 = -1
-*/
-        echoEffectSetReg(effectEcho, ECHO_EON, 1);
-        echoEffectSetReg(effectEcho, ECHO_EDL, 4);
-        echoEffectSetReg(effectEcho, ECHO_EFB, 108);
-
-        echoEffectSetReg(effectEcho, ECHO_MVOLL, 127);
-        echoEffectSetReg(effectEcho, ECHO_MVOLR, 127);
-        echoEffectSetReg(effectEcho, ECHO_EVOLL, 21);
-        echoEffectSetReg(effectEcho, ECHO_EVOLR, 21);
-
-        echoEffectSetReg(effectEcho, ECHO_FIR0, -1);
-        echoEffectSetReg(effectEcho, ECHO_FIR1, 8);
-        echoEffectSetReg(effectEcho, ECHO_FIR2, 23);
-        echoEffectSetReg(effectEcho, ECHO_FIR3, 36);
-        echoEffectSetReg(effectEcho, ECHO_FIR4, 36);
-        echoEffectSetReg(effectEcho, ECHO_FIR5, 23);
-        echoEffectSetReg(effectEcho, ECHO_FIR6, 8);
-        echoEffectSetReg(effectEcho, ECHO_FIR7, -1);
-        if(isNew)
-            Mix_RegisterEffect(MIX_CHANNEL_POST, spcEchoEffect, echoEffectDone, effectEcho);
-
-        enableEffectEcho = SDL_TRUE;
+        SoundFX_Free();
+
+        // Integer-only builds have no float echo, it runs on the device format then
+        if(isEcho && SoundFX_SetEcho())
+            return SDL_TRUE;
+
+        SDL_Log("Couldn't set up the %s effect\n", fx->title);
+        return SDL_FALSE;
     }
+
+    if(isEcho)
+        SoundFX_ApplyEchoPreset((SpcEcho *)effectCurrent);
+
+    Mix_RegisterEffect(MIX_CHANNEL_POST, fxChainEffect, effectChainDone, effectChain);
+    return SDL_TRUE;
 }
 
 void playListMenu(void)
@@ -613,10 +678,12 @@ void playListMenu(void)
         }
         else if(pressed & MIX_KEY_TOGGLE_ECHO)
         {
-            fx_on = !fx_on;
-            if(fx_on)
-                SoundFX_SetEcho();
-            else
+            // Off, then every effect of the registry in turn, the ones that can't run are skipped
+            do
+                fx_on = (fx_on + 1) % (fxEffectsCount() + 1);
+            while(fx_on && !SoundFX_Set(fx_on - 1));
+
+            if(!fx_on)
                 SoundFX_Clear();
             printMenu(cur);
         }
@@ -1420,6 +1487,8 @@ int main(int argc, char *argv[])
     }
     audio_open = 1;
 
+    SoundFX_List();
+
 #if 1//def __3DS__
     Mix_SetMidiPlayer(MIDI_Fluidsynth);
     Mix_SetSoundFonts(MIXER_ROOT "/music/sf2/SNES-2.sf2");